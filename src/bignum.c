@@ -0,0 +1,423 @@
+/**
+ * @file bignum.c
+ *
+ * @brief Rinha Language Interpreter - arbitrary precision integers
+ *
+ * Schoolbook arithmetic on magnitudes of 32-bit limbs. See bignum.h.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bignum.h"
+#include "gc.h"
+
+/**
+ * @brief An operand seen as a sign and a magnitude; a word is spread over
+ *        `word` (so a view must not be copied).
+ */
+typedef struct {
+  int sign;
+  size_t size;
+  const uint32_t *limbs;
+  uint32_t word[2];
+} big_view_t;
+
+static void big_view_(const rinha_value_t *value, big_view_t *view) {
+  if (value->type == BIGINT) {
+    view->sign = value->bignum->sign;
+    view->size = value->bignum->size;
+    view->limbs = value->bignum->limbs;
+    return;
+  }
+
+  int64_t n = value->number;
+  uint64_t magnitude = (n < 0) ? 0 - (uint64_t) n : (uint64_t) n;
+
+  view->sign = (n < 0) ? -1 : 1;
+  view->word[0] = (uint32_t) magnitude;
+  view->word[1] = (uint32_t) (magnitude >> 32);
+  view->size = view->word[1] ? 2 : (view->word[0] ? 1 : 0);
+  view->limbs = view->word;
+}
+
+static size_t big_trim_(const uint32_t *limbs, size_t size) {
+  while (size && !limbs[size - 1])
+    --size;
+  return size;
+}
+
+/**
+ * @brief The result in its only form: a word if it fits, a bignum otherwise.
+ */
+static bool big_result_(rinha_value_t *ret, int sign, const uint32_t *limbs,
+                        size_t size) {
+  size = big_trim_(limbs, size);
+
+  if (size <= 2) {
+    uint64_t magnitude = size ? limbs[0] : 0;
+
+    if (size == 2)
+      magnitude |= (uint64_t) limbs[1] << 32;
+
+    if (magnitude <= (uint64_t) INT64_MAX ||
+        (sign < 0 && magnitude == (uint64_t) INT64_MAX + 1)) {
+      int64_t n = (sign < 0) ? (int64_t) (0 - magnitude) : (int64_t) magnitude;
+
+      if ((RINHA_WORD) n == n) {
+        memset(ret, 0, sizeof(*ret));
+        ret->type = INTEGER;
+        ret->number = (RINHA_WORD) n;
+        return true;
+      }
+    }
+  }
+
+  rinha_bignum_t *big = rinha_gc_alloc(RINHA_GC_BIGNUM,
+      sizeof(rinha_bignum_t) + size * sizeof(uint32_t));
+
+  if (!big)
+    return false;
+
+  big->sign = sign;
+  big->size = size;
+  memcpy(big->limbs, limbs, size * sizeof(uint32_t));
+
+  memset(ret, 0, sizeof(*ret));
+  ret->type = BIGINT;
+  ret->bignum = big;
+  return true;
+}
+
+static int big_cmp_magnitude_(const uint32_t *a, size_t an, const uint32_t *b,
+                              size_t bn) {
+  if (an != bn)
+    return (an > bn) ? 1 : -1;
+
+  for (size_t i = an; i-- > 0;) {
+    if (a[i] != b[i])
+      return (a[i] > b[i]) ? 1 : -1;
+  }
+  return 0;
+}
+
+/* r = a + b (an >= bn); r has an + 1 limbs */
+static void big_add_(uint32_t *r, const uint32_t *a, size_t an,
+                     const uint32_t *b, size_t bn) {
+  uint64_t carry = 0;
+
+  for (size_t i = 0; i < an; ++i) {
+    carry += (uint64_t) a[i] + (i < bn ? b[i] : 0);
+    r[i] = (uint32_t) carry;
+    carry >>= 32;
+  }
+  r[an] = (uint32_t) carry;
+}
+
+/* r = a - b (a >= b); r has an limbs */
+static void big_sub_(uint32_t *r, const uint32_t *a, size_t an,
+                     const uint32_t *b, size_t bn) {
+  int64_t borrow = 0;
+
+  for (size_t i = 0; i < an; ++i) {
+    int64_t d = (int64_t) a[i] - (i < bn ? b[i] : 0) - borrow;
+
+    borrow = d < 0;
+    r[i] = (uint32_t) (d + (borrow ? ((int64_t) 1 << 32) : 0));
+  }
+}
+
+/* r = a * b; r has an + bn limbs */
+static void big_mul_(uint32_t *r, const uint32_t *a, size_t an,
+                     const uint32_t *b, size_t bn) {
+  memset(r, 0, (an + bn) * sizeof(uint32_t));
+
+  for (size_t i = 0; i < an; ++i) {
+    uint64_t carry = 0;
+
+    for (size_t j = 0; j < bn; ++j) {
+      carry += (uint64_t) a[i] * b[j] + r[i + j];
+      r[i + j] = (uint32_t) carry;
+      carry >>= 32;
+    }
+    r[i + bn] = (uint32_t) carry;
+  }
+}
+
+/* q = a / d, returns a % d, for a one limb divisor; q has an limbs */
+static uint32_t big_div_limb_(uint32_t *q, const uint32_t *a, size_t an,
+                              uint32_t d) {
+  uint64_t rest = 0;
+
+  for (size_t i = an; i-- > 0;) {
+    uint64_t cur = (rest << 32) | a[i];
+
+    q[i] = (uint32_t) (cur / d);
+    rest = cur % d;
+  }
+  return (uint32_t) rest;
+}
+
+/**
+ * @brief q = u / v and r = u % v, with m >= n >= 2 (Knuth, algorithm D);
+ *        q has m - n + 1 limbs, r has n.
+ *
+ * @return `false` if scratch memory could not be allocated.
+ */
+static bool big_divmod_(uint32_t *q, uint32_t *r, const uint32_t *u, size_t m,
+                        const uint32_t *v, size_t n) {
+  uint32_t *vn = malloc((n + m + 1) * sizeof(uint32_t));
+
+  if (!vn)
+    return false;
+
+  uint32_t *un = vn + n;
+  int s = __builtin_clz(v[n - 1]);
+
+  // Normalize: the divisor's top limb gets its high bit set
+  for (size_t i = n - 1; i > 0; --i)
+    vn[i] = (v[i] << s) | (s ? v[i - 1] >> (32 - s) : 0);
+  vn[0] = v[0] << s;
+
+  un[m] = s ? u[m - 1] >> (32 - s) : 0;
+  for (size_t i = m - 1; i > 0; --i)
+    un[i] = (u[i] << s) | (s ? u[i - 1] >> (32 - s) : 0);
+  un[0] = u[0] << s;
+
+  for (size_t j = m - n + 1; j-- > 0;) {
+    uint64_t num = ((uint64_t) un[j + n] << 32) | un[j + n - 1];
+    uint64_t qhat = num / vn[n - 1];
+    uint64_t rhat = num % vn[n - 1];
+
+    while (qhat >> 32 ||
+           qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2])) {
+      --qhat;
+      rhat += vn[n - 1];
+      if (rhat >> 32)
+        break;
+    }
+
+    // Multiply and subtract
+    int64_t borrow = 0, t;
+
+    for (size_t i = 0; i < n; ++i) {
+      uint64_t p = qhat * vn[i];
+
+      t = (int64_t) un[i + j] - borrow - (int64_t) (p & 0xFFFFFFFF);
+      un[i + j] = (uint32_t) t;
+      borrow = (int64_t) (p >> 32) - (t >> 32);
+    }
+    t = (int64_t) un[j + n] - borrow;
+    un[j + n] = (uint32_t) t;
+
+    q[j] = (uint32_t) qhat;
+
+    // Subtracted too much: add back
+    if (t < 0) {
+      uint64_t carry = 0;
+
+      --q[j];
+      for (size_t i = 0; i < n; ++i) {
+        carry += (uint64_t) un[i + j] + vn[i];
+        un[i + j] = (uint32_t) carry;
+        carry >>= 32;
+      }
+      un[j + n] += (uint32_t) carry;
+    }
+  }
+
+  for (size_t i = 0; i < n - 1; ++i)
+    r[i] = (un[i] >> s) | (s ? un[i + 1] << (32 - s) : 0);
+  r[n - 1] = un[n - 1] >> s;
+
+  free(vn);
+  return true;
+}
+
+bool rinha_bignum_arith(rinha_value_t *ret, const rinha_value_t *left,
+                        const rinha_value_t *right, char op) {
+  big_view_t a, b;
+
+  big_view_(left, &a);
+  big_view_(right, &b);
+
+  size_t size = a.size + b.size + 1;
+  uint32_t *scratch = malloc(2 * size * sizeof(uint32_t));
+
+  if (!scratch)
+    return false;
+
+  bool done;
+
+  switch (op) {
+    case '+':
+    case '-': {
+      int sign = (op == '-') ? -b.sign : b.sign;
+
+      if (a.sign == sign) {
+        if (a.size >= b.size)
+          big_add_(scratch, a.limbs, a.size, b.limbs, b.size);
+        else
+          big_add_(scratch, b.limbs, b.size, a.limbs, a.size);
+        done = big_result_(ret, a.sign, scratch,
+                           (a.size >= b.size ? a.size : b.size) + 1);
+      } else if (big_cmp_magnitude_(a.limbs, a.size, b.limbs, b.size) >= 0) {
+        big_sub_(scratch, a.limbs, a.size, b.limbs, b.size);
+        done = big_result_(ret, a.sign, scratch, a.size);
+      } else {
+        big_sub_(scratch, b.limbs, b.size, a.limbs, a.size);
+        done = big_result_(ret, sign, scratch, b.size);
+      }
+    } break;
+    case '*':
+      big_mul_(scratch, a.limbs, a.size, b.limbs, b.size);
+      done = big_result_(ret, a.sign * b.sign, scratch, a.size + b.size);
+      break;
+    default: {
+      // Truncated: the quotient has the sign of the product, the rest the
+      // sign of the dividend
+      uint32_t *q = scratch, *r = scratch + size;
+
+      if (big_cmp_magnitude_(a.limbs, a.size, b.limbs, b.size) < 0) {
+        q[0] = 0;
+        memcpy(r, a.limbs, a.size * sizeof(uint32_t));
+        done = true;
+      } else if (b.size == 1) {
+        r[0] = big_div_limb_(q, a.limbs, a.size, b.limbs[0]);
+        done = true;
+      } else {
+        done = big_divmod_(q, r, a.limbs, a.size, b.limbs, b.size);
+      }
+
+      if (done) {
+        done = (op == '/')
+            ? big_result_(ret, a.sign * b.sign, q, a.size >= b.size ? a.size - b.size + 1 : 1)
+            : big_result_(ret, a.sign, r, a.size < b.size ? a.size : b.size);
+      }
+    }
+  }
+
+  free(scratch);
+  return done;
+}
+
+int rinha_bignum_cmp(const rinha_value_t *left, const rinha_value_t *right) {
+  big_view_t a, b;
+
+  big_view_(left, &a);
+  big_view_(right, &b);
+
+  if (!a.size && !b.size)
+    return 0;
+  if (!a.size)
+    return -b.sign;
+  if (!b.size || a.sign != b.sign)
+    return a.sign;
+
+  return a.sign * big_cmp_magnitude_(a.limbs, a.size, b.limbs, b.size);
+}
+
+bool rinha_bignum_parse(rinha_value_t *ret, const char *digits) {
+  size_t length = 0;
+
+  while (digits[length] >= '0' && digits[length] <= '9')
+    ++length;
+
+  uint32_t *limbs = calloc(length / 9 + 2, sizeof(uint32_t));
+
+  if (!limbs)
+    return false;
+
+  size_t size = 0;
+
+  // Nine digits at a time: limbs = limbs * 10^k + chunk
+  for (size_t i = 0; i < length;) {
+    uint32_t chunk = 0, scale = 1;
+
+    for (size_t k = 0; k < 9 && i < length; ++k, ++i) {
+      chunk = chunk * 10 + (digits[i] - '0');
+      scale *= 10;
+    }
+
+    uint64_t carry = chunk;
+
+    for (size_t j = 0; j < size; ++j) {
+      carry += (uint64_t) limbs[j] * scale;
+      limbs[j] = (uint32_t) carry;
+      carry >>= 32;
+    }
+    if (carry)
+      limbs[size++] = (uint32_t) carry;
+  }
+
+  bool done = big_result_(ret, 1, limbs, size);
+
+  free(limbs);
+  return done;
+}
+
+size_t rinha_bignum_digits(const rinha_value_t *value) {
+  big_view_t a;
+
+  big_view_(value, &a);
+
+  // 32 bits are less than 10 decimal digits
+  return a.size * 10 + 2;
+}
+
+size_t rinha_bignum_format(const rinha_value_t *value, char *out) {
+  big_view_t a;
+
+  big_view_(value, &a);
+
+  size_t size = a.size;
+
+  if (!size) {
+    strcpy(out, "0");
+    return 1;
+  }
+
+  uint32_t *q = malloc(size * sizeof(uint32_t));
+
+  if (!q)
+    return 0;
+
+  memcpy(q, a.limbs, size * sizeof(uint32_t));
+
+  // Groups of nine digits from the least significant, written backwards
+  size_t end = rinha_bignum_digits(value) + 1;
+  char *p = out + end - 1;
+
+  *p = '\0';
+  while (size) {
+    uint32_t group = big_div_limb_(q, q, size, 1000000000u);
+
+    size = big_trim_(q, size);
+    for (int k = 0; k < 9 && (size || group); ++k) {
+      *--p = '0' + group % 10;
+      group /= 10;
+    }
+  }
+  free(q);
+
+  if (a.sign < 0)
+    *--p = '-';
+
+  size_t length = out + end - 1 - p;
+
+  memmove(out, p, length + 1);
+  return length;
+}
+
+unsigned int rinha_bignum_hash(const rinha_value_t *value) {
+  big_view_t a;
+  unsigned int hash = 5381;
+
+  big_view_(value, &a);
+
+  for (size_t i = 0; i < a.size; ++i)
+    hash = hash * 33 + a.limbs[i];
+
+  return (a.sign < 0) ? ~hash : hash;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file bignum.h
+ *
+ * @brief Rinha Language Interpreter - arbitrary precision integers
+ *
+ * An integer is held in the value word while it fits (INTEGER). A result that
+ * does not fit becomes a bignum (BIGINT): a sign and a magnitude of 32-bit
+ * limbs in the collected heap. A bignum never holds a value that fits in the
+ * word, so an integer has only one form and an INTEGER is never equal to a
+ * BIGINT.
+ *
+ * The interpreter does the word arithmetic itself (checking for overflow) and
+ * comes here for the rest: the operations take INTEGER or BIGINT operands and
+ * give back the result in its only form.
+ */
+
+#ifndef _LA_RINHA_BIGNUM_H
+#define _LA_RINHA_BIGNUM_H
+
+#include "rinha.h"
+
+/**
+ * @brief The magnitude of a bignum, least significant limb first, with no
+ *        leading zero limbs.
+ *
+ * @var sign   1 or -1.
+ * @var size   Number of limbs (more than fit in RINHA_WORD).
+ * @var limbs  The limbs.
+ */
+typedef struct _bignum {
+    int sign;
+    unsigned int size;
+    uint32_t limbs[];
+} rinha_bignum_t;
+
+/**
+ * @brief `left op right`, where `op` is '+', '-', '*', '/' or '%' (truncated,
+ *        as in C). The caller checks for a zero divisor.
+ *
+ * @return `false` if the memory for the result could not be allocated.
+ */
+bool rinha_bignum_arith(rinha_value_t *ret, const rinha_value_t *left,
+                        const rinha_value_t *right, char op);
+
+/**
+ * @brief Compare two integers.
+ *
+ * @return A negative number, zero or a positive number, as in strcmp.
+ */
+int rinha_bignum_cmp(const rinha_value_t *left, const rinha_value_t *right);
+
+/**
+ * @brief Read a run of decimal digits (an integer literal).
+ *
+ * @return `false` if the memory for the result could not be allocated.
+ */
+bool rinha_bignum_parse(rinha_value_t *ret, const char *digits);
+
+/**
+ * @brief Bytes needed to format an integer (sign included, NUL excluded).
+ */
+size_t rinha_bignum_digits(const rinha_value_t *value);
+
+/**
+ * @brief Write an integer in decimal, NUL terminated, to `out` (at least
+ *        rinha_bignum_digits() + 1 bytes).
+ *
+ * @return The length written, or 0 if scratch memory could not be allocated.
+ */
+size_t rinha_bignum_format(const rinha_value_t *value, char *out);
+
+/**
+ * @brief A hash of the value of an integer (memo keys).
+ */
+unsigned int rinha_bignum_hash(const rinha_value_t *value);
+
+#endif
@@ -0,0 +1,156 @@
+/**
+ * @file bundle.c
+ *
+ * @brief Rinha Language Interpreter - scripts bundled with the interpreter
+ *
+ * See bundle.h.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "bundle.h"
+
+/**
+ * @brief FNV-1a digest of `size` bytes.
+ */
+static uint64_t rinha_bundle_digest_(const char *data, size_t size) {
+  uint64_t hash = 14695981039346656037ULL;
+
+  while (size--) {
+    hash ^= (unsigned char)*data++;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * @brief Read the trailer at the end of `fp` (`length` bytes).
+ *
+ * Checks that the script fits in the file and names a known engine; the
+ * checksum is left to the caller, which reads the script anyway.
+ */
+static rinha_bundle_status_t rinha_bundle_trailer_(FILE *fp, uint64_t length,
+    rinha_bundle_trailer_t *trailer) {
+
+  if (length < sizeof(*trailer) ||
+      fseek(fp, -(long)sizeof(*trailer), SEEK_END) != 0 ||
+      fread(trailer, sizeof(*trailer), 1, fp) != 1 ||
+      memcmp(trailer->magic, RINHA_CONFIG_BUNDLE_MAGIC, sizeof(trailer->magic)))
+    return RINHA_BUNDLE_NONE;
+
+  if (trailer->size > length - sizeof(*trailer) ||
+      trailer->engine > RINHA_ENGINE_TIERED)
+    return RINHA_BUNDLE_CORRUPT;
+
+  return RINHA_BUNDLE_OK;
+}
+
+const char *rinha_bundle_self(const char *argv0) {
+  return access("/proc/self/exe", R_OK) == 0 ? "/proc/self/exe" : argv0;
+}
+
+bool rinha_bundle_copy(const char *exe, const char *code,
+    rinha_engine_t engine, FILE *fp) {
+  rinha_bundle_trailer_t trailer;
+  struct stat s;
+  FILE *in = fopen(exe, "rb");
+
+  if (!in || fstat(fileno(in), &s) == -1) {
+    fprintf(stderr, "Error opening file (file:%s, err: %s)", exe,
+       strerror(errno));
+    if (in)
+      fclose(in);
+    return false;
+  }
+
+  // Bundling from a bundle copies the interpreter only
+  uint64_t length = s.st_size;
+
+  if (rinha_bundle_trailer_(in, length, &trailer) == RINHA_BUNDLE_OK)
+    length -= trailer.size + sizeof(trailer);
+
+  memset(&trailer, 0, sizeof(trailer));
+  trailer.size = strlen(code);
+  trailer.checksum = rinha_bundle_digest_(code, trailer.size);
+  trailer.engine = (uint32_t)engine;
+  memcpy(trailer.magic, RINHA_CONFIG_BUNDLE_MAGIC, sizeof(trailer.magic));
+
+  bool written = fseek(in, 0, SEEK_SET) == 0;
+  char buffer[BUFSIZ];
+
+  while (written && length) {
+    size_t n = length < sizeof(buffer) ? length : sizeof(buffer);
+
+    written = fread(buffer, sizeof(char), n, in) == n &&
+        fwrite(buffer, sizeof(char), n, fp) == n;
+    length -= n;
+  }
+
+  fclose(in);
+
+  return written &&
+      fwrite(code, sizeof(char), trailer.size, fp) == trailer.size &&
+      fwrite(&trailer, sizeof(trailer), 1, fp) == 1;
+}
+
+bool rinha_bundle_write(const char *exe, const char *code,
+    rinha_engine_t engine, const char *out) {
+  if (access(exe, R_OK) == -1) {
+    fprintf(stderr, "Error opening file (file:%s, err: %s)", exe,
+       strerror(errno));
+    return false;
+  }
+
+  FILE *fp = fopen(out, "wb");
+  bool written = fp && rinha_bundle_copy(exe, code, engine, fp);
+
+  if (fp && fclose(fp) != 0)
+    written = false;
+
+  if (!written || chmod(out, 0755) == -1) {
+    fprintf(stderr, "Error writing file (file:%s, err: %s)", out,
+       strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+rinha_bundle_status_t rinha_bundle_read(const char *exe, char **code,
+    rinha_engine_t *engine) {
+  rinha_bundle_trailer_t trailer;
+  struct stat s;
+  FILE *fp = fopen(exe, "rb");
+
+  if (!fp)
+    return RINHA_BUNDLE_NONE;
+
+  rinha_bundle_status_t status = fstat(fileno(fp), &s) == -1 ?
+      RINHA_BUNDLE_NONE : rinha_bundle_trailer_(fp, s.st_size, &trailer);
+
+  if (status != RINHA_BUNDLE_OK) {
+    fclose(fp);
+    return status;
+  }
+
+  char *buffer = calloc(trailer.size + 1, sizeof(char));
+
+  if (!buffer ||
+      fseek(fp, -(long)(sizeof(trailer) + trailer.size), SEEK_END) != 0 ||
+      fread(buffer, sizeof(char), trailer.size, fp) != trailer.size ||
+      rinha_bundle_digest_(buffer, trailer.size) != trailer.checksum) {
+    free(buffer);
+    fclose(fp);
+    return RINHA_BUNDLE_CORRUPT;
+  }
+
+  fclose(fp);
+  *code = buffer;
+  *engine = (rinha_engine_t)trailer.engine;
+  return RINHA_BUNDLE_OK;
+}
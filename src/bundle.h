@@ -0,0 +1,94 @@
+/**
+ * @file bundle.h
+ *
+ * @brief Rinha Language Interpreter - scripts bundled with the interpreter
+ *
+ * A bundle is an executable running one script on its own, for images without
+ * the interpreter or the script file: a copy of the interpreter with the
+ * script appended, followed by a trailer (rinha_bundle_trailer_t) giving its
+ * size, its checksum and the engine running it. The script is still parsed
+ * and run by the interpreter at startup; no native code is generated.
+ *
+ * An executable without the trailer is the plain interpreter. One whose
+ * trailer does not match its contents (truncated, or modified after it was
+ * written) is refused rather than run.
+ */
+
+#ifndef _LA_RINHA_BUNDLE_H
+#define _LA_RINHA_BUNDLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "rinha.h"
+
+/**
+ * @brief End of a bundle; the script (`size` bytes) sits right before it.
+ *
+ * @var size      Bytes of the script.
+ * @var checksum  FNV-1a digest of the script.
+ * @var engine    The rinha_engine_t running the script.
+ * @var magic     RINHA_CONFIG_BUNDLE_MAGIC.
+ */
+typedef struct {
+  uint64_t size;
+  uint64_t checksum;
+  uint32_t engine;
+  char magic[sizeof(RINHA_CONFIG_BUNDLE_MAGIC)];
+} rinha_bundle_trailer_t;
+
+/**
+ * @var RINHA_BUNDLE_NONE     No trailer: the plain interpreter.
+ * @var RINHA_BUNDLE_OK       The script and its engine were read.
+ * @var RINHA_BUNDLE_CORRUPT  A trailer that does not match the file, or the
+ *                            file could not be read.
+ */
+typedef enum {
+    RINHA_BUNDLE_NONE,
+    RINHA_BUNDLE_OK,
+    RINHA_BUNDLE_CORRUPT
+} rinha_bundle_status_t;
+
+/**
+ * @brief Path of the running executable: /proc/self/exe where there is one,
+ *        `argv0` otherwise.
+ */
+const char *rinha_bundle_self(const char *argv0);
+
+/**
+ * @brief Write a bundle to `fp`, from its current position: a copy of `exe`
+ *        (itself not a bundle) followed by `code` and its trailer.
+ *
+ * @return false if `exe` could not be read (with an error on stderr) or `fp`
+ *         could not be written.
+ */
+bool rinha_bundle_copy(const char *exe, const char *code,
+    rinha_engine_t engine, FILE *fp);
+
+/**
+ * @brief Write a bundle: a copy of `exe` (itself not a bundle) followed by
+ *        `code` and its trailer.
+ *
+ * @param[in] exe     The interpreter to copy.
+ * @param[in] code    The script.
+ * @param[in] engine  The engine running it.
+ * @param[in] out     The executable to write.
+ *
+ * @return false (with an error on stderr) if it could not be written.
+ */
+bool rinha_bundle_write(const char *exe, const char *code,
+    rinha_engine_t engine, const char *out);
+
+/**
+ * @brief Read the script bundled in `exe`.
+ *
+ * @param[in]  exe     The executable.
+ * @param[out] code    The script (to be freed) when RINHA_BUNDLE_OK.
+ * @param[out] engine  Its engine when RINHA_BUNDLE_OK.
+ */
+rinha_bundle_status_t rinha_bundle_read(const char *exe, char **code,
+    rinha_engine_t *engine);
+
+#endif
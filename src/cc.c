@@ -0,0 +1,748 @@
+/**
+ * @file cc.c
+ *
+ * @brief Rinha Language Interpreter - closure compilation (--engine=closure)
+ *
+ * The handlers, the choice of a handler for each VM instruction and the
+ * driver of the chains. See cc.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cc.h"
+
+typedef struct cc_node cc_node_t;
+
+/**
+ * @brief The state of a running compiled closure.
+ *
+ * @var call  The closure.
+ * @var code  Its code.
+ * @var r     The frame (the registers of the VM code it was compiled from).
+ * @var ret   The result.
+ * @var hash  Memo entry of the arguments (RINHA_CONFIG_CACHE_SIZE: none).
+ */
+typedef struct {
+  function_t *call;
+  cc_code_t *code;
+  rinha_value_t *r;
+  rinha_value_t *ret;
+  unsigned int hash;
+} cc_frame_t;
+
+/**
+ * @brief Runs a node and returns the next one (NULL: the closure returned).
+ */
+typedef cc_node_t *(*cc_handler_t)(cc_node_t *n, cc_frame_t *f);
+
+/**
+ * @brief A compiled node: a handler specialized for the shape of the node and
+ *        its pre-resolved operands.
+ *
+ * @var run      The handler.
+ * @var name     Handler name (--dump-ir).
+ * @var a, b, c  Registers, as in vm_inst_t.
+ * @var k        Immediate operand.
+ * @var value    Constant operand.
+ * @var next     The node that follows.
+ * @var target   Jump target.
+ * @var fn       Calls: `fn` token of the last closure called.
+ * @var callee   Calls: its code, NULL if it runs elsewhere.
+ */
+struct cc_node {
+  cc_handler_t run;
+  const char *name;
+  int a;
+  int b;
+  int c;
+  RINHA_WORD k;
+  rinha_value_t value;
+  cc_node_t *next;
+  cc_node_t *target;
+  token_t *fn;
+  cc_code_t *callee;
+  vm_closure_t *closure;
+  token_t *token;
+};
+
+struct cc_code {
+  vm_code_t *vm;
+  cc_node_t *nodes;
+  int size;
+};
+
+/**
+ * @brief Marks closures that cannot be compiled (left to the token walker).
+ */
+static cc_code_t cc_uncompilable;
+
+/**
+ * @brief Marks closures queued for the background compiler (not ready yet).
+ */
+static cc_code_t cc_pending;
+
+/**
+ * @brief Compiled code of each `fn` token, by token index.
+ */
+static cc_code_t **cc_codes = NULL;
+
+/**
+ * @brief Number of tokens of the script (the size of cc_codes).
+ */
+static int cc_count = 0;
+
+static void rinha_cc_invoke_(function_t *call, rinha_value_t *args, int argc,
+    rinha_value_t *ret, token_t *token);
+
+static cc_node_t *rinha_cc_move_(cc_node_t *n, cc_frame_t *f) {
+  f->r[n->a] = f->r[n->b];
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_loadk_(cc_node_t *n, cc_frame_t *f) {
+  f->r[n->a] = n->value;
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_loadi_(cc_node_t *n, cc_frame_t *f) {
+  f->r[n->a].type = INTEGER;
+  f->r[n->a].number = n->k;
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_load_free_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_t *v = &f->call->env[n->b];
+
+  if (v->type == UNDEFINED)
+    v = &vm_globals[n->b].value;
+
+  if (v->type == UNDEFINED)
+    rinha_error(n->token, "Undefined symbol (Hash: %d) ", n->b);
+
+  f->r[n->a] = *v;
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_load_global_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_t *v = &vm_globals[n->b].value;
+
+  if (v->type == UNDEFINED)
+    rinha_error(n->token, "Undefined symbol (Hash: %d) ", n->b);
+
+  f->r[n->a] = *v;
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_add_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_t *r = f->r;
+
+  if (RINHA_INTEGRAL(&r[n->b]) && RINHA_INTEGRAL(&r[n->c])) {
+    rinha_value_arith_(&r[n->a], &r[n->b], &r[n->c], '+');
+  } else {
+    rinha_vm_concat_(&r[n->a], &r[n->b], &r[n->c]);
+  }
+  return n->next;
+}
+
+/*
+ * The `.int` handlers have integer operands (typespec), which may still have
+ * left the word: rinha_value_arith_ checks for it.
+ */
+
+static cc_node_t *rinha_cc_add_int_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_arith_(&f->r[n->a], &f->r[n->b], &f->r[n->c], '+');
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_addi_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_t *r = f->r;
+
+  if (RINHA_INTEGRAL(&r[n->b])) {
+    rinha_value_arith_k_(&r[n->a], &r[n->b], n->k, '+');
+  } else {
+    rinha_value_t right = rinha_value_number_set_(n->k);
+    rinha_vm_concat_(&r[n->a], &r[n->b], &right);
+  }
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_addi_int_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_arith_k_(&f->r[n->a], &f->r[n->b], n->k, '+');
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_sub_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_arith_(&f->r[n->a], &f->r[n->b], &f->r[n->c], '-');
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_subi_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_arith_k_(&f->r[n->a], &f->r[n->b], n->k, '-');
+  return n->next;
+}
+
+// `*`, `/` and `%` keep the type of the left operand
+static cc_node_t *rinha_cc_mul_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_arith_(&f->r[n->a], &f->r[n->b], &f->r[n->c], '*');
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_div_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_arith_(&f->r[n->a], &f->r[n->b], &f->r[n->c], '/');
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_mod_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_arith_(&f->r[n->a], &f->r[n->b], &f->r[n->c], '%');
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_eq_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_t *r = f->r;
+
+  if (r[n->b].type == INTEGER && r[n->c].type == INTEGER) {
+    r[n->a] = rinha_value_bool_set_(r[n->b].number == r[n->c].number);
+  } else {
+    rinha_vm_cmp_types_(&r[n->b], &r[n->c], n->token);
+    r[n->a] = rinha_value_bool_set_(rinha_cmp_eq(&r[n->b], &r[n->c]));
+  }
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_neq_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_t *r = f->r;
+
+  if (r[n->b].type == INTEGER && r[n->c].type == INTEGER) {
+    r[n->a] = rinha_value_bool_set_(r[n->b].number != r[n->c].number);
+  } else {
+    rinha_vm_cmp_types_(&r[n->b], &r[n->c], n->token);
+    r[n->a] = rinha_value_bool_set_(rinha_cmp_neq(&r[n->b], &r[n->c]));
+  }
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_eq_int_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_t *r = f->r;
+
+  r[n->a] = rinha_value_bool_set_(RINHA_INTEGERS(&r[n->b], &r[n->c])
+      ? r[n->b].number == r[n->c].number : rinha_cmp_eq(&r[n->b], &r[n->c]));
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_neq_int_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_t *r = f->r;
+
+  r[n->a] = rinha_value_bool_set_(RINHA_INTEGERS(&r[n->b], &r[n->c])
+      ? r[n->b].number != r[n->c].number : rinha_cmp_neq(&r[n->b], &r[n->c]));
+  return n->next;
+}
+
+// A bignum is never equal to an immediate (a word)
+static cc_node_t *rinha_cc_eqi_(cc_node_t *n, cc_frame_t *f) {
+  if (!RINHA_INTEGRAL(&f->r[n->b]))
+    rinha_error(n->token, "Comparison of different types");
+  f->r[n->a] = rinha_value_bool_set_(f->r[n->b].type == INTEGER &&
+      f->r[n->b].number == n->k);
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_neqi_(cc_node_t *n, cc_frame_t *f) {
+  if (!RINHA_INTEGRAL(&f->r[n->b]))
+    rinha_error(n->token, "Comparison of different types");
+  f->r[n->a] = rinha_value_bool_set_(f->r[n->b].type != INTEGER ||
+      f->r[n->b].number != n->k);
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_lt_(cc_node_t *n, cc_frame_t *f) {
+  f->r[n->a] = rinha_value_bool_set_(RINHA_COMPARE(&f->r[n->b], &f->r[n->c], <));
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_lte_(cc_node_t *n, cc_frame_t *f) {
+  f->r[n->a] = rinha_value_bool_set_(RINHA_COMPARE(&f->r[n->b], &f->r[n->c], <=));
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_gt_(cc_node_t *n, cc_frame_t *f) {
+  f->r[n->a] = rinha_value_bool_set_(RINHA_COMPARE(&f->r[n->b], &f->r[n->c], >));
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_gte_(cc_node_t *n, cc_frame_t *f) {
+  f->r[n->a] = rinha_value_bool_set_(RINHA_COMPARE(&f->r[n->b], &f->r[n->c], >=));
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_lti_(cc_node_t *n, cc_frame_t *f) {
+  f->r[n->a] = rinha_value_bool_set_(RINHA_COMPARE_K(&f->r[n->b], n->k, <));
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_ltei_(cc_node_t *n, cc_frame_t *f) {
+  f->r[n->a] = rinha_value_bool_set_(RINHA_COMPARE_K(&f->r[n->b], n->k, <=));
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_gti_(cc_node_t *n, cc_frame_t *f) {
+  f->r[n->a] = rinha_value_bool_set_(RINHA_COMPARE_K(&f->r[n->b], n->k, >));
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_gtei_(cc_node_t *n, cc_frame_t *f) {
+  f->r[n->a] = rinha_value_bool_set_(RINHA_COMPARE_K(&f->r[n->b], n->k, >=));
+  return n->next;
+}
+
+/*
+ * Compare-and-branch: a comparison with an immediate followed by the
+ * conditional jump on its result. The jump node is kept (it may be a jump
+ * target) and skipped.
+ */
+
+static cc_node_t *rinha_cc_lti_jf_(cc_node_t *n, cc_frame_t *f) {
+  bool b = RINHA_COMPARE_K(&f->r[n->b], n->k, <);
+  f->r[n->a] = rinha_value_bool_set_(b);
+  return b ? n->next->next : n->target;
+}
+
+static cc_node_t *rinha_cc_ltei_jf_(cc_node_t *n, cc_frame_t *f) {
+  bool b = RINHA_COMPARE_K(&f->r[n->b], n->k, <=);
+  f->r[n->a] = rinha_value_bool_set_(b);
+  return b ? n->next->next : n->target;
+}
+
+static cc_node_t *rinha_cc_gti_jf_(cc_node_t *n, cc_frame_t *f) {
+  bool b = RINHA_COMPARE_K(&f->r[n->b], n->k, >);
+  f->r[n->a] = rinha_value_bool_set_(b);
+  return b ? n->next->next : n->target;
+}
+
+static cc_node_t *rinha_cc_gtei_jf_(cc_node_t *n, cc_frame_t *f) {
+  bool b = RINHA_COMPARE_K(&f->r[n->b], n->k, >=);
+  f->r[n->a] = rinha_value_bool_set_(b);
+  return b ? n->next->next : n->target;
+}
+
+static cc_node_t *rinha_cc_eqi_jf_(cc_node_t *n, cc_frame_t *f) {
+  if (!RINHA_INTEGRAL(&f->r[n->b]))
+    rinha_error(n->token, "Comparison of different types");
+  bool b = f->r[n->b].type == INTEGER && f->r[n->b].number == n->k;
+  f->r[n->a] = rinha_value_bool_set_(b);
+  return b ? n->next->next : n->target;
+}
+
+static cc_node_t *rinha_cc_bool_(cc_node_t *n, cc_frame_t *f) {
+  f->r[n->a] = rinha_value_bool_set_(f->r[n->b].boolean);
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_tuple_(cc_node_t *n, cc_frame_t *f) {
+  f->r[n->a] = rinha_value_tuple_set_(&f->r[n->b], &f->r[n->c]);
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_first_(cc_node_t *n, cc_frame_t *f) {
+  if (f->r[n->b].type != TUPLE)
+    rinha_error(n->token, "first: Invalid argument, expected a tuple ");
+
+  f->r[n->a] = f->r[n->b].tuple->first;
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_second_(cc_node_t *n, cc_frame_t *f) {
+  if (f->r[n->b].type != TUPLE)
+    rinha_error(n->token, "second: Invalid argument, expected a tuple ");
+
+  f->r[n->a] = f->r[n->b].tuple->second;
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_closure_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_caller_set_(&f->r[n->a], rinha_vm_closure(f->call,
+      f->code->vm, n->closure, f->r));
+  return n->next;
+}
+
+/**
+ * @brief A call: the node remembers the last closure it called and its code,
+ *        and calls it directly while the same closure keeps arriving.
+ */
+static cc_node_t *rinha_cc_call_site_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_t *r = f->r;
+
+  if (r[n->b].type != FUNCTION)
+    rinha_error(n->token, "Not a function");
+
+  function_t *call = (function_t *) r[n->b].function;
+
+  if (call->fn == n->fn && n->callee && call->args.count == n->k) {
+    if (rinha_sp + 1 >= RINHA_CONFIG_STACK_SIZE)
+      rinha_error(n->token, "Stack overflow!");
+
+    if (vm_tiered) {
+      rinha_tier_(call);
+      call->depth++;
+      rinha_cc_run(call, n->callee, &r[n->c], &r[n->a]);
+      call->depth--;
+    } else {
+      rinha_cc_run(call, n->callee, &r[n->c], &r[n->a]);
+    }
+    return n->next;
+  }
+
+  rinha_cc_invoke_(call, &r[n->c], n->k, &r[n->a], n->token);
+
+  // Calls to recurrences go through rinha_cc_invoke_
+  symbol_t *sym = rinha_symbol_get(call->hash);
+  cc_code_t *code = __atomic_load_n(&cc_codes[call->fn - vm_tokens],
+      __ATOMIC_ACQUIRE);
+
+  n->fn = call->fn;
+  n->callee = (!sym || !sym->recurrence) && code != &cc_uncompilable &&
+      code != &cc_pending ? code : NULL;
+  return n->next;
+}
+
+/**
+ * @brief A tail call (see rinha_vm_tail_calls_): calls to the running closure
+ *        start its body over with the new arguments.
+ */
+static cc_node_t *rinha_cc_tail_call_(cc_node_t *n, cc_frame_t *f) {
+  rinha_value_t *r = f->r;
+
+  if (r[n->b].type == FUNCTION && n->k == f->code->vm->params &&
+      (function_t *) r[n->b].function == f->call) {
+    memcpy(r, &r[n->c], n->k * sizeof(rinha_value_t));
+    f->hash = RINHA_CONFIG_CACHE_SIZE;
+
+    if (vm_tiered)
+      f->call->backedges++;
+    return f->code->nodes;
+  }
+  return rinha_cc_call_site_(n, f);
+}
+
+static cc_node_t *rinha_cc_print_(cc_node_t *n, cc_frame_t *f) {
+  rinha_exec_print_(&f->r[n->b]);
+  f->r[n->a] = f->r[n->b];
+  return n->next;
+}
+
+static cc_node_t *rinha_cc_jump_(cc_node_t *n, cc_frame_t *f) {
+  (void) f;
+  return n->target;
+}
+
+static cc_node_t *rinha_cc_jump_if_false_(cc_node_t *n, cc_frame_t *f) {
+  return f->r[n->b].boolean ? n->next : n->target;
+}
+
+static cc_node_t *rinha_cc_return_(cc_node_t *n, cc_frame_t *f) {
+  *f->ret = f->r[n->b];
+  return NULL;
+}
+
+inline static bool rinha_cc_ints_(vm_code_t *vm, vm_inst_t *inst) {
+  return vm->types[inst->b] == INTEGER && vm->types[inst->c] == INTEGER;
+}
+
+#define CC_HANDLER(handler, label) \
+  node->run = (handler); \
+  node->name = (label);
+
+/**
+ * @brief The generic form of the instructions is used: the VM may have run
+ *        (and quickened) the code already.
+ */
+cc_code_t *rinha_cc_compile(vm_code_t *vm) {
+  cc_code_t *code = calloc(1, sizeof(cc_code_t));
+
+  if (!code || !(code->nodes = calloc(vm->size, sizeof(cc_node_t))))
+    rinha_error(vm->fn, "Memory allocation failed");
+
+  code->vm = vm;
+  code->size = vm->size;
+
+  for (register int i = 0; i < vm->size; ++i) {
+    vm_inst_t *inst = &vm->code[i];
+    cc_node_t *node = &code->nodes[i];
+    vm_inst_t *jf = (i + 1 < vm->size &&
+        vm->code[i + 1].generic == VM_JUMP_IF_FALSE &&
+        vm->code[i + 1].b == inst->a) ? &vm->code[i + 1] : NULL;
+
+    node->a = inst->a;
+    node->b = inst->b;
+    node->c = inst->c;
+    node->k = inst->k;
+    node->token = inst->token;
+    node->next = (i + 1 < vm->size) ? &code->nodes[i + 1] : NULL;
+
+    if (inst->generic == VM_JUMP || inst->generic == VM_JUMP_IF_FALSE)
+      node->target = &code->nodes[inst->c];
+    else if (jf)
+      node->target = &code->nodes[jf->c];
+
+    switch (inst->generic) {
+      case VM_MOVE:   CC_HANDLER(rinha_cc_move_, "move"); break;
+      case VM_LOADK:
+        CC_HANDLER(rinha_cc_loadk_, "loadk");
+        node->value = vm->consts[inst->b];
+        break;
+      case VM_LOADI:  CC_HANDLER(rinha_cc_loadi_, "loadi"); break;
+      case VM_LOAD_FREE:
+        CC_HANDLER(rinha_cc_load_free_, "load.free");
+        break;
+      case VM_LOAD_GLOBAL:
+        CC_HANDLER(rinha_cc_load_global_, "load.global");
+        break;
+      case VM_ADD:
+        if (rinha_cc_ints_(vm, inst)) {
+          CC_HANDLER(rinha_cc_add_int_, "add.int");
+        } else {
+          CC_HANDLER(rinha_cc_add_, "add");
+        }
+        break;
+      case VM_ADDI:
+        if (vm->types[inst->b] == INTEGER) {
+          CC_HANDLER(rinha_cc_addi_int_, "addi.int");
+        } else {
+          CC_HANDLER(rinha_cc_addi_, "addi");
+        }
+        break;
+      case VM_SUB:    CC_HANDLER(rinha_cc_sub_, "sub"); break;
+      case VM_SUBI:   CC_HANDLER(rinha_cc_subi_, "subi"); break;
+      case VM_MUL:    CC_HANDLER(rinha_cc_mul_, "mul"); break;
+      case VM_DIV:    CC_HANDLER(rinha_cc_div_, "div"); break;
+      case VM_MOD:    CC_HANDLER(rinha_cc_mod_, "mod"); break;
+      case VM_EQ:
+        if (rinha_cc_ints_(vm, inst)) {
+          CC_HANDLER(rinha_cc_eq_int_, "eq.int");
+        } else {
+          CC_HANDLER(rinha_cc_eq_, "eq");
+        }
+        break;
+      case VM_NEQ:
+        if (rinha_cc_ints_(vm, inst)) {
+          CC_HANDLER(rinha_cc_neq_int_, "neq.int");
+        } else {
+          CC_HANDLER(rinha_cc_neq_, "neq");
+        }
+        break;
+      case VM_EQI:
+        if (jf) {
+          CC_HANDLER(rinha_cc_eqi_jf_, "eqi.jf");
+        } else {
+          CC_HANDLER(rinha_cc_eqi_, "eqi");
+        }
+        break;
+      case VM_NEQI:   CC_HANDLER(rinha_cc_neqi_, "neqi"); break;
+      case VM_LT:     CC_HANDLER(rinha_cc_lt_, "lt"); break;
+      case VM_LTE:    CC_HANDLER(rinha_cc_lte_, "lte"); break;
+      case VM_GT:     CC_HANDLER(rinha_cc_gt_, "gt"); break;
+      case VM_GTE:    CC_HANDLER(rinha_cc_gte_, "gte"); break;
+      case VM_LTI:
+        if (jf) {
+          CC_HANDLER(rinha_cc_lti_jf_, "lti.jf");
+        } else {
+          CC_HANDLER(rinha_cc_lti_, "lti");
+        }
+        break;
+      case VM_LTEI:
+        if (jf) {
+          CC_HANDLER(rinha_cc_ltei_jf_, "ltei.jf");
+        } else {
+          CC_HANDLER(rinha_cc_ltei_, "ltei");
+        }
+        break;
+      case VM_GTI:
+        if (jf) {
+          CC_HANDLER(rinha_cc_gti_jf_, "gti.jf");
+        } else {
+          CC_HANDLER(rinha_cc_gti_, "gti");
+        }
+        break;
+      case VM_GTEI:
+        if (jf) {
+          CC_HANDLER(rinha_cc_gtei_jf_, "gtei.jf");
+        } else {
+          CC_HANDLER(rinha_cc_gtei_, "gtei");
+        }
+        break;
+      case VM_BOOL:   CC_HANDLER(rinha_cc_bool_, "bool"); break;
+      case VM_TUPLE:  CC_HANDLER(rinha_cc_tuple_, "tuple"); break;
+      case VM_FIRST:  CC_HANDLER(rinha_cc_first_, "first"); break;
+      case VM_SECOND: CC_HANDLER(rinha_cc_second_, "second"); break;
+      case VM_CLOSURE:
+        CC_HANDLER(rinha_cc_closure_, "closure");
+        node->closure = &vm->closures[inst->b];
+        break;
+      case VM_CALL:   CC_HANDLER(rinha_cc_call_site_, "call"); break;
+      case VM_TAIL_CALL:
+        CC_HANDLER(rinha_cc_tail_call_, "tailcall");
+        break;
+      case VM_PRINT:  CC_HANDLER(rinha_cc_print_, "print"); break;
+      case VM_JUMP:   CC_HANDLER(rinha_cc_jump_, "jump"); break;
+      case VM_JUMP_IF_FALSE:
+        CC_HANDLER(rinha_cc_jump_if_false_, "jf");
+        break;
+      case VM_RETURN: CC_HANDLER(rinha_cc_return_, "return"); break;
+      default:
+        // Quickened forms are never generic
+        free(code->nodes);
+        free(code);
+        return NULL;
+    }
+  }
+
+  return code;
+}
+
+void rinha_cc_free(cc_code_t *code) {
+  if (!code || code == &cc_uncompilable || code == &cc_pending)
+    return;
+
+  free(code->nodes);
+  free(code);
+}
+
+void rinha_cc_dump(cc_code_t *code, FILE *out) {
+  fprintf(out, "closure: %d nodes\n", code->size);
+
+  for (register int i = 0; i < code->size; ++i) {
+    cc_node_t *node = &code->nodes[i];
+
+    fprintf(out, "  %4d  %s", i, node->name);
+    if (node->target)
+      fprintf(out, " -> %d", (int) (node->target - code->nodes));
+    fprintf(out, "\n");
+  }
+  fprintf(out, "\n");
+}
+
+cc_code_t *rinha_cc_code(function_t *call) {
+  int index = call->fn - vm_tokens;
+  cc_code_t *code = __atomic_load_n(&cc_codes[index], __ATOMIC_ACQUIRE);
+
+  if (code)
+    return (code == &cc_uncompilable || code == &cc_pending) ? NULL : code;
+
+  vm_code_t *vm = rinha_vm_code(call);
+
+  code = vm ? rinha_cc_compile(vm) : NULL;
+  cc_codes[index] = code ? code : &cc_uncompilable;
+  return code;
+}
+
+vm_code_state rinha_cc_state(token_t *fn) {
+  cc_code_t *code = __atomic_load_n(&cc_codes[fn - vm_tokens], __ATOMIC_ACQUIRE);
+
+  if (!code)
+    return VM_CODE_NONE;
+  if (code == &cc_pending)
+    return VM_CODE_PENDING;
+  return (code == &cc_uncompilable) ? VM_CODE_FAILED : VM_CODE_READY;
+}
+
+void rinha_cc_pending(token_t *fn) {
+  cc_codes[fn - vm_tokens] = &cc_pending;
+}
+
+void rinha_cc_publish(token_t *fn, cc_code_t *code) {
+  __atomic_store_n(&cc_codes[fn - vm_tokens], code ? code : &cc_uncompilable,
+      __ATOMIC_RELEASE);
+}
+
+void rinha_cc_run(function_t *call, cc_code_t *code, rinha_value_t *r,
+    rinha_value_t *ret) {
+  vm_code_t *vm = code->vm;
+  int top = vm_top;
+  cc_frame_t frame = { call, code, r, ret, RINHA_CONFIG_CACHE_SIZE };
+
+  if (r + vm->nregs > vm_regs + RINHA_CONFIG_VM_REGISTERS_SIZE)
+    rinha_error(vm->fn, "Stack overflow!");
+
+  vm_top = (r - vm_regs) + vm->nregs;
+  ++rinha_sp;
+
+  if (!vm->memo || !rinha_vm_memo_get_(call, vm, r, ret, &frame.hash)) {
+    for (cc_node_t *n = code->nodes; n; n = n->run(n, &frame));
+
+    if (frame.hash < RINHA_CONFIG_CACHE_SIZE)
+      rinha_vm_memo_set_(call, vm, r, ret, frame.hash);
+  }
+
+  --rinha_sp;
+  vm_top = top;
+}
+
+/**
+ * @brief Call a closure from compiled code: bottom-up recurrence, compiled
+ *        code or the token walker.
+ */
+static void rinha_cc_invoke_(function_t *call, rinha_value_t *args, int argc,
+    rinha_value_t *ret, token_t *token) {
+  int params = call->args.count < RINHA_CONFIG_FUNCTION_ARGS_SIZE
+      ? call->args.count : RINHA_CONFIG_FUNCTION_ARGS_SIZE;
+
+  for (register int i = argc; i < params; ++i)
+    args[i].type = UNDEFINED;
+
+  if (rinha_sp + 1 >= RINHA_CONFIG_STACK_SIZE)
+    rinha_error(token, "Stack overflow!");
+
+#if RINHA_CONFIG_RECURRENCE_ENABLE == true
+  if (rinha_recurrence_call_(call, args, ret))
+    return;
+#endif
+
+  if (vm_tiered) {
+    rinha_tier_invoke_(call, args, ret, token);
+    return;
+  }
+
+  cc_code_t *code = rinha_cc_code(call);
+
+  if (code) {
+    rinha_cc_run(call, code, args, ret);
+    return;
+  }
+
+  rinha_exec_call_(call, args, ret, token);
+}
+
+bool rinha_cc_call(function_t *call, rinha_value_t *args, rinha_value_t *ret) {
+  cc_code_t *code = rinha_cc_code(call);
+
+  if (!code)
+    return false;
+
+  rinha_value_t *frame = &vm_regs[vm_top];
+
+  if (vm_top + code->vm->nregs > RINHA_CONFIG_VM_REGISTERS_SIZE)
+    rinha_error(call->fn, "Stack overflow!");
+
+  memcpy(frame, args, code->vm->params * sizeof(rinha_value_t));
+  rinha_cc_run(call, code, frame, ret);
+  return true;
+}
+
+bool rinha_cc_init(int count) {
+  cc_codes = calloc(count, sizeof(cc_code_t *));
+  cc_count = count;
+
+  return cc_codes != NULL;
+}
+
+void rinha_cc_free_all(void) {
+  if (!cc_codes)
+    return;
+
+  for (register int i = 0; i < cc_count; ++i)
+    rinha_cc_free(cc_codes[i]);
+  free(cc_codes);
+  cc_codes = NULL;
+  cc_count = 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file cc.h
+ *
+ * @brief Rinha Language Interpreter - closure compilation (--engine=closure)
+ *
+ * The register VM code of a closure (see vm.h) is compiled into a chain of
+ * nodes, each one a C handler specialized for the shape of its instruction
+ * (operand types, immediates, compare-and-branch) with its operands resolved
+ * ahead of time. Running the code is a loop of indirect calls, without the
+ * decoding and the type checks of the VM.
+ *
+ * Compiled code runs the frames of the VM code it was compiled from, on the
+ * same register stack.
+ */
+
+#ifndef _LA_RINHA_CC_H
+#define _LA_RINHA_CC_H
+
+#include <stdio.h>
+
+#include "rinha.h"
+#include "vm.h"
+
+typedef struct cc_code cc_code_t;
+
+/**
+ * @brief Set up closure compilation for a script of `count` tokens (after
+ *        rinha_vm_init).
+ *
+ * @return `false` when out of memory.
+ */
+bool rinha_cc_init(int count);
+
+/**
+ * @brief Free the compiled code of the script.
+ */
+void rinha_cc_free_all(void);
+
+/**
+ * @brief Compile VM code into nodes.
+ *
+ * Only reads the VM code: it also runs on the background compiler thread.
+ *
+ * @return The code, or NULL if it has instructions without a handler.
+ */
+cc_code_t *rinha_cc_compile(vm_code_t *vm);
+
+/**
+ * @brief The compiled code of a closure, compiled on its first call.
+ *
+ * @return The code, or NULL if the closure is left to the token walker.
+ */
+cc_code_t *rinha_cc_code(function_t *call);
+
+/**
+ * @brief Where the compiled code of the closure of `fn` stands, without
+ *        compiling it.
+ */
+vm_code_state rinha_cc_state(token_t *fn);
+
+/**
+ * @brief Mark the closure of `fn` as queued for the background compiler.
+ */
+void rinha_cc_pending(token_t *fn);
+
+/**
+ * @brief Publish the code compiled in the background for the closure of `fn`
+ *        (NULL: it cannot be compiled).
+ */
+void rinha_cc_publish(token_t *fn, cc_code_t *code);
+
+/**
+ * @brief Run compiled code: a chain of handler calls.
+ *
+ * @param[in]  call  The closure.
+ * @param[in]  code  Its code.
+ * @param[in]  r     The frame, with the arguments in the first registers.
+ * @param[out] ret   The result.
+ */
+void rinha_cc_run(function_t *call, cc_code_t *code, rinha_value_t *r,
+    rinha_value_t *ret);
+
+/**
+ * @brief Run a closure called by the token walker as compiled code.
+ *
+ * @return `false` if the closure is left to the token walker.
+ */
+bool rinha_cc_call(function_t *call, rinha_value_t *args, rinha_value_t *ret);
+
+/**
+ * @brief Print compiled code: the handler of each node and the jump targets.
+ */
+void rinha_cc_dump(cc_code_t *code, FILE *out);
+
+void rinha_cc_free(cc_code_t *code);
+
+#endif
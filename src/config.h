@@ -24,13 +24,60 @@
 #define WORD64 int64_t //Max 9.223.372.036.854.775.807
 
 #define RINHA_WORD WORD64
+#define RINHA_WORD_MIN ((RINHA_WORD) ((uint64_t) 1 << (sizeof(RINHA_WORD) * 8 - 1)))
+#define RINHA_WORD_DIGITS 20 // Longest word in decimal: -9223372036854775808
 
 /**
  * @details
  * - RINHA_CONFIG_STRING_VALUE_MAX: Maximum length for string values in Rinha.
  */
 #define RINHA_CONFIG_STRING_VALUE_SIZE 65000
-#define RINHA_CONFIG_STRING_POOL_SIZE 64
+
+/**
+ * @details
+ * - RINHA_CONFIG_ARENA_CHUNK_SIZE: Bytes allocated at once by the per-run arena (tokens,
+ *   strings, tuples, symbols...); everything a script allocates is released together
+ *   when the next one starts. Blocks larger than a quarter of a chunk get their own.
+ */
+#define RINHA_CONFIG_ARENA_CHUNK_SIZE (1 << 20)
+
+/**
+ * @details
+ * - RINHA_CONFIG_ARENA_KEEP_SIZE: Bytes of arena chunks kept from one run to the next
+ *   instead of being returned to the system.
+ */
+#define RINHA_CONFIG_ARENA_KEEP_SIZE (16 << 20)
+
+/**
+ * @details
+ * - RINHA_CONFIG_ROPE_MIN_LENGTH: Concatenations at least this long become a rope node
+ *   instead of a copy of both operands; shorter ones are copied, since walking a rope
+ *   costs more than copying a few bytes.
+ */
+#define RINHA_CONFIG_ROPE_MIN_LENGTH 64
+
+/**
+ * @details
+ * - RINHA_CONFIG_INTERN_TABLE_SIZE: Initial number of slots of the string intern table (a
+ *   power of two); it doubles whenever it gets half full.
+ */
+#define RINHA_CONFIG_INTERN_TABLE_SIZE 4096
+
+/**
+ * @details
+ * - RINHA_CONFIG_GC_PAGE_SIZE: Size (and alignment) of the pages of the collected heap
+ *   holding strings and tuples; a power of two.
+ * - RINHA_CONFIG_GC_THRESHOLD: Minimum bytes allocated between two collections (can be
+ *   changed with --gc-threshold).
+ * - RINHA_CONFIG_GC_GROWTH: A collection starts when the heap has grown to this many
+ *   times the bytes alive after the last one (or by the threshold, if more).
+ * - RINHA_CONFIG_GC_KEEP_SIZE: Bytes of pages kept when a script ends, for the next
+ *   one to reuse.
+ */
+#define RINHA_CONFIG_GC_PAGE_SIZE (1 << 16)
+#define RINHA_CONFIG_GC_THRESHOLD (8 << 20)
+#define RINHA_CONFIG_GC_GROWTH 2
+#define RINHA_CONFIG_GC_KEEP_SIZE (16 << 20)
 
 /**
  * @details
@@ -56,12 +103,103 @@
  */
 #define RINHA_CONFIG_CACHE_ENABLE true
 
+/**
+ * @details
+ * - RINHA_CONFIG_INLINE_CACHE_ENABLE: Caches the closures resolved at each call site.
+ * - RINHA_CONFIG_INLINE_CACHE_SIZE: Number of closures remembered per call site
+ *   (1: monomorphic, more: polymorphic; the oldest one is replaced).
+ */
+#define RINHA_CONFIG_INLINE_CACHE_ENABLE true
+#define RINHA_CONFIG_INLINE_CACHE_SIZE 4
+
 /**
  * @details
  * - RINHA_CONFIG_CACHE_SIZE: Size of the cache when enabled.
  */
 #define RINHA_CONFIG_CACHE_SIZE 4099
 
+/**
+ * @details
+ * - RINHA_CONFIG_DCE_ENABLE: Enables the load-time dead-code elimination pass (unused pure
+ *   bindings and if statements with constant conditions).
+ */
+#define RINHA_CONFIG_DCE_ENABLE true
+
+/**
+ * @details
+ * - RINHA_CONFIG_RECURRENCE_ENABLE: Evaluates single-argument integer recurrences
+ *   (e.g. fib, sum) bottom-up instead of by recursion.
+ * - RINHA_CONFIG_RECURRENCE_ORDER: Maximum order k of a recurrence over f(n - k).
+ * - RINHA_CONFIG_RECURRENCE_CODE_SIZE: Maximum number of instructions of a recurrence step.
+ */
+#define RINHA_CONFIG_RECURRENCE_ENABLE true
+#define RINHA_CONFIG_RECURRENCE_ORDER 8
+#define RINHA_CONFIG_RECURRENCE_CODE_SIZE 64
+
+/**
+ * @details
+ * - RINHA_CONFIG_PRECOMPUTE_SUFFIX: Suffix appended to the script name to build the default
+ *   result cache file of --precompute.
+ */
+#define RINHA_CONFIG_PRECOMPUTE_SUFFIX ".cache"
+
+/**
+ * @details
+ * - RINHA_CONFIG_BUNDLE_MAGIC: Marks the end of the executables built with --bundle,
+ *   which carry their script after a copy of the interpreter (see bundle.h).
+ */
+#define RINHA_CONFIG_BUNDLE_MAGIC "RINHAEXE"
+
+/**
+ * @details
+ * - RINHA_CONFIG_NATIVE_STACK: Bytes of machine stack the executables built with
+ *   --compile use for their calls; a deeper recursion goes on in the interpreter.
+ * - RINHA_CONFIG_NATIVE_OUTPUT_SIZE: Bytes of output they hold before writing it;
+ *   the interpreter can take over the script until it is first written.
+ */
+#define RINHA_CONFIG_NATIVE_STACK (64 << 20)
+#define RINHA_CONFIG_NATIVE_OUTPUT_SIZE (1 << 20)
+
+/**
+ * @details
+ * - RINHA_CONFIG_NATIVE_MEMO_BITS: log2 of the entries of the memo of each pure closure
+ *   of one to three parameters in native code (direct mapped; the last call wins).
+ */
+#define RINHA_CONFIG_NATIVE_MEMO_BITS 12
+
+/**
+ * @details
+ * - RINHA_CONFIG_VM_REGISTERS_SIZE: Number of registers of the register VM (--engine=regvm),
+ *   shared by the frames of the active calls.
+ */
+#define RINHA_CONFIG_VM_REGISTERS_SIZE (1 << 22)
+
+/**
+ * @details
+ * - RINHA_CONFIG_VM_DEOPT_LIMIT: Number of times a quickened (type-specialized) VM
+ *   instruction may fall back to its generic form before it stays generic.
+ */
+#define RINHA_CONFIG_VM_DEOPT_LIMIT 4
+
+/**
+ * @details
+ * - RINHA_CONFIG_TIER_REGVM_THRESHOLD: Calls plus backedges (recursive calls) after
+ *   which the tiered engine moves a closure from the token walker to the register VM.
+ * - RINHA_CONFIG_TIER_CLOSURE_THRESHOLD: Calls plus backedges after which it moves
+ *   the closure on to closure compilation.
+ */
+#define RINHA_CONFIG_TIER_REGVM_THRESHOLD 64u
+#define RINHA_CONFIG_TIER_CLOSURE_THRESHOLD 4096u
+
+/**
+ * @details
+ * - RINHA_CONFIG_TIER_BACKGROUND: The tiered engine compiles hot closures on a worker
+ *   thread; they keep running on their current tier until the code is ready.
+ * - RINHA_CONFIG_TIER_QUEUE_SIZE: Maximum number of closures waiting to be compiled.
+ */
+#define RINHA_CONFIG_TIER_BACKGROUND true
+#define RINHA_CONFIG_TIER_QUEUE_SIZE 64
+
 /**
  * @details
  * - RINHA_CONFIG_TOKENS_SIZE: Maximum number of tokens that can be stored in the token array
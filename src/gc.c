@@ -0,0 +1,443 @@
+/**
+ * @file gc.c
+ *
+ * @brief Rinha Language Interpreter - mark and sweep collector
+ *
+ * The heap, the marking and the sweep. See gc.h.
+ */
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "config.h"
+#include "gc.h"
+
+#define GC_PAGE_SIZE ((uintptr_t) RINHA_CONFIG_GC_PAGE_SIZE)
+#define GC_PAGE_OF(p) ((gc_page_t *) ((uintptr_t) (p) & ~(GC_PAGE_SIZE - 1)))
+
+/**
+ * @brief Object sizes of the small pages. Class 0 holds the tuples, the
+ *        others the strings; larger objects get pages of their own.
+ */
+static const size_t gc_classes[] = {
+  32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096,
+  8192, GC_PAGE_SIZE / 4
+};
+
+#define GC_CLASSES (sizeof(gc_classes) / sizeof(gc_classes[0]))
+#define GC_BITMAP (GC_PAGE_SIZE / 32 / 64)
+
+/**
+ * @brief A page of the heap, aligned to its size so that the page of a small
+ *        object is found by masking its address.
+ *
+ * @var next    Next page of the heap.
+ * @var size    Object size (the whole object for a large page).
+ * @var pages   Pages spanned (large objects).
+ * @var klass   Size class, -1 for a large object.
+ * @var kind    Kind of the objects.
+ * @var count   Objects in the page.
+ * @var used    Allocated objects.
+ * @var marks   Objects marked by the running collection.
+ */
+typedef struct gc_page {
+  struct gc_page *next;
+  size_t size;
+  size_t pages;
+  int klass;
+  rinha_gc_kind_t kind;
+  int count;
+  uint64_t used[GC_BITMAP];
+  uint64_t marks[GC_BITMAP];
+  char objects[] __attribute__((aligned(16)));
+} gc_page_t;
+
+static gc_page_t *gc_pages = NULL;
+/* Free objects by kind and class: a page only ever holds one kind */
+static void *gc_free_lists[RINHA_GC_KINDS][GC_CLASSES];
+
+/* Small pages of the previous scripts, reused before asking the system */
+static gc_page_t *gc_spare = NULL;
+static size_t gc_spare_size = 0;
+
+/* The pages by address (every page a large object spans), for the checks */
+static gc_page_t **gc_map = NULL;
+static size_t gc_map_capacity = 0;
+static size_t gc_map_count = 0;
+static uintptr_t gc_low = UINTPTR_MAX;
+static uintptr_t gc_high = 0;
+
+static rinha_gc_hooks_t gc_hooks;
+static void *gc_stack_base = NULL;
+static size_t gc_threshold = 0;
+static size_t gc_allocated = 0;
+static size_t gc_budget = 0;
+static rinha_gc_stats_t gc_stats;
+
+/* Objects marked but not traced yet */
+static void **gc_stack = NULL;
+static size_t gc_stack_count = 0;
+static size_t gc_stack_capacity = 0;
+
+static size_t gc_map_hash_(uintptr_t base) {
+  return (base / GC_PAGE_SIZE * 0x9E3779B97F4A7C15ull) & (gc_map_capacity - 1);
+}
+
+/**
+ * @brief The page holding the page-aligned address `base`, or NULL.
+ */
+static gc_page_t *gc_map_find_(uintptr_t base) {
+  if (!gc_map_count)
+    return NULL;
+
+  for (size_t i = gc_map_hash_(base); gc_map[i];
+       i = (i + 1) & (gc_map_capacity - 1)) {
+    gc_page_t *page = gc_map[i];
+
+    if (base >= (uintptr_t) page &&
+        base < (uintptr_t) page + page->pages * GC_PAGE_SIZE)
+      return page;
+  }
+  return NULL;
+}
+
+static void gc_map_insert_(uintptr_t base, gc_page_t *page) {
+  size_t i = gc_map_hash_(base);
+
+  while (gc_map[i])
+    i = (i + 1) & (gc_map_capacity - 1);
+
+  gc_map[i] = page;
+  gc_map_count++;
+}
+
+/**
+ * @brief Build the page map again, kept at most half full, with an entry for
+ *        every page a large object spans.
+ */
+static void gc_map_build_(size_t pages) {
+  free(gc_map);
+  gc_map_capacity = 256;
+  while (gc_map_capacity < pages * 2)
+    gc_map_capacity *= 2;
+
+  gc_map = calloc(gc_map_capacity, sizeof(gc_page_t *));
+  if (!gc_map) {
+    fprintf(stderr, "Memory allocation failed (collector)\n");
+    exit(EXIT_FAILURE);
+  }
+
+  gc_map_count = 0;
+  gc_low = UINTPTR_MAX;
+  gc_high = 0;
+
+  for (gc_page_t *page = gc_pages; page; page = page->next) {
+    uintptr_t end = (uintptr_t) page + page->pages * GC_PAGE_SIZE;
+
+    for (uintptr_t base = (uintptr_t) page; base < end; base += GC_PAGE_SIZE)
+      gc_map_insert_(base, page);
+
+    if ((uintptr_t) page < gc_low)
+      gc_low = (uintptr_t) page;
+    if (end > gc_high)
+      gc_high = end;
+  }
+}
+
+static gc_page_t *gc_page_new_(size_t pages) {
+  gc_page_t *page;
+
+  if (pages == 1 && gc_spare) {
+    page = gc_spare;
+    gc_spare = page->next;
+    gc_spare_size -= GC_PAGE_SIZE;
+  } else
+    page = aligned_alloc(GC_PAGE_SIZE, pages * GC_PAGE_SIZE);
+
+  if (!page)
+    return NULL;
+
+  memset(page, 0, sizeof(gc_page_t));
+  page->pages = pages;
+  page->next = gc_pages;
+  gc_pages = page;
+  gc_stats.heap += pages * GC_PAGE_SIZE;
+
+  if ((gc_map_count + pages) * 2 > gc_map_capacity) {
+    gc_map_build_(2 * (gc_map_count + pages));
+    return page;
+  }
+
+  for (size_t i = 0; i < pages; ++i)
+    gc_map_insert_((uintptr_t) page + i * GC_PAGE_SIZE, page);
+
+  if ((uintptr_t) page < gc_low)
+    gc_low = (uintptr_t) page;
+  if ((uintptr_t) page + pages * GC_PAGE_SIZE > gc_high)
+    gc_high = (uintptr_t) page + pages * GC_PAGE_SIZE;
+
+  return page;
+}
+
+/**
+ * @brief Thread the free objects of a small page onto the list of its class.
+ */
+static void gc_page_free_objects_(gc_page_t *page) {
+  for (int i = page->count - 1; i >= 0; --i) {
+    if (page->used[i / 64] & (1ull << (i % 64)))
+      continue;
+
+    void **object = (void **) (page->objects + i * page->size);
+    *object = gc_free_lists[page->kind][page->klass];
+    gc_free_lists[page->kind][page->klass] = object;
+  }
+}
+
+/**
+ * @brief The object a pointer points into, or NULL (free objects included).
+ */
+static void *gc_object_(const void *pointer, gc_page_t **owner, int *index) {
+  uintptr_t p = (uintptr_t) pointer;
+
+  if (p < gc_low || p >= gc_high)
+    return NULL;
+
+  gc_page_t *page = gc_map_find_(p & ~(GC_PAGE_SIZE - 1));
+
+  if (!page || p < (uintptr_t) page->objects)
+    return NULL;
+
+  int i = (p - (uintptr_t) page->objects) / page->size;
+
+  if (i >= page->count || !(page->used[i / 64] & (1ull << (i % 64))))
+    return NULL;
+
+  *owner = page;
+  *index = i;
+  return page->objects + i * page->size;
+}
+
+static double gc_now_(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+void rinha_gc_start(const rinha_gc_hooks_t *hooks, void *stack_base,
+                    size_t threshold) {
+  while (gc_pages) {
+    gc_page_t *next = gc_pages->next;
+
+    if (gc_pages->pages == 1 &&
+        gc_spare_size + GC_PAGE_SIZE <= RINHA_CONFIG_GC_KEEP_SIZE) {
+      gc_pages->next = gc_spare;
+      gc_spare = gc_pages;
+      gc_spare_size += GC_PAGE_SIZE;
+    } else
+      free(gc_pages);
+    gc_pages = next;
+  }
+
+  free(gc_map);
+  gc_map = NULL;
+  gc_map_capacity = gc_map_count = 0;
+  gc_low = UINTPTR_MAX;
+  gc_high = 0;
+  memset(gc_free_lists, 0, sizeof(gc_free_lists));
+  memset(&gc_stats, 0, sizeof(gc_stats));
+
+  gc_hooks = *hooks;
+  gc_stack_base = stack_base;
+  gc_threshold = threshold;
+  gc_budget = threshold;
+  gc_allocated = 0;
+}
+
+void *rinha_gc_alloc(rinha_gc_kind_t kind, size_t size) {
+  if (gc_threshold && gc_allocated >= gc_budget)
+    rinha_gc_collect();
+
+  int klass = (kind == RINHA_GC_TUPLE) ? 0 : 1;
+
+  while (klass < (int) GC_CLASSES && gc_classes[klass] < size)
+    ++klass;
+
+  // Large objects: pages of their own
+  if (klass == (int) GC_CLASSES) {
+    size_t pages = (offsetof(gc_page_t, objects) + size + GC_PAGE_SIZE - 1)
+        / GC_PAGE_SIZE;
+    gc_page_t *page = gc_page_new_(pages);
+
+    if (!page)
+      return NULL;
+
+    page->klass = -1;
+    page->kind = kind;
+    page->size = size;
+    page->count = 1;
+    page->used[0] = 1;
+    gc_allocated += size;
+    return page->objects;
+  }
+
+  void **list = &gc_free_lists[kind][klass];
+
+  if (!*list) {
+    gc_page_t *page = gc_page_new_(1);
+
+    if (!page)
+      return NULL;
+
+    page->klass = klass;
+    page->kind = kind;
+    page->size = gc_classes[klass];
+    page->count = (GC_PAGE_SIZE - offsetof(gc_page_t, objects)) / page->size;
+    gc_page_free_objects_(page);
+  }
+
+  void **object = *list;
+  gc_page_t *page = GC_PAGE_OF(object);
+  int i = ((char *) object - page->objects) / page->size;
+
+  *list = *object;
+  page->used[i / 64] |= 1ull << (i % 64);
+  gc_allocated += page->size;
+
+  return object;
+}
+
+void rinha_gc_free(void *object) {
+  gc_page_t *page;
+  int i;
+
+  if (!gc_object_(object, &page, &i) || page->klass < 0)
+    return;
+
+  page->used[i / 64] &= ~(1ull << (i % 64));
+  *(void **) object = gc_free_lists[page->kind][page->klass];
+  gc_free_lists[page->kind][page->klass] = object;
+}
+
+void rinha_gc_mark(const void *pointer) {
+  gc_page_t *page;
+  int i;
+  void *object = gc_object_(pointer, &page, &i);
+
+  if (!object || (page->marks[i / 64] & (1ull << (i % 64))))
+    return;
+
+  page->marks[i / 64] |= 1ull << (i % 64);
+
+  if (gc_stack_count == gc_stack_capacity) {
+    gc_stack_capacity = gc_stack_capacity ? gc_stack_capacity * 2 : 1024;
+    gc_stack = realloc(gc_stack, gc_stack_capacity * sizeof(void *));
+
+    if (!gc_stack) {
+      fprintf(stderr, "Memory allocation failed (collector)\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  gc_stack[gc_stack_count++] = object;
+}
+
+void rinha_gc_mark_range(const void *from, const void *to) {
+  for (const uintptr_t *word = from; (const void *) (word + 1) <= to; ++word)
+    rinha_gc_mark((const void *) *word);
+}
+
+bool rinha_gc_marked(const void *pointer) {
+  gc_page_t *page;
+  int i;
+
+  return gc_object_(pointer, &page, &i)
+      && (page->marks[i / 64] & (1ull << (i % 64)));
+}
+
+/**
+ * @brief Scan the machine stack, with the callee-saved registers spilled on it.
+ */
+static void __attribute__((noinline)) gc_mark_stack_(void) {
+  jmp_buf registers;
+
+  setjmp(registers);
+  rinha_gc_mark_range(&registers, gc_stack_base);
+}
+
+void rinha_gc_collect(void) {
+  double start = gc_now_();
+  size_t freed = 0, live = 0;
+
+  gc_hooks.roots();
+  gc_mark_stack_();
+
+  while (gc_stack_count) {
+    void *object = gc_stack[--gc_stack_count];
+    gc_hooks.trace(object, GC_PAGE_OF(object)->kind);
+  }
+
+  gc_hooks.weak();
+
+  // Sweep: unmarked objects are freed, empty pages returned to the system
+  bool released = false;
+
+  memset(gc_free_lists, 0, sizeof(gc_free_lists));
+  for (gc_page_t **link = &gc_pages; *link;) {
+    gc_page_t *page = *link;
+    int alive = 0;
+
+    for (size_t w = 0; w < GC_BITMAP; ++w) {
+      uint64_t dead = page->used[w] & ~page->marks[w];
+
+      freed += __builtin_popcountll(dead) * page->size;
+      page->used[w] &= page->marks[w];
+      alive += __builtin_popcountll(page->used[w]);
+      page->marks[w] = 0;
+    }
+
+    if (!alive) {
+      *link = page->next;
+      gc_stats.heap -= page->pages * GC_PAGE_SIZE;
+      free(page);
+      released = true;
+      continue;
+    }
+
+    live += alive * page->size;
+    if (page->klass >= 0)
+      gc_page_free_objects_(page);
+    link = &page->next;
+  }
+
+  if (released)
+    gc_map_build_(gc_map_count);
+
+  // The next collection when as much again as is alive was allocated
+  gc_allocated = 0;
+  gc_budget = live * (RINHA_CONFIG_GC_GROWTH - 1);
+  if (gc_budget < gc_threshold)
+    gc_budget = gc_threshold;
+
+  double pause = gc_now_() - start;
+
+  gc_stats.collections++;
+  gc_stats.pause_total += pause;
+  if (pause > gc_stats.pause_max)
+    gc_stats.pause_max = pause;
+  gc_stats.freed += freed;
+  gc_stats.live = live;
+}
+
+const rinha_gc_stats_t *rinha_gc_stats(void) {
+  return &gc_stats;
+}
+
+void rinha_gc_report(FILE *out) {
+  fprintf(out, "gc: %u collections, pause total %.3f ms, max %.3f ms, "
+          "freed %zu bytes, live %zu bytes, heap %zu bytes\n",
+          gc_stats.collections, gc_stats.pause_total, gc_stats.pause_max,
+          gc_stats.freed, gc_stats.live, gc_stats.heap);
+}
@@ -0,0 +1,118 @@
+/**
+ * @file gc.h
+ *
+ * @brief Rinha Language Interpreter - mark and sweep collector
+ *
+ * Strings, tuples and bignums live in a collected heap: pages holding objects
+ * of one size class each, and large objects in pages of their own. When the
+ * bytes allocated since the last collection exceed the budget, the heap is
+ * marked from the roots and the unmarked objects go back to the free lists of
+ * their class; pages left empty are returned to the system.
+ *
+ * The interpreter gives the roots precisely (frames, closure environments,
+ * registers, literals) and knows how to trace its objects. The machine stack
+ * is scanned conservatively, since the token walker keeps temporaries in C
+ * locals. Every pointer is checked against the heap before it is marked, so
+ * a stale root only keeps an object alive a little longer.
+ *
+ * Only the main thread allocates from this heap.
+ */
+
+#ifndef _LA_RINHA_GC_H
+#define _LA_RINHA_GC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum {
+    RINHA_GC_TUPLE,
+    RINHA_GC_STRING,
+    RINHA_GC_BIGNUM,
+    RINHA_GC_KINDS
+} rinha_gc_kind_t;
+
+/**
+ * @brief How the interpreter takes part in a collection.
+ *
+ * @var roots  Mark the roots (rinha_gc_mark, rinha_gc_mark_range).
+ * @var trace  Mark the objects an object refers to.
+ * @var weak   Called after marking: drop the unmarked entries of weak tables
+ *             (rinha_gc_marked), such as the string intern table.
+ */
+typedef struct {
+    void (*roots)(void);
+    void (*trace)(void *object, rinha_gc_kind_t kind);
+    void (*weak)(void);
+} rinha_gc_hooks_t;
+
+/**
+ * @brief Collector statistics of the current script.
+ *
+ * @var collections  Number of collections.
+ * @var pause_total  Time spent collecting (ms).
+ * @var pause_max    Longest collection (ms).
+ * @var freed        Bytes of objects freed.
+ * @var live         Bytes of objects alive after the last collection.
+ * @var heap         Bytes of pages held from the system.
+ */
+typedef struct {
+    unsigned int collections;
+    double pause_total;
+    double pause_max;
+    size_t freed;
+    size_t live;
+    size_t heap;
+} rinha_gc_stats_t;
+
+/**
+ * @brief Release the heap of the previous script and start a new one.
+ *
+ * @param hooks       The interpreter side of a collection (copied).
+ * @param stack_base  The highest address of the machine stack to scan.
+ * @param threshold   Minimum bytes allocated between two collections; 0 never
+ *                    collects.
+ */
+void rinha_gc_start(const rinha_gc_hooks_t *hooks, void *stack_base,
+                    size_t threshold);
+
+/**
+ * @brief Allocate an object, collecting first when the budget is spent.
+ *
+ * @return The object (uninitialized).
+ */
+void *rinha_gc_alloc(rinha_gc_kind_t kind, size_t size);
+
+/**
+ * @brief Give back an object nothing refers to yet.
+ */
+void rinha_gc_free(void *object);
+
+/**
+ * @brief Mark the object a pointer points into (anything else is ignored).
+ */
+void rinha_gc_mark(const void *pointer);
+
+/**
+ * @brief Mark the objects pointed to by the words of a memory range.
+ */
+void rinha_gc_mark_range(const void *from, const void *to);
+
+/**
+ * @brief Whether the object a pointer points into was marked (weak hook).
+ */
+bool rinha_gc_marked(const void *pointer);
+
+/**
+ * @brief Collect now.
+ */
+void rinha_gc_collect(void);
+
+const rinha_gc_stats_t *rinha_gc_stats(void);
+
+/**
+ * @brief Print the statistics of the current script.
+ */
+void rinha_gc_report(FILE *out);
+
+#endif
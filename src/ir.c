@@ -0,0 +1,1505 @@
+/**
+ * @file ir.c
+ *
+ * @brief Rinha Language Interpreter - SSA intermediate representation
+ *
+ * Lowering of closure bodies from tokens to SSA, the optimization passes and
+ * the pass manager. See ir.h.
+ */
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bignum.h"
+#include "ir.h"
+
+/**
+ * @brief Maximum number of instructions of a closure that can be inlined.
+ */
+#define IR_INLINE_SIZE 32
+
+/**
+ * @brief Maximum number of times the pass pipeline runs over a function.
+ */
+#define IR_ROUNDS 4
+
+// ---------------------------------------------------------------------------
+// Construction
+// ---------------------------------------------------------------------------
+
+static void *ir_grow_(void *ptr, int *capacity, int needed, size_t size) {
+  if (needed <= *capacity)
+    return ptr;
+
+  int capacity_ = *capacity ? *capacity : 16;
+
+  while (capacity_ < needed)
+    capacity_ *= 2;
+
+  ptr = realloc(ptr, capacity_ * size);
+
+  if (!ptr) {
+    fprintf(stderr, "Memory allocation failed (IR)\n");
+    exit(EXIT_FAILURE);
+  }
+
+  *capacity = capacity_;
+  return ptr;
+}
+
+/**
+ * @brief Create an instruction (not yet in a block).
+ *
+ * @param extra  Operand slots reserved after the `argc` operands (closure hashes).
+ */
+static int ir_inst_new_(ir_function_t *fn, ir_op op, int argc, int extra) {
+  fn->insts = ir_grow_(fn->insts, &fn->capacity, fn->count + 1,
+      sizeof(ir_inst_t));
+  fn->operands = ir_grow_(fn->operands, &fn->operands_capacity,
+      fn->operands_count + argc + extra, sizeof(int));
+
+  ir_inst_t *inst = &fn->insts[fn->count];
+  memset(inst, 0, sizeof(ir_inst_t));
+  inst->op = op;
+  inst->block = -1;
+  inst->next = -1;
+  inst->args = fn->operands_count;
+  inst->argc = argc;
+  inst->target[0] = inst->target[1] = -1;
+
+  fn->operands_count += argc + extra;
+  return fn->count++;
+}
+
+static int ir_block_new_(ir_function_t *fn) {
+  fn->blocks = ir_grow_(fn->blocks, &fn->blocks_capacity, fn->blocks_count + 1,
+      sizeof(ir_block_t));
+
+  ir_block_t *block = &fn->blocks[fn->blocks_count];
+  block->first = block->last = -1;
+  block->npreds = 0;
+  return fn->blocks_count++;
+}
+
+/**
+ * @brief Link an instruction into a block, after `prev` (-1: at the start).
+ */
+static void ir_insert_(ir_function_t *fn, int block, int prev, int id) {
+  ir_block_t *b = &fn->blocks[block];
+  ir_inst_t *inst = &fn->insts[id];
+
+  inst->block = block;
+
+  if (prev < 0) {
+    inst->next = b->first;
+    b->first = id;
+  } else {
+    inst->next = fn->insts[prev].next;
+    fn->insts[prev].next = id;
+  }
+
+  if (inst->next < 0)
+    b->last = id;
+}
+
+static void ir_append_(ir_function_t *fn, int block, int id) {
+  ir_insert_(fn, block, fn->blocks[block].last, id);
+}
+
+static void ir_remove_(ir_function_t *fn, int id) {
+  fn->insts[id].op = IR_NOP;
+  fn->insts[id].argc = 0;
+}
+
+static void ir_replace_uses_(ir_function_t *fn, int from, int to) {
+  for (register int i = 0; i < fn->count; ++i) {
+    ir_inst_t *inst = &fn->insts[i];
+    for (register int j = 0; j < inst->argc; ++j) {
+      if (IR_OPERAND(fn, inst, j) == from)
+        IR_OPERAND(fn, inst, j) = to;
+    }
+  }
+}
+
+/**
+ * @brief Remove the edge pred -> block, dropping the matching phi operands.
+ */
+static void ir_remove_pred_(ir_function_t *fn, int block, int pred) {
+  ir_block_t *b = &fn->blocks[block];
+  int k = 0;
+
+  while (k < b->npreds && b->preds[k] != pred)
+    k++;
+
+  if (k == b->npreds)
+    return;
+
+  for (register int i = k; i < b->npreds - 1; ++i)
+    b->preds[i] = b->preds[i + 1];
+  b->npreds--;
+
+  for (int id = b->first; id >= 0; id = fn->insts[id].next) {
+    ir_inst_t *inst = &fn->insts[id];
+
+    if (inst->op != IR_PHI)
+      continue;
+
+    for (register int i = k; i < inst->argc - 1; ++i)
+      IR_OPERAND(fn, inst, i) = IR_OPERAND(fn, inst, i + 1);
+    inst->argc--;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Builder: tokens -> SSA
+// ---------------------------------------------------------------------------
+
+typedef struct {
+  int hash;
+  int value;
+} ir_binding_t;
+
+/**
+ * @brief State of the builder.
+ *
+ * @var t          Current token.
+ * @var block      Block receiving new instructions.
+ * @var bindings   Parameters and `let` bindings in scope (latest last).
+ * @var fail       Where unsupported constructs bail out to.
+ */
+typedef struct {
+  ir_function_t *fn;
+  token_t *t;
+  int block;
+  ir_binding_t bindings[RINHA_CONFIG_SYMBOLS_SIZE];
+  int nbindings;
+  jmp_buf fail;
+} ir_builder_t;
+
+static void ir_fail_(ir_builder_t *b, const char *why) {
+  b->fn->error = why;
+  longjmp(b->fail, 1);
+}
+
+static void ir_expect_(ir_builder_t *b, token_type type) {
+  if (b->t->type != type)
+    ir_fail_(b, "unexpected token");
+  b->t++;
+}
+
+static void ir_bind_(ir_builder_t *b, int hash, int value) {
+  if (b->nbindings >= RINHA_CONFIG_SYMBOLS_SIZE)
+    ir_fail_(b, "too many bindings");
+
+  b->bindings[b->nbindings].hash = hash;
+  b->bindings[b->nbindings++].value = value;
+}
+
+static int ir_lookup_(ir_builder_t *b, int hash) {
+  for (register int i = b->nbindings - 1; i >= 0; --i) {
+    if (b->bindings[i].hash == hash)
+      return b->bindings[i].value;
+  }
+  return -1;
+}
+
+static int ir_emit_(ir_builder_t *b, ir_op op, int argc, token_t *token) {
+  int id = ir_inst_new_(b->fn, op, argc, 0);
+  b->fn->insts[id].token = token;
+  ir_append_(b->fn, b->block, id);
+  return id;
+}
+
+static int ir_unary_(ir_builder_t *b, ir_op op, int value, token_t *token) {
+  int id = ir_emit_(b, op, 1, token);
+  IR_OPERAND(b->fn, &b->fn->insts[id], 0) = value;
+  return id;
+}
+
+static int ir_binary_(ir_builder_t *b, ir_op op, int left, int right,
+    token_t *token) {
+  int id = ir_emit_(b, op, 2, token);
+  IR_OPERAND(b->fn, &b->fn->insts[id], 0) = left;
+  IR_OPERAND(b->fn, &b->fn->insts[id], 1) = right;
+  return id;
+}
+
+static void ir_edge_(ir_builder_t *b, int from, int to) {
+  ir_block_t *block = &b->fn->blocks[to];
+
+  if (block->npreds >= 2)
+    ir_fail_(b, "too many predecessors");
+  block->preds[block->npreds++] = from;
+}
+
+static void ir_jump_(ir_builder_t *b, int target) {
+  int id = ir_emit_(b, IR_JUMP, 0, b->t);
+  b->fn->insts[id].target[0] = target;
+  ir_edge_(b, b->block, target);
+}
+
+static void ir_branch_(ir_builder_t *b, int cond, int on_true, int on_false) {
+  int id = ir_unary_(b, IR_BRANCH, cond, b->t);
+  b->fn->insts[id].target[0] = on_true;
+  b->fn->insts[id].target[1] = on_false;
+  ir_edge_(b, b->block, on_true);
+  ir_edge_(b, b->block, on_false);
+}
+
+static int ir_expression_(ir_builder_t *b);
+static int ir_logical_or_(ir_builder_t *b);
+static int ir_logical_and_(ir_builder_t *b);
+static int ir_statement_(ir_builder_t *b, int value);
+static int ir_body_(ir_builder_t *b);
+
+/**
+ * @brief `fn (params) => body`: only captures the bindings in scope; the body
+ *        is lowered on its own.
+ */
+static int ir_closure_(ir_builder_t *b, int hash) {
+  token_t *fn_token = b->t;
+  token_t *end = rinha_token_skip_value(fn_token);
+
+  if (end->type == TOKEN_RPAREN && (end + 1)->type == TOKEN_LPAREN)
+    ir_fail_(b, "closure called in place");
+
+  // Latest binding of each symbol
+  int captured[RINHA_CONFIG_SYMBOLS_SIZE];
+  int n = 0;
+
+  for (register int i = b->nbindings - 1; i >= 0; --i) {
+    bool seen = false;
+    for (register int j = 0; j < n && !seen; ++j)
+      seen = (b->bindings[captured[j]].hash == b->bindings[i].hash);
+    if (!seen)
+      captured[n++] = i;
+  }
+
+  int id = ir_inst_new_(b->fn, IR_CLOSURE, n, n);
+  ir_inst_t *inst = &b->fn->insts[id];
+  inst->token = fn_token;
+  inst->hash = hash;
+
+  for (register int i = 0; i < n; ++i) {
+    IR_OPERAND(b->fn, inst, i) = b->bindings[captured[i]].value;
+    IR_CAPTURE_HASH(b->fn, inst, i) = b->bindings[captured[i]].hash;
+  }
+  ir_append_(b->fn, b->block, id);
+
+  b->t = end;
+  return id;
+}
+
+static int ir_call_(ir_builder_t *b, int callee, token_t *token) {
+  int args[RINHA_CONFIG_FUNCTION_ARGS_SIZE];
+  int n = 0;
+
+  ir_expect_(b, TOKEN_LPAREN);
+
+  while (b->t->type != TOKEN_RPAREN) {
+    if (n >= RINHA_CONFIG_FUNCTION_ARGS_SIZE)
+      ir_fail_(b, "too many arguments");
+
+    args[n++] = ir_expression_(b);
+
+    if (b->t->type == TOKEN_COMMA)
+      b->t++;
+    else if (b->t->type != TOKEN_RPAREN)
+      ir_fail_(b, "unexpected token in call");
+  }
+  b->t++;
+
+  int id = ir_emit_(b, IR_CALL, n + 1, token);
+  ir_inst_t *inst = &b->fn->insts[id];
+
+  IR_OPERAND(b->fn, inst, 0) = callee;
+  for (register int i = 0; i < n; ++i)
+    IR_OPERAND(b->fn, inst, i + 1) = args[i];
+
+  return id;
+}
+
+static int ir_print_(ir_builder_t *b) {
+  token_t *token = b->t++;
+
+  ir_expect_(b, TOKEN_LPAREN);
+  int value = ir_expression_(b);
+  ir_expect_(b, TOKEN_RPAREN);
+
+  return ir_unary_(b, IR_PRINT, value, token);
+}
+
+/**
+ * @brief if/else as an expression. Without else, the value of the false branch is
+ *        the condition, like in rinha_exec_if_statement_.
+ *
+ * Bindings made in both branches are merged with phis; a binding made in only
+ * one of them is not supported.
+ */
+static int ir_if_(ir_builder_t *b) {
+  token_t *token = b->t++;
+
+  ir_expect_(b, TOKEN_LPAREN);
+  int cond = ir_logical_or_(b);
+  ir_expect_(b, TOKEN_RPAREN);
+
+  int then_block = ir_block_new_(b->fn);
+  int else_block = ir_block_new_(b->fn);
+  int join = ir_block_new_(b->fn);
+
+  ir_branch_(b, ir_unary_(b, IR_BOOL, cond, token), then_block, else_block);
+
+  int scope = b->nbindings;
+
+  b->block = then_block;
+  int then_value = ir_body_(b);
+  ir_binding_t then_bindings[RINHA_CONFIG_SYMBOLS_SIZE];
+  int then_count = b->nbindings - scope;
+  memcpy(then_bindings, &b->bindings[scope], then_count * sizeof(ir_binding_t));
+  ir_jump_(b, join);
+
+  b->nbindings = scope;
+  b->block = else_block;
+
+  int else_value = cond;
+
+  if (b->t->type == TOKEN_ELSE) {
+    b->t++;
+    else_value = ir_body_(b);
+  }
+  ir_jump_(b, join);
+
+  ir_binding_t else_bindings[RINHA_CONFIG_SYMBOLS_SIZE];
+  int else_count = b->nbindings - scope;
+  memcpy(else_bindings, &b->bindings[scope], else_count * sizeof(ir_binding_t));
+  b->nbindings = scope;
+
+  b->block = join;
+  int value = ir_binary_(b, IR_PHI, then_value, else_value, token);
+
+  for (register int i = 0; i < then_count; ++i) {
+    int other = -1;
+    for (register int j = 0; j < else_count; ++j) {
+      if (else_bindings[j].hash == then_bindings[i].hash)
+        other = else_bindings[j].value;
+    }
+    if (other < 0)
+      ir_fail_(b, "binding in a single branch");
+    ir_bind_(b, then_bindings[i].hash,
+        ir_binary_(b, IR_PHI, then_bindings[i].value, other, token));
+  }
+
+  if (else_count > then_count)
+    ir_fail_(b, "binding in a single branch");
+
+  return value;
+}
+
+/**
+ * @brief `a && b` / `a || b`: the right operand is only evaluated when needed.
+ */
+static int ir_short_circuit_(ir_builder_t *b, token_t *token, int left,
+    bool is_and) {
+  int cond = ir_unary_(b, IR_BOOL, left, token);
+  int rhs = ir_block_new_(b->fn);
+  int skip = ir_block_new_(b->fn);
+  int join = ir_block_new_(b->fn);
+
+  ir_branch_(b, cond, is_and ? rhs : skip, is_and ? skip : rhs);
+
+  b->block = skip;
+  ir_jump_(b, join);
+
+  int scope = b->nbindings;
+
+  b->block = rhs;
+  int right = is_and ? ir_expression_(b) : ir_logical_and_(b);
+  right = ir_unary_(b, IR_BOOL, right, token);
+  ir_jump_(b, join);
+
+  if (b->nbindings != scope)
+    ir_fail_(b, "binding in a logical operand");
+
+  b->block = join;
+  return ir_binary_(b, IR_PHI, cond, right, token);
+}
+
+static int ir_let_(ir_builder_t *b, int value) {
+  token_t *let = b->t;
+
+  // Removed by the load-time optimizer
+  if (let->jmp_pc3) {
+    b->t = let->jmp_pc3;
+    return value;
+  }
+
+  token_t *name = ++b->t;
+
+  if (name->type == TOKEN_WILDCARD) {
+    // `let _ = expr`: the expression is the next statement
+    b->t++;
+    ir_expect_(b, TOKEN_ASSIGN);
+    return value;
+  }
+
+  ir_expect_(b, TOKEN_IDENTIFIER);
+  ir_expect_(b, TOKEN_ASSIGN);
+
+  value = (b->t->type == TOKEN_FN)
+      ? ir_closure_(b, name->hash) : ir_expression_(b);
+
+  ir_bind_(b, name->hash, value);
+  return value;
+}
+
+static int ir_primary_(ir_builder_t *b) {
+  token_t *token = b->t;
+  int value;
+
+  switch (token->type) {
+    case TOKEN_IDENTIFIER:
+      b->t++;
+      value = ir_lookup_(b, token->hash);
+      if (value < 0) {
+        value = ir_emit_(b, IR_LOAD_FREE, 0, token);
+        b->fn->insts[value].hash = token->hash;
+      }
+      return (b->t->type == TOKEN_LPAREN) ? ir_call_(b, value, token) : value;
+    case TOKEN_FN:
+      return ir_closure_(b, token->hash);
+    case TOKEN_NUMBER:
+    case TOKEN_TRUE:
+    case TOKEN_FALSE:
+    case TOKEN_STRING:
+      b->t++;
+      value = ir_emit_(b, IR_CONST, 0, token);
+      b->fn->insts[value].value = token->value;
+      return value;
+    case TOKEN_LPAREN:
+      b->t++;
+      if (b->t->type == TOKEN_LET) {
+        ir_let_(b, -1);
+        ir_expect_(b, TOKEN_SEMICOLON);
+      }
+      value = ir_expression_(b);
+      if (b->t->type == TOKEN_COMMA) {
+        b->t++;
+        value = ir_binary_(b, IR_TUPLE, value, ir_expression_(b), token);
+      }
+      ir_expect_(b, TOKEN_RPAREN);
+      return value;
+    case TOKEN_FIRST:
+    case TOKEN_SECOND:
+      b->t++;
+      ir_expect_(b, TOKEN_LPAREN);
+      value = ir_expression_(b);
+      ir_expect_(b, TOKEN_RPAREN);
+      return ir_unary_(b, (token->type == TOKEN_FIRST) ? IR_FIRST : IR_SECOND,
+          value, token);
+    case TOKEN_IF:
+      return ir_if_(b);
+    case TOKEN_PRINT:
+      return ir_print_(b);
+    default:
+      ir_fail_(b, "unsupported expression");
+  }
+  return -1;
+}
+
+static int ir_term_(ir_builder_t *b) {
+  int left = ir_primary_(b);
+
+  for (;;) {
+    token_t *token = b->t;
+    ir_op op;
+
+    switch (token->type) {
+      case TOKEN_MULTIPLY: op = IR_MUL; break;
+      case TOKEN_DIVIDE:   op = IR_DIV; break;
+      case TOKEN_MOD:      op = IR_MOD; break;
+      default:
+        return left;
+    }
+    b->t++;
+    left = ir_binary_(b, op, left, ir_primary_(b), token);
+  }
+}
+
+static int ir_calc_(ir_builder_t *b) {
+  int left = ir_term_(b);
+
+  while (b->t->type == TOKEN_PLUS || b->t->type == TOKEN_MINUS) {
+    token_t *token = b->t++;
+    left = ir_binary_(b, (token->type == TOKEN_PLUS) ? IR_ADD : IR_SUB,
+        left, ir_term_(b), token);
+  }
+  return left;
+}
+
+static int ir_comparison_(ir_builder_t *b) {
+  int left = ir_calc_(b);
+
+  for (;;) {
+    token_t *token = b->t;
+    ir_op op;
+
+    switch (token->type) {
+      case TOKEN_EQ:  op = IR_EQ;  break;
+      case TOKEN_NEQ: op = IR_NEQ; break;
+      case TOKEN_LT:  op = IR_LT;  break;
+      case TOKEN_LTE: op = IR_LTE; break;
+      case TOKEN_GT:  op = IR_GT;  break;
+      case TOKEN_GTE: op = IR_GTE; break;
+      default:
+        return left;
+    }
+    b->t++;
+    left = ir_binary_(b, op, left, ir_calc_(b), token);
+  }
+}
+
+static int ir_logical_and_(ir_builder_t *b) {
+  int left = ir_comparison_(b);
+
+  while (b->t->type == TOKEN_AND) {
+    token_t *token = b->t++;
+    left = ir_short_circuit_(b, token, left, true);
+  }
+  return left;
+}
+
+static int ir_logical_or_(ir_builder_t *b) {
+  int left = ir_logical_and_(b);
+
+  while (b->t->type == TOKEN_OR) {
+    token_t *token = b->t++;
+    left = ir_short_circuit_(b, token, left, false);
+  }
+  return left;
+}
+
+static int ir_expression_(ir_builder_t *b) {
+  int value = ir_logical_or_(b);
+
+  if (b->t->type == TOKEN_ASSIGN)
+    ir_fail_(b, "assignment");
+  return value;
+}
+
+/**
+ * @brief Lower a statement.
+ *
+ * @param value  The value of the enclosing block so far (-1: none).
+ * @return The value of the block after the statement.
+ */
+static int ir_statement_(ir_builder_t *b, int value) {
+  switch (b->t->type) {
+    case TOKEN_LET:
+      return ir_let_(b, value);
+    case TOKEN_SEMICOLON:
+    case TOKEN_RPAREN:
+      b->t++;
+      return value;
+    case TOKEN_FN:
+      return ir_closure_(b, b->t->hash);
+    case TOKEN_PRINT:
+      return ir_print_(b);
+    case TOKEN_IF:
+      return ir_if_(b);
+    case TOKEN_IDENTIFIER:
+    case TOKEN_NUMBER:
+    case TOKEN_STRING:
+    case TOKEN_TRUE:
+    case TOKEN_FALSE:
+    case TOKEN_FIRST:
+    case TOKEN_SECOND:
+    case TOKEN_LPAREN:
+      return ir_expression_(b);
+    default:
+      ir_fail_(b, "unsupported statement");
+  }
+  return -1;
+}
+
+/**
+ * @brief A braced block of statements, or a single statement.
+ */
+static int ir_body_(ir_builder_t *b) {
+  int value = -1;
+
+  if (b->t->type != TOKEN_LBRACE) {
+    value = ir_statement_(b, value);
+  } else {
+    b->t++;
+    while (b->t->type != TOKEN_RBRACE) {
+      if (b->t->type == TOKEN_EOF)
+        ir_fail_(b, "unexpected end of file");
+      value = ir_statement_(b, value);
+    }
+    b->t++;
+  }
+
+  if (value < 0)
+    ir_fail_(b, "block without value");
+  return value;
+}
+
+ir_function_t *rinha_ir_build(token_t *fn_token, int hash) {
+  ir_function_t *fn = calloc(1, sizeof(ir_function_t));
+
+  if (!fn)
+    return NULL;
+
+  fn->fn = fn_token;
+  fn->hash = hash;
+
+  ir_builder_t *b = malloc(sizeof(ir_builder_t));
+
+  if (!b) {
+    fn->error = "out of memory";
+    return fn;
+  }
+
+  b->fn = fn;
+  b->t = fn_token;
+  b->nbindings = 0;
+  b->block = ir_block_new_(fn);
+
+  if (setjmp(b->fail)) {
+    free(b);
+    return fn;
+  }
+
+  ir_expect_(b, TOKEN_FN);
+  ir_expect_(b, TOKEN_LPAREN);
+
+  while (b->t->type != TOKEN_RPAREN) {
+    if (b->t->type == TOKEN_IDENTIFIER) {
+      if (fn->params >= RINHA_CONFIG_FUNCTION_ARGS_SIZE)
+        ir_fail_(b, "too many parameters");
+
+      int param = ir_emit_(b, IR_PARAM, 0, b->t);
+      fn->insts[param].arg = fn->params;
+      fn->param_hash[fn->params++] = b->t->hash;
+      ir_bind_(b, b->t->hash, param);
+    } else if (b->t->type != TOKEN_COMMA) {
+      ir_fail_(b, "unexpected token in parameters");
+    }
+    b->t++;
+  }
+  b->t++;
+  ir_expect_(b, TOKEN_ARROW);
+
+  ir_unary_(b, IR_RETURN, ir_body_(b), b->t);
+
+  if (b->t != rinha_token_skip_value(fn_token))
+    ir_fail_(b, "unexpected end of closure");
+
+  free(b);
+  return fn;
+}
+
+ir_function_t *rinha_ir_build_program(token_t *tokens) {
+  ir_function_t *fn = calloc(1, sizeof(ir_function_t));
+
+  if (!fn)
+    return NULL;
+
+  fn->fn = tokens;
+
+  ir_builder_t *b = malloc(sizeof(ir_builder_t));
+
+  if (!b) {
+    fn->error = "out of memory";
+    return fn;
+  }
+
+  b->fn = fn;
+  b->t = tokens;
+  b->nbindings = 0;
+  b->block = ir_block_new_(fn);
+
+  if (setjmp(b->fail)) {
+    free(b);
+    return fn;
+  }
+
+  int value = -1;
+
+  while (b->t->type != TOKEN_EOF)
+    value = ir_statement_(b, value);
+
+  if (value < 0)
+    ir_fail_(b, "empty script");
+
+  ir_unary_(b, IR_RETURN, value, b->t);
+
+  free(b);
+  return fn;
+}
+
+void rinha_ir_free(ir_function_t *fn) {
+  if (!fn)
+    return;
+
+  free(fn->insts);
+  free(fn->operands);
+  free(fn->blocks);
+  free(fn);
+}
+
+// ---------------------------------------------------------------------------
+// Passes
+// ---------------------------------------------------------------------------
+
+inline static bool ir_is_const_(ir_function_t *fn, int id, value_type type) {
+  return fn->insts[id].op == IR_CONST && fn->insts[id].value.type == type;
+}
+
+/**
+ * @brief A stable, safe closure: calling it has no side effects and does not
+ *        fail on a division by zero or on first/second (see symbol_t).
+ */
+static bool ir_is_safe_callee_(ir_function_t *fn, int id) {
+  ir_inst_t *inst = &fn->insts[id];
+
+  if (inst->op != IR_LOAD_FREE && inst->op != IR_LOAD_GLOBAL)
+    return false;
+
+  symbol_t *sym = rinha_symbol_get(inst->hash);
+  return sym && sym->stable && sym->safe;
+}
+
+/**
+ * @brief Constant folding, copy propagation of phis and first/second, and
+ *        branches on constants.
+ */
+static bool ir_pass_fold_(ir_function_t *fn) {
+  bool changed = false;
+
+  for (register int i = 0; i < fn->count; ++i) {
+    ir_inst_t *inst = &fn->insts[i];
+    int a = (inst->argc > 0) ? IR_OPERAND(fn, inst, 0) : -1;
+    int c = (inst->argc > 1) ? IR_OPERAND(fn, inst, 1) : -1;
+
+    switch (inst->op) {
+      case IR_ADD:
+      case IR_SUB:
+      case IR_MUL:
+      case IR_DIV:
+      case IR_MOD:
+      case IR_LT:
+      case IR_LTE:
+      case IR_GT:
+      case IR_GTE:
+      case IR_EQ:
+      case IR_NEQ: {
+        if (!ir_is_const_(fn, a, INTEGER) || !ir_is_const_(fn, c, INTEGER))
+          break;
+
+        RINHA_WORD l = fn->insts[a].value.number;
+        RINHA_WORD r = fn->insts[c].value.number;
+        rinha_value_t v = {0};
+        v.type = INTEGER;
+
+        // A result that leaves the word is a bignum: left to run time
+        switch (inst->op) {
+          case IR_ADD:
+            if (__builtin_add_overflow(l, r, &v.number))
+              continue;
+            break;
+          case IR_SUB:
+            if (__builtin_sub_overflow(l, r, &v.number))
+              continue;
+            break;
+          case IR_MUL:
+            if (__builtin_mul_overflow(l, r, &v.number))
+              continue;
+            break;
+          case IR_DIV:
+          case IR_MOD:
+            if (r == 0 || (r == -1 && l == INT64_MIN))
+              continue;
+            v.number = (inst->op == IR_DIV) ? l / r : l % r;
+            break;
+          default:
+            v.type = BOOLEAN;
+            switch (inst->op) {
+              case IR_LT:  v.boolean = l < r;  break;
+              case IR_LTE: v.boolean = l <= r; break;
+              case IR_GT:  v.boolean = l > r;  break;
+              case IR_GTE: v.boolean = l >= r; break;
+              case IR_EQ:  v.boolean = l == r; break;
+              default:     v.boolean = l != r;
+            }
+        }
+        inst->op = IR_CONST;
+        inst->argc = 0;
+        inst->value = v;
+        changed = true;
+      } break;
+      case IR_BOOL:
+        if (fn->insts[a].op == IR_CONST) {
+          bool b = fn->insts[a].value.boolean;
+          inst->op = IR_CONST;
+          inst->argc = 0;
+          memset(&inst->value, 0, sizeof(inst->value));
+          inst->value.type = BOOLEAN;
+          inst->value.boolean = b;
+          changed = true;
+        } else if (fn->insts[a].op == IR_BOOL ||
+                   fn->insts[a].type == BOOLEAN) {
+          ir_replace_uses_(fn, i, a);
+          ir_remove_(fn, i);
+          changed = true;
+        }
+        break;
+      case IR_FIRST:
+      case IR_SECOND:
+        if (fn->insts[a].op == IR_TUPLE) {
+          ir_replace_uses_(fn, i,
+              IR_OPERAND(fn, &fn->insts[a], inst->op == IR_FIRST ? 0 : 1));
+          ir_remove_(fn, i);
+          changed = true;
+        }
+        break;
+      case IR_PHI: {
+        bool same = true;
+        for (register int j = 1; j < inst->argc; ++j)
+          same = same && (IR_OPERAND(fn, inst, j) == a);
+        if (same && a >= 0 && a != i) {
+          ir_replace_uses_(fn, i, a);
+          ir_remove_(fn, i);
+          changed = true;
+        }
+      } break;
+      case IR_BRANCH:
+        if (fn->insts[a].op == IR_CONST) {
+          int taken = fn->insts[a].value.boolean ? 0 : 1;
+          ir_remove_pred_(fn, inst->target[1 - taken], inst->block);
+          inst->op = IR_JUMP;
+          inst->argc = 0;
+          inst->target[0] = inst->target[taken];
+          inst->target[1] = -1;
+          changed = true;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  return changed;
+}
+
+static void ir_reachable_(ir_function_t *fn, int block, bool *seen) {
+  if (block < 0 || seen[block])
+    return;
+
+  seen[block] = true;
+
+  int last = fn->blocks[block].last;
+
+  if (last >= 0) {
+    ir_reachable_(fn, fn->insts[last].target[0], seen);
+    ir_reachable_(fn, fn->insts[last].target[1], seen);
+  }
+}
+
+/**
+ * @brief Type of a value given that the instruction computing it succeeded
+ *        (INTEGER: a word or a bignum; UNDEFINED: unknown).
+ */
+static value_type ir_known_type_(ir_function_t *fn, int id) {
+  ir_inst_t *inst = &fn->insts[id];
+
+  if (inst->op == IR_CONST)
+    return (inst->value.type == BIGINT) ? INTEGER : inst->value.type;
+  return inst->type;
+}
+
+/**
+ * @brief Check if a symbol is bound whenever the closure runs: a stable closure
+ *        bound before the closure is created (one bound later may still be
+ *        undefined when the closure is called).
+ */
+static bool ir_is_bound_(ir_function_t *fn, int hash) {
+  symbol_t *sym = rinha_symbol_get(hash);
+  return sym && sym->stable && sym->let && sym->let < fn->fn;
+}
+
+/**
+ * @brief Check if an unused instruction can go: it has no side effect and
+ *        cannot fail at run time (an error is observable), given what is known
+ *        of its operands. Calls to safe closures go as they do on the token
+ *        walker (see rinha_tokens_pure_), so the engines agree.
+ */
+static bool ir_is_removable_(ir_function_t *fn, ir_inst_t *inst) {
+  value_type l = (inst->argc > 0) ? ir_known_type_(fn, IR_OPERAND(fn, inst, 0))
+      : UNDEFINED;
+  value_type r = (inst->argc > 1) ? ir_known_type_(fn, IR_OPERAND(fn, inst, 1))
+      : UNDEFINED;
+
+  switch (inst->op) {
+    // Orders do not fail (values other than integers compare by their word)
+    case IR_LT:
+    case IR_LTE:
+    case IR_GT:
+    case IR_GTE:
+    case IR_CONST:
+    case IR_BOOL:
+    case IR_TUPLE:
+    case IR_CLOSURE:
+    case IR_PHI:
+      return true;
+    case IR_LOAD_FREE:
+    case IR_LOAD_GLOBAL:
+      return ir_is_bound_(fn, inst->hash);
+    // Integers, or a concatenation of strings, integers and booleans
+    case IR_ADD:
+      return (l == INTEGER || l == STRING || l == BOOLEAN) &&
+          (r == INTEGER || r == STRING || r == BOOLEAN);
+    case IR_SUB:
+    case IR_MUL:
+      return l == INTEGER && r == INTEGER;
+    // Equality fails across types; tuples compare their items, which may differ
+    case IR_EQ:
+    case IR_NEQ:
+      return l == r && (l == INTEGER || l == STRING || l == BOOLEAN);
+    // A divisor known not to be zero (MIN / -1 leaves the word for a bignum)
+    case IR_DIV:
+    case IR_MOD: {
+      ir_inst_t *divisor = &fn->insts[IR_OPERAND(fn, inst, 1)];
+
+      return l == INTEGER && divisor->op == IR_CONST &&
+          (divisor->value.type == BIGINT ||
+           (divisor->value.type == INTEGER && divisor->value.number != 0));
+    }
+    case IR_FIRST:
+    case IR_SECOND:
+      return l == TUPLE;
+    case IR_CALL: {
+      int callee = IR_OPERAND(fn, inst, 0);
+
+      return ir_is_safe_callee_(fn, callee) &&
+          ir_is_bound_(fn, fn->insts[callee].hash);
+    }
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Remove unreachable blocks and the unused instructions that have no side
+ *        effect and cannot fail (see ir_is_removable_).
+ */
+static bool ir_pass_dce_(ir_function_t *fn) {
+  bool changed = false;
+  bool *seen = calloc(fn->blocks_count, sizeof(bool));
+  int *uses = calloc(fn->count, sizeof(int));
+
+  if (!seen || !uses) {
+    free(seen);
+    free(uses);
+    return false;
+  }
+
+  ir_reachable_(fn, 0, seen);
+
+  for (register int i = 0; i < fn->blocks_count; ++i) {
+    ir_block_t *block = &fn->blocks[i];
+
+    if (seen[i] || block->first < 0)
+      continue;
+
+    int last = block->last;
+    for (register int k = 0; k < 2; ++k) {
+      int target = fn->insts[last].target[k];
+      if (target >= 0)
+        ir_remove_pred_(fn, target, i);
+    }
+    for (int id = block->first; id >= 0; id = fn->insts[id].next)
+      ir_remove_(fn, id);
+
+    block->first = block->last = -1;
+    block->npreds = 0;
+    changed = true;
+  }
+
+  for (register int i = 0; i < fn->count; ++i) {
+    ir_inst_t *inst = &fn->insts[i];
+    for (register int j = 0; j < inst->argc; ++j)
+      uses[IR_OPERAND(fn, inst, j)]++;
+  }
+
+  for (bool removed = true; removed; ) {
+    removed = false;
+    for (register int i = fn->count - 1; i >= 0; --i) {
+      ir_inst_t *inst = &fn->insts[i];
+
+      if (uses[i] || !ir_is_removable_(fn, inst))
+        continue;
+
+      for (register int j = 0; j < inst->argc; ++j)
+        uses[IR_OPERAND(fn, inst, j)]--;
+
+      ir_remove_(fn, i);
+      removed = changed = true;
+    }
+  }
+
+  free(seen);
+  free(uses);
+  return changed;
+}
+
+static bool ir_is_cse_candidate_(ir_inst_t *inst) {
+  switch (inst->op) {
+    case IR_CONST:
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_EQ:
+    case IR_NEQ:
+    case IR_LT:
+    case IR_LTE:
+    case IR_GT:
+    case IR_GTE:
+    case IR_BOOL:
+    case IR_TUPLE:
+    case IR_FIRST:
+    case IR_SECOND:
+      return true;
+    case IR_LOAD_FREE:
+    case IR_LOAD_GLOBAL: {
+      symbol_t *sym = rinha_symbol_get(inst->hash);
+      return sym && sym->stable;
+    }
+    default:
+      return false;
+  }
+}
+
+static bool ir_is_same_(ir_function_t *fn, ir_inst_t *a, ir_inst_t *b) {
+  if (a->op != b->op || a->argc != b->argc || a->hash != b->hash)
+    return false;
+
+  for (register int j = 0; j < a->argc; ++j) {
+    if (IR_OPERAND(fn, a, j) != IR_OPERAND(fn, b, j))
+      return false;
+  }
+
+  if (a->op != IR_CONST)
+    return true;
+
+  if (a->value.type != b->value.type)
+    return false;
+
+  switch (a->value.type) {
+    case STRING:
+      // Held in the value when small, interned otherwise
+      if (a->value.small || b->value.small)
+        return a->value.small == b->value.small &&
+            strcmp(RINHA_SMALL_BYTES(&a->value), RINHA_SMALL_BYTES(&b->value)) == 0;
+      return a->value.string == b->value.string;
+    case BOOLEAN:
+      return a->value.boolean == b->value.boolean;
+    default:
+      return a->value.number == b->value.number;
+  }
+}
+
+/**
+ * @brief Local common subexpression elimination (within each block).
+ */
+static bool ir_pass_cse_(ir_function_t *fn) {
+  bool changed = false;
+
+  for (register int k = 0; k < fn->blocks_count; ++k) {
+    for (int i = fn->blocks[k].first; i >= 0; i = fn->insts[i].next) {
+      ir_inst_t *inst = &fn->insts[i];
+
+      if (!ir_is_cse_candidate_(inst))
+        continue;
+
+      for (int j = fn->blocks[k].first; j != i; j = fn->insts[j].next) {
+        if (ir_is_same_(fn, &fn->insts[j], inst)) {
+          ir_replace_uses_(fn, i, j);
+          ir_remove_(fn, i);
+          changed = true;
+          break;
+        }
+      }
+    }
+  }
+  return changed;
+}
+
+/**
+ * @brief Inline calls to small, single-block, stable closures (not recursive
+ *        and not creating closures). Their free symbols are globals.
+ */
+static bool ir_pass_inline_(ir_function_t *fn) {
+  bool changed = false;
+
+  for (register int k = 0; k < fn->blocks_count; ++k) {
+    int prev = -1;
+
+    for (int i = fn->blocks[k].first; i >= 0; prev = i, i = fn->insts[i].next) {
+      ir_inst_t *call = &fn->insts[i];
+
+      if (call->op != IR_CALL)
+        continue;
+
+      ir_inst_t *callee = &fn->insts[IR_OPERAND(fn, call, 0)];
+
+      if (callee->op != IR_LOAD_FREE && callee->op != IR_LOAD_GLOBAL)
+        continue;
+
+      symbol_t *sym = rinha_symbol_get(callee->hash);
+
+      if (!sym || !sym->stable || callee->hash == fn->hash)
+        continue;
+
+      ir_function_t *body = rinha_ir_build(sym->let + 3, callee->hash);
+      bool inline_ = body && !body->error && body->blocks_count == 1 &&
+          body->count <= IR_INLINE_SIZE && body->params == call->argc - 1;
+
+      for (register int j = 0; inline_ && j < (body ? body->count : 0); ++j) {
+        ir_inst_t *inst = &body->insts[j];
+        inline_ = inst->op != IR_CLOSURE &&
+            !((inst->op == IR_LOAD_FREE || inst->op == IR_LOAD_GLOBAL) &&
+              inst->hash == callee->hash);
+      }
+
+      if (!inline_) {
+        rinha_ir_free(body);
+        continue;
+      }
+
+      int map[IR_INLINE_SIZE];
+      int result = -1;
+      int at = prev;
+
+      for (int j = body->blocks[0].first; j >= 0; j = body->insts[j].next) {
+        ir_inst_t *inst = &body->insts[j];
+
+        switch (inst->op) {
+          case IR_PARAM:
+            map[j] = IR_OPERAND(fn, &fn->insts[i], inst->arg + 1);
+            continue;
+          case IR_RETURN:
+            result = map[IR_OPERAND(body, inst, 0)];
+            continue;
+          default:
+            break;
+        }
+
+        int id = ir_inst_new_(fn, inst->op, inst->argc, 0);
+        ir_inst_t *copy = &fn->insts[id];
+        int args = copy->args;
+
+        *copy = *inst;
+        copy->args = args;
+        if (copy->op == IR_LOAD_FREE)
+          copy->op = IR_LOAD_GLOBAL;
+
+        for (register int a = 0; a < inst->argc; ++a)
+          IR_OPERAND(fn, copy, a) = map[IR_OPERAND(body, inst, a)];
+
+        ir_insert_(fn, k, at, id);
+        at = id;
+        map[j] = id;
+      }
+
+      ir_replace_uses_(fn, i, result);
+      ir_remove_(fn, i);
+      rinha_ir_free(body);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+/**
+ * @brief Infer the type of the values (see rinha_exec_calc_ and rinha_exec_term_
+ *        for the typing rules of the operators). INTEGER stands for any integer,
+ *        in the word or a bignum: arithmetic may leave the word at run time.
+ */
+static bool ir_pass_typespec_(ir_function_t *fn) {
+  bool changed = false;
+
+  for (bool again = true; again; ) {
+    again = false;
+
+    for (register int i = 0; i < fn->count; ++i) {
+      ir_inst_t *inst = &fn->insts[i];
+      value_type l = (inst->argc > 0) ? fn->insts[IR_OPERAND(fn, inst, 0)].type
+          : UNDEFINED;
+      value_type r = (inst->argc > 1) ? fn->insts[IR_OPERAND(fn, inst, 1)].type
+          : UNDEFINED;
+      value_type type = UNDEFINED;
+
+      switch (inst->op) {
+        case IR_CONST:
+          type = (inst->value.type == BIGINT) ? INTEGER : inst->value.type;
+          break;
+        case IR_LOAD_FREE:
+        case IR_LOAD_GLOBAL: {
+          symbol_t *sym = rinha_symbol_get(inst->hash);
+          type = (sym && sym->stable) ? FUNCTION : UNDEFINED;
+        } break;
+        case IR_ADD:
+          if (l == INTEGER && r == INTEGER)
+            type = INTEGER;
+          else if ((l != UNDEFINED && l != INTEGER) ||
+                   (r != UNDEFINED && r != INTEGER))
+            type = STRING;
+          break;
+        case IR_SUB:
+          type = INTEGER;
+          break;
+        case IR_MUL:
+        case IR_DIV:
+        case IR_MOD:
+        case IR_PRINT:
+          type = l;
+          break;
+        case IR_EQ:
+        case IR_NEQ:
+        case IR_LT:
+        case IR_LTE:
+        case IR_GT:
+        case IR_GTE:
+        case IR_BOOL:
+          type = BOOLEAN;
+          break;
+        case IR_TUPLE:
+          type = TUPLE;
+          break;
+        case IR_CLOSURE:
+          type = FUNCTION;
+          break;
+        case IR_PHI:
+          type = l;
+          for (register int j = 1; j < inst->argc; ++j) {
+            if (fn->insts[IR_OPERAND(fn, inst, j)].type != type)
+              type = UNDEFINED;
+          }
+          break;
+        default:
+          break;
+      }
+
+      if (type != inst->type) {
+        inst->type = type;
+        again = changed = true;
+      }
+    }
+  }
+  return changed;
+}
+
+// ---------------------------------------------------------------------------
+// Pass manager
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief An optimization pass.
+ *
+ * @var run      Runs the pass; returns `true` if the IR changed.
+ * @var seconds  Time spent in the pass.
+ * @var runs     Number of times the pass ran.
+ */
+typedef struct {
+  const char *name;
+  bool (*run)(ir_function_t *fn);
+  bool enabled;
+  double seconds;
+  long runs;
+} ir_pass_t;
+
+static ir_pass_t ir_passes[] = {
+  { .name = "inline",   .run = ir_pass_inline_,   .enabled = true },
+  { .name = "fold",     .run = ir_pass_fold_,     .enabled = true },
+  { .name = "cse",      .run = ir_pass_cse_,      .enabled = true },
+  { .name = "dce",      .run = ir_pass_dce_,      .enabled = true },
+  { .name = "typespec", .run = ir_pass_typespec_, .enabled = true },
+};
+
+#define IR_PASSES_COUNT ((int) (sizeof(ir_passes) / sizeof(ir_passes[0])))
+
+inline static double ir_now_(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void rinha_ir_optimize(ir_function_t *fn) {
+  if (!fn || fn->error)
+    return;
+
+  for (register int round = 0; round < IR_ROUNDS; ++round) {
+    bool changed = false;
+
+    for (register int i = 0; i < IR_PASSES_COUNT; ++i) {
+      ir_pass_t *pass = &ir_passes[i];
+
+      if (!pass->enabled)
+        continue;
+
+      double start = ir_now_();
+      changed |= pass->run(fn);
+      pass->seconds += ir_now_() - start;
+      pass->runs++;
+    }
+
+    if (!changed)
+      break;
+  }
+}
+
+bool rinha_ir_select_passes(const char *list) {
+  bool all = (strcmp(list, "all") == 0);
+
+  for (register int i = 0; i < IR_PASSES_COUNT; ++i)
+    ir_passes[i].enabled = all;
+
+  if (all || strcmp(list, "none") == 0)
+    return true;
+
+  while (*list) {
+    size_t len = strcspn(list, ",");
+    bool found = false;
+
+    for (register int i = 0; i < IR_PASSES_COUNT; ++i) {
+      if (strlen(ir_passes[i].name) == len &&
+          strncmp(ir_passes[i].name, list, len) == 0) {
+        ir_passes[i].enabled = found = true;
+      }
+    }
+
+    if (!found)
+      return false;
+
+    list += len + (list[len] == ',');
+  }
+  return true;
+}
+
+void rinha_ir_report(FILE *out) {
+  fprintf(out, "\nIR passes:\n");
+
+  for (register int i = 0; i < IR_PASSES_COUNT; ++i) {
+    ir_pass_t *pass = &ir_passes[i];
+    fprintf(out, "  %-10s %-4s runs: %-8ld time: %.6fs\n", pass->name,
+        pass->enabled ? "on" : "off", pass->runs, pass->seconds);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Dump
+// ---------------------------------------------------------------------------
+
+static const char *ir_op_names[] = {
+  "nop", "param", "const", "load.free", "load.global", "add", "sub", "mul",
+  "div", "mod", "eq", "neq", "lt", "lte", "gt", "gte", "bool", "tuple",
+  "first", "second", "closure", "call", "print", "phi", "jump", "branch",
+  "return"
+};
+
+static const char *ir_type_names[] = {
+  "?", "string", "int", "bool", "float", "closure", "tuple"
+};
+
+void rinha_ir_dump(ir_function_t *fn, FILE *out) {
+  symbol_t *sym = rinha_symbol_get(fn->hash);
+
+  fprintf(out, "fn %s (hash %d, line %d)",
+      (sym && sym->let) ? (sym->let + 1)->lexname : "<anonymous>",
+      fn->hash, fn->fn->line);
+
+  if (fn->error) {
+    fprintf(out, ": not lowered (%s)\n\n", fn->error);
+    return;
+  }
+  fprintf(out, "\n");
+
+  for (register int k = 0; k < fn->blocks_count; ++k) {
+    ir_block_t *block = &fn->blocks[k];
+
+    if (block->first < 0)
+      continue;
+
+    fprintf(out, "b%d:", k);
+    for (register int p = 0; p < block->npreds; ++p)
+      fprintf(out, "%s b%d", p ? "," : " <-", block->preds[p]);
+    fprintf(out, "\n");
+
+    for (int i = block->first; i >= 0; i = fn->insts[i].next) {
+      ir_inst_t *inst = &fn->insts[i];
+
+      switch (inst->op) {
+        case IR_NOP:
+          continue;
+        case IR_JUMP:
+          fprintf(out, "  jump b%d\n", inst->target[0]);
+          continue;
+        case IR_BRANCH:
+          fprintf(out, "  branch v%d, b%d, b%d\n", IR_OPERAND(fn, inst, 0),
+              inst->target[0], inst->target[1]);
+          continue;
+        case IR_RETURN:
+          fprintf(out, "  return v%d\n", IR_OPERAND(fn, inst, 0));
+          continue;
+        default:
+          break;
+      }
+
+      fprintf(out, "  v%d = %s", i, ir_op_names[inst->op]);
+
+      switch (inst->op) {
+        case IR_PARAM:
+          fprintf(out, " %d", inst->arg);
+          break;
+        case IR_CONST:
+          switch (inst->value.type) {
+            case STRING:
+              fprintf(out, " \"%s\"", inst->value.small
+                  ? RINHA_SMALL_BYTES(&inst->value) : inst->value.string);
+              break;
+            case BOOLEAN:
+              fprintf(out, " %s", BOOL_NAME(inst->value.boolean));
+              break;
+            case BIGINT: {
+              char *digits = malloc(rinha_bignum_digits(&inst->value) + 1);
+
+              if (digits && rinha_bignum_format(&inst->value, digits))
+                fprintf(out, " %s", digits);
+              free(digits);
+            } break;
+            default:
+              fprintf(out, " %ld", (long) inst->value.number);
+          }
+          break;
+        case IR_LOAD_FREE:
+        case IR_LOAD_GLOBAL:
+          fprintf(out, " %s", inst->token->lexname);
+          break;
+        case IR_CLOSURE:
+          fprintf(out, " line %d", inst->token->line);
+          break;
+        default:
+          break;
+      }
+
+      for (register int j = 0; j < inst->argc; ++j)
+        fprintf(out, "%s v%d", j ? "," : "", IR_OPERAND(fn, inst, j));
+
+      fprintf(out, " : %s\n", ir_type_names[inst->type]);
+    }
+  }
+  fprintf(out, "\n");
+}
@@ -0,0 +1,178 @@
+/**
+ * @file ir.h
+ *
+ * @brief Rinha Language Interpreter - SSA intermediate representation
+ *
+ * Closure bodies are lowered from the token stream into a mid-level SSA form:
+ * basic blocks of three-address instructions, phis at the joins of if/else,
+ * `&&` and `||`, and explicit call, closure and tuple operations. A small pass
+ * manager runs the optimizations (folding, DCE, CSE, inlining and type
+ * specialization) before the IR is handed to an execution back end.
+ *
+ * The builder never creates critical edges: every predecessor of a join block
+ * ends with an unconditional jump, so phis can be lowered to copies at the end
+ * of the predecessors.
+ */
+
+#ifndef _LA_RINHA_IR_H
+#define _LA_RINHA_IR_H
+
+#include <stdio.h>
+
+#include "rinha.h"
+
+typedef enum {
+    IR_NOP,
+    IR_PARAM,        /* arg: parameter index */
+    IR_CONST,        /* value */
+    IR_LOAD_FREE,    /* hash: closure environment, then globals */
+    IR_LOAD_GLOBAL,  /* hash: globals only */
+    IR_ADD,
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_MOD,
+    IR_EQ,
+    IR_NEQ,
+    IR_LT,
+    IR_LTE,
+    IR_GT,
+    IR_GTE,
+    IR_BOOL,         /* the boolean view of a value (conditions, && and ||) */
+    IR_TUPLE,
+    IR_FIRST,
+    IR_SECOND,
+    IR_CLOSURE,      /* token: `fn`, hash: closure hash, operands: captured values
+                        (their hashes follow, see IR_CAPTURE_HASH) */
+    IR_CALL,         /* operands: callee, arguments */
+    IR_PRINT,
+    IR_PHI,          /* operands: one per predecessor, in the order of preds */
+    IR_JUMP,         /* target[0] */
+    IR_BRANCH,       /* operand: condition, target[0]: true, target[1]: false */
+    IR_RETURN
+} ir_op;
+
+/**
+ * @brief An IR instruction; its index in ir_function_t::insts is the SSA value it defines.
+ *
+ * @var op       The operation.
+ * @var type     Result type inferred by the typespec pass (UNDEFINED: unknown).
+ * @var block    The block holding the instruction.
+ * @var next     Next instruction of the block, or -1.
+ * @var args     Offset of the operands in ir_function_t::operands.
+ * @var argc     Number of operands.
+ * @var arg      Parameter index (IR_PARAM).
+ * @var hash     Symbol (IR_LOAD_*), closure hash (IR_CLOSURE).
+ * @var value    Constant (IR_CONST).
+ * @var target   Successor blocks (IR_JUMP, IR_BRANCH).
+ * @var token    Source token, for errors and closures.
+ */
+typedef struct {
+    ir_op op;
+    value_type type;
+    int block;
+    int next;
+    int args;
+    int argc;
+    int arg;
+    int hash;
+    rinha_value_t value;
+    int target[2];
+    token_t *token;
+} ir_inst_t;
+
+/**
+ * @brief A basic block.
+ *
+ * @var first   First instruction, or -1.
+ * @var last    Last instruction (the terminator once the block is complete), or -1.
+ * @var preds   Predecessor blocks (joins have two).
+ * @var npreds  Number of predecessors.
+ */
+typedef struct {
+    int first;
+    int last;
+    int preds[2];
+    int npreds;
+} ir_block_t;
+
+/**
+ * @brief The IR of a closure body. Block 0 is the entry.
+ *
+ * @var fn          The `fn` token of the closure.
+ * @var hash        The closure hash (let binding or anonymous `fn`).
+ * @var params      Number of parameters.
+ * @var param_hash  Hash of each parameter.
+ * @var error       Why the body could not be lowered, or NULL.
+ */
+typedef struct {
+    token_t *fn;
+    int hash;
+    int params;
+    int param_hash[RINHA_CONFIG_FUNCTION_ARGS_SIZE];
+    ir_inst_t *insts;
+    int count;
+    int capacity;
+    int *operands;
+    int operands_count;
+    int operands_capacity;
+    ir_block_t *blocks;
+    int blocks_count;
+    int blocks_capacity;
+    const char *error;
+} ir_function_t;
+
+#define IR_OPERAND(fn, inst, i) ((fn)->operands[(inst)->args + (i)])
+#define IR_CAPTURE_HASH(fn, inst, i) \
+    ((fn)->operands[(inst)->args + (inst)->argc + (i)])
+
+/**
+ * @brief Lower a closure body into SSA form.
+ *
+ * @param fn_token  The `fn` token of the closure.
+ * @param hash      The closure hash.
+ *
+ * @return The IR (check `error`: unsupported constructs leave it set), or NULL
+ *         when out of memory.
+ */
+ir_function_t *rinha_ir_build(token_t *fn_token, int hash);
+
+/**
+ * @brief Lower the top level of a script (its statements up to EOF) into SSA
+ *        form, as the body of a closure without parameters returning the value
+ *        of the last statement.
+ *
+ * @param tokens  The first token of the script.
+ *
+ * @return The IR (check `error`), or NULL when out of memory.
+ */
+ir_function_t *rinha_ir_build_program(token_t *tokens);
+
+/**
+ * @brief Run the enabled optimization passes until none of them changes the IR.
+ */
+void rinha_ir_optimize(ir_function_t *fn);
+
+/**
+ * @brief Select the optimization passes.
+ *
+ * @param list  Comma separated pass names (fold, dce, cse, inline, typespec),
+ *              `all` or `none`.
+ *
+ * @return `false` if the list has an unknown pass.
+ */
+bool rinha_ir_select_passes(const char *list);
+
+/**
+ * @brief Print the time spent in each pass.
+ */
+void rinha_ir_report(FILE *out);
+
+/**
+ * @brief Print the IR in a readable form.
+ */
+void rinha_ir_dump(ir_function_t *fn, FILE *out);
+
+void rinha_ir_free(ir_function_t *fn);
+
+#endif
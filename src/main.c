@@ -20,8 +20,11 @@
 #include <sys/resource.h>
 #include <sys/sysinfo.h>
 #include <sys/stat.h>
+#include <stdint.h>
 
 #include "rinha.h"
+#include "ir.h"
+#include "bundle.h"
 
 char *rinha_load_file(const char *file) {
   struct stat s;
@@ -122,30 +125,128 @@ void rinha_banner(void) {
 
 int usage(const char *prog) {
     rinha_banner();
-    printf("Usage: %s <script_file>\n", prog);
+    printf("Usage: %s [options] <script_file>\n", prog);
     printf("  <script_file>: Path to the Rinha script file to execute.\n");
+    printf("  --precompute[=<file>]: Cache the results of closed pure calls made\n"
+           "      with literal arguments (default file: <script_file>"
+           RINHA_CONFIG_PRECOMPUTE_SUFFIX ").\n");
+    printf("  --opt-passes=<list>: IR passes to run (fold,dce,cse,inline,typespec,\n"
+           "      all or none); reports the time spent in each one.\n");
+    printf("  --dump-ir: Print the IR of every closure instead of running the script.\n");
+    printf("  --engine=<walker|regvm|closure|tiered>: Engine running the closures\n"
+           "      (default: walker).\n");
+    printf("  --profile: Report calls, backedges and tier of each closure on stderr.\n");
+    printf("  --gc-threshold=<bytes>: Minimum bytes allocated between two collections\n"
+           "      of strings and tuples (0: never collect).\n");
+    printf("  --gc-stats: Report the collections and their pauses on stderr.\n");
+    printf("  --bundle <script_file> -o <output>: Write a copy of the interpreter with\n"
+           "      the script appended, running it with the selected engine on its own\n"
+           "      (no script file needed; the script is still parsed at startup).\n");
+    printf("  --compile <script_file> -o <output>: Compile the script into a static\n"
+           "      x86-64 executable (integers, booleans and top-level closures); it\n"
+           "      runs in the interpreter, bundled, past the machine words.\n");
     printf("  Ex: %s /usr/src/source.rinha\n", prog);
     return EXIT_FAILURE;
 }
 
 int main(int argc, char *argv[]) {
 
-  //TODO: Set options config here
   rinha_stack_config();
   //rinha_banner();
 
-  if (argc < 2) {
+  rinha_options_t options = {0};
+  const char *file = NULL;
+  const char *out = NULL;
+  bool bundle = false;
+  bool compile = false;
+  char *code = NULL;
+
+  // Executables built with --bundle run their own script
+  const char *self = rinha_bundle_self(argv[0]);
+
+  switch (rinha_bundle_read(self, &code, &options.engine)) {
+  case RINHA_BUNDLE_CORRUPT:
+    fprintf(stderr, "Corrupt bundled script (file:%s)\n", self);
+    return EXIT_FAILURE;
+  case RINHA_BUNDLE_OK:
+    rinha_set_options(&options);
+
+    rinha_value_t response = {0};
+
+    rinha_script_exec(argv[0], code, &response, false);
+
+    return EXIT_SUCCESS;
+  case RINHA_BUNDLE_NONE:
+    break;
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--precompute") == 0) {
+      options.precompute = true;
+    } else if (strncmp(argv[i], "--precompute=", 13) == 0) {
+      options.precompute = true;
+      options.cache_path = argv[i] + 13;
+    } else if (strncmp(argv[i], "--opt-passes=", 13) == 0) {
+      options.opt_passes = argv[i] + 13;
+      if (!rinha_ir_select_passes(options.opt_passes))
+        return usage(argv[0]);
+    } else if (strcmp(argv[i], "--dump-ir") == 0) {
+      options.dump_ir = true;
+    } else if (strcmp(argv[i], "--engine=walker") == 0) {
+      options.engine = RINHA_ENGINE_WALKER;
+    } else if (strcmp(argv[i], "--engine=regvm") == 0) {
+      options.engine = RINHA_ENGINE_REGVM;
+    } else if (strcmp(argv[i], "--engine=closure") == 0) {
+      options.engine = RINHA_ENGINE_CLOSURE;
+    } else if (strcmp(argv[i], "--engine=tiered") == 0) {
+      options.engine = RINHA_ENGINE_TIERED;
+    } else if (strcmp(argv[i], "--profile") == 0) {
+      options.profile = true;
+    } else if (strncmp(argv[i], "--gc-threshold=", 15) == 0) {
+      char *end;
+
+      options.gc_threshold = strtoull(argv[i] + 15, &end, 10);
+      if (end == argv[i] + 15 || *end)
+        return usage(argv[0]);
+      if (!options.gc_threshold)
+        options.gc_threshold = SIZE_MAX;
+    } else if (strcmp(argv[i], "--gc-stats") == 0) {
+      options.gc_stats = true;
+    } else if (strcmp(argv[i], "--bundle") == 0) {
+      bundle = true;
+    } else if (strcmp(argv[i], "--compile") == 0) {
+      compile = true;
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      out = argv[++i];
+    } else if (argv[i][0] == '-' || file) {
+      return usage(argv[0]);
+    } else {
+      file = argv[i];
+    }
+  }
+
+  if (!file || (bundle && compile) || (bundle || compile) != (out != NULL)) {
       return usage(argv[0]);
   }
 
-  char *code = rinha_load_file(argv[1]);
+  code = rinha_load_file(file);
 
   if (!code)
       return EXIT_FAILURE;
 
+  if (bundle)
+    return rinha_bundle_write(self, code, options.engine, out) ?
+        EXIT_SUCCESS : EXIT_FAILURE;
+
+  rinha_set_options(&options);
+
+  if (compile)
+    return rinha_script_compile((char *) file, code, self, out) ?
+        EXIT_SUCCESS : EXIT_FAILURE;
+
   rinha_value_t response = {0};
 
-  rinha_script_exec(argv[1], code, &response, false);
+  rinha_script_exec((char *) file, code, &response, false);
 
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,1896 @@
+/**
+ * @file native.c
+ *
+ * @brief Rinha Language Interpreter - native x86-64 executables (--compile)
+ *
+ * The x86-64 encoder, the check of what the script uses, the register
+ * allocator, the instruction selection, the runtime and the ELF writer. See
+ * native.h.
+ */
+
+#include <elf.h>
+#include <errno.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "native.h"
+#include "ir.h"
+#include "bundle.h"
+
+/**
+ * @brief Layout of the executable: the headers and the code are loaded at
+ *        NATIVE_BASE, the zeroed data (native_data) at NATIVE_DATA.
+ */
+#define NATIVE_BASE 0x400000
+#define NATIVE_HEADERS (sizeof(Elf64_Ehdr) + 3 * sizeof(Elf64_Phdr))
+#define NATIVE_TEXT (NATIVE_BASE + NATIVE_HEADERS)
+#define NATIVE_DATA 0x40000000
+
+/**
+ * @brief Offsets of the runtime data at NATIVE_DATA.
+ *
+ * @var NATIVE_LIMIT    Lowest stack pointer of a call (deeper: fallback).
+ * @var NATIVE_ARGV     argv and envp of the process, for the fallback.
+ * @var NATIVE_RLIMIT   struct rlimit of the stack.
+ * @var NATIVE_OFFSET   Read offset of the bundle (fallback).
+ * @var NATIVE_FLUSHED  Output was written: no fallback any more.
+ * @var NATIVE_LENGTH   Bytes held in NATIVE_OUTPUT.
+ * @var NATIVE_NUMBER   Digits of the integer being printed.
+ * @var NATIVE_OUTPUT   Output held until the end of the script.
+ */
+enum {
+  NATIVE_LIMIT = 0,
+  NATIVE_ARGV = 8,
+  NATIVE_ENVP = 16,
+  NATIVE_RLIMIT = 24,
+  NATIVE_OFFSET = 40,
+  NATIVE_FLUSHED = 48,
+  NATIVE_LENGTH = 56,
+  NATIVE_NUMBER = 64,
+  NATIVE_OUTPUT = 96,
+  NATIVE_DATA_SIZE = NATIVE_OUTPUT + RINHA_CONFIG_NATIVE_OUTPUT_SIZE
+};
+
+/**
+ * @brief An entry of a memo: the arguments, the result, and whether it is set.
+ */
+enum {
+  NATIVE_MEMO_RESULT = 24,
+  NATIVE_MEMO_SET = 32,
+  NATIVE_MEMO_ENTRY = 40
+};
+
+typedef enum {
+  NATIVE_RAX, NATIVE_RCX, NATIVE_RDX, NATIVE_RBX, NATIVE_RSP, NATIVE_RBP,
+  NATIVE_RSI, NATIVE_RDI, NATIVE_R8, NATIVE_R9, NATIVE_R10, NATIVE_R11,
+  NATIVE_R12, NATIVE_R13, NATIVE_R14, NATIVE_R15
+} native_reg;
+
+/**
+ * @brief Condition codes (jcc, setcc and cmovcc add them to their opcode).
+ */
+typedef enum {
+  NATIVE_O = 0x0, NATIVE_B = 0x2, NATIVE_AE = 0x3, NATIVE_E = 0x4,
+  NATIVE_NE = 0x5, NATIVE_BE = 0x6, NATIVE_A = 0x7, NATIVE_S = 0x8,
+  NATIVE_NS = 0x9, NATIVE_L = 0xc, NATIVE_GE = 0xd, NATIVE_LE = 0xe,
+  NATIVE_G = 0xf
+} native_cc;
+
+/**
+ * @brief Values are allocated to the callee-saved registers: calls between
+ *        native functions keep them, and the scratch registers are left to
+ *        the instructions and the arguments.
+ */
+static const native_reg native_allocatable[] = {
+  NATIVE_RBX, NATIVE_R12, NATIVE_R13, NATIVE_R14, NATIVE_R15
+};
+
+#define NATIVE_ALLOCATABLE \
+    ((int) (sizeof(native_allocatable) / sizeof(native_allocatable[0])))
+
+/**
+ * @brief Arguments go in the registers of the System V calls, the result in rax.
+ */
+static const native_reg native_args[RINHA_CONFIG_FUNCTION_ARGS_SIZE] = {
+  NATIVE_RDI, NATIVE_RSI, NATIVE_RDX, NATIVE_RCX, NATIVE_R8, NATIVE_R9
+};
+
+/**
+ * @brief A rel32 field to patch with the offset of a label.
+ */
+typedef struct {
+  size_t at;
+  int label;
+} native_fixup_t;
+
+/**
+ * @brief The code being emitted, with its labels.
+ *
+ * @var labels  Offset of each label in the code (-1: not bound yet).
+ * @var fixups  rel32 fields referring to a label.
+ */
+typedef struct {
+  uint8_t *bytes;
+  size_t size;
+  size_t capacity;
+  int *labels;
+  int nlabels;
+  int labels_capacity;
+  native_fixup_t *fixups;
+  int nfixups;
+  int fixups_capacity;
+} native_code_t;
+
+typedef enum {
+  NATIVE_NONE,  /* not stored: unused, or an operand folded into its uses */
+  NATIVE_REG,
+  NATIVE_SLOT
+} native_loc_kind;
+
+typedef struct {
+  native_loc_kind kind;
+  int index;
+} native_loc_t;
+
+/**
+ * @brief A closure bound at the top level, or the top level itself.
+ *
+ * @var hash    Hash of the binding (0: the top level).
+ * @var let     The `let` token of the binding (NULL: the top level).
+ * @var params  Type of each parameter, joined over the calls.
+ * @var ret     Type of the result, joined over the returns.
+ * @var types   Type of each instruction.
+ * @var label   Entry of the function.
+ * @var memo    Offset of its memo in the runtime data (-1: none).
+ */
+typedef struct {
+  int hash;
+  token_t *let;
+  ir_function_t *ir;
+  value_type params[RINHA_CONFIG_FUNCTION_ARGS_SIZE];
+  value_type ret;
+  value_type *types;
+  int label;
+  int memo;
+} native_fn_t;
+
+/**
+ * @brief State of a compilation.
+ *
+ * @var top    `let` tokens at the top level (by token index).
+ * @var data   Bytes of runtime data (the memos follow NATIVE_OUTPUT).
+ * @var error  What native code does not support, and where.
+ * @var fail   Where the checks bail out to.
+ */
+typedef struct {
+  token_t *tokens;
+  bool *top;
+  native_fn_t **fns;
+  int nfns;
+  int fns_capacity;
+  native_code_t code;
+  size_t data;
+  int print_int;
+  int print_bool;
+  int append;
+  int flush;
+  int fallback;
+  int start;
+  const char *error;
+  token_t *where;
+  jmp_buf fail;
+} native_t;
+
+static void rinha_native_fail_(native_t *n, token_t *where, const char *why) {
+  n->error = why;
+  n->where = where;
+  longjmp(n->fail, 1);
+}
+
+// ---------------------------------------------------------------------------
+// Encoder
+// ---------------------------------------------------------------------------
+
+static void *rinha_native_grow_(native_t *n, void *ptr, int *capacity,
+    int needed, size_t size) {
+  if (needed <= *capacity)
+    return ptr;
+
+  int grown = *capacity ? *capacity * 2 : 64;
+
+  while (grown < needed)
+    grown *= 2;
+
+  void *p = realloc(ptr, grown * size);
+
+  if (!p)
+    rinha_native_fail_(n, NULL, "out of memory");
+
+  *capacity = grown;
+  return p;
+}
+
+static void rinha_native_byte_(native_t *n, uint8_t byte) {
+  native_code_t *c = &n->code;
+
+  if (c->size == c->capacity) {
+    size_t capacity = c->capacity ? c->capacity * 2 : 4096;
+    uint8_t *bytes = realloc(c->bytes, capacity);
+
+    if (!bytes)
+      rinha_native_fail_(n, NULL, "out of memory");
+    c->bytes = bytes;
+    c->capacity = capacity;
+  }
+  c->bytes[c->size++] = byte;
+}
+
+static void rinha_native_bytes_(native_t *n, const char *bytes, size_t size) {
+  for (size_t i = 0; i < size; ++i)
+    rinha_native_byte_(n, (uint8_t) bytes[i]);
+}
+
+static void rinha_native_u32_(native_t *n, uint32_t value) {
+  for (int i = 0; i < 4; ++i)
+    rinha_native_byte_(n, (uint8_t) (value >> (i * 8)));
+}
+
+static void rinha_native_u64_(native_t *n, uint64_t value) {
+  for (int i = 0; i < 8; ++i)
+    rinha_native_byte_(n, (uint8_t) (value >> (i * 8)));
+}
+
+static int rinha_native_label_(native_t *n) {
+  native_code_t *c = &n->code;
+
+  c->labels = rinha_native_grow_(n, c->labels, &c->labels_capacity,
+      c->nlabels + 1, sizeof(int));
+  c->labels[c->nlabels] = -1;
+  return c->nlabels++;
+}
+
+static void rinha_native_bind_(native_t *n, int label) {
+  n->code.labels[label] = (int) n->code.size;
+}
+
+/**
+ * @brief A rel32 field to `label`, relative to the end of the field.
+ */
+static void rinha_native_rel_(native_t *n, int label) {
+  native_code_t *c = &n->code;
+
+  c->fixups = rinha_native_grow_(n, c->fixups, &c->fixups_capacity,
+      c->nfixups + 1, sizeof(native_fixup_t));
+  c->fixups[c->nfixups].at = c->size;
+  c->fixups[c->nfixups++].label = label;
+  rinha_native_u32_(n, 0);
+}
+
+/**
+ * @brief REX.W prefix and opcode (two bytes when it is 0x0f-prefixed, e.g.
+ *        0x0faf for imul).
+ */
+static void rinha_native_op_(native_t *n, int op, int reg, int rm) {
+  rinha_native_byte_(n, 0x48 | ((reg >> 3) << 2) | (rm >> 3));
+  if (op > 0xff)
+    rinha_native_byte_(n, op >> 8);
+  rinha_native_byte_(n, op & 0xff);
+}
+
+/**
+ * @brief `op reg, rm` between registers.
+ */
+static void rinha_native_rr_(native_t *n, int op, int reg, int rm) {
+  rinha_native_op_(n, op, reg, rm);
+  rinha_native_byte_(n, 0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+/**
+ * @brief `op reg, [rbp + disp]`.
+ */
+static void rinha_native_rbp_(native_t *n, int op, int reg, int32_t disp) {
+  rinha_native_op_(n, op, reg, NATIVE_RBP);
+  rinha_native_byte_(n, 0x80 | ((reg & 7) << 3) | NATIVE_RBP);
+  rinha_native_u32_(n, (uint32_t) disp);
+}
+
+/**
+ * @brief `op reg, [rip + label]`.
+ */
+static void rinha_native_rip_(native_t *n, int op, int reg, int label) {
+  rinha_native_op_(n, op, reg, 0);
+  rinha_native_byte_(n, ((reg & 7) << 3) | 5);
+  rinha_native_rel_(n, label);
+}
+
+/**
+ * @brief `op reg, [rip + ...]` to the runtime data at `offset`.
+ */
+static void rinha_native_data_(native_t *n, int op, int reg, int offset) {
+  rinha_native_op_(n, op, reg, 0);
+  rinha_native_byte_(n, ((reg & 7) << 3) | 5);
+
+  int64_t next = NATIVE_TEXT + n->code.size + 4;
+  rinha_native_u32_(n, (uint32_t) (NATIVE_DATA + offset - next));
+}
+
+static void rinha_native_mov_(native_t *n, int dst, int src) {
+  if (dst != src)
+    rinha_native_rr_(n, 0x8b, dst, src);
+}
+
+static void rinha_native_mov_imm_(native_t *n, int reg, int64_t imm) {
+  if (imm >= 0 && imm <= UINT32_MAX) {
+    // mov r32, imm32 (zero extended)
+    if (reg >= NATIVE_R8)
+      rinha_native_byte_(n, 0x41);
+    rinha_native_byte_(n, 0xb8 + (reg & 7));
+    rinha_native_u32_(n, (uint32_t) imm);
+  } else if (imm >= INT32_MIN && imm <= INT32_MAX) {
+    rinha_native_rr_(n, 0xc7, 0, reg);
+    rinha_native_u32_(n, (uint32_t) imm);
+  } else {
+    rinha_native_op_(n, 0xb8 + (reg & 7), 0, reg);
+    rinha_native_u64_(n, (uint64_t) imm);
+  }
+}
+
+/**
+ * @brief `op reg, imm32` of the 0x81 group (`ext`: 0 add, 5 sub, 7 cmp).
+ */
+static void rinha_native_imm_(native_t *n, int ext, int reg, int32_t imm) {
+  rinha_native_rr_(n, 0x81, ext, reg);
+  rinha_native_u32_(n, (uint32_t) imm);
+}
+
+static void rinha_native_push_(native_t *n, int reg) {
+  if (reg >= NATIVE_R8)
+    rinha_native_byte_(n, 0x41);
+  rinha_native_byte_(n, 0x50 + (reg & 7));
+}
+
+static void rinha_native_pop_(native_t *n, int reg) {
+  if (reg >= NATIVE_R8)
+    rinha_native_byte_(n, 0x41);
+  rinha_native_byte_(n, 0x58 + (reg & 7));
+}
+
+static void rinha_native_call_(native_t *n, int label) {
+  rinha_native_byte_(n, 0xe8);
+  rinha_native_rel_(n, label);
+}
+
+static void rinha_native_jmp_(native_t *n, int label) {
+  rinha_native_byte_(n, 0xe9);
+  rinha_native_rel_(n, label);
+}
+
+static void rinha_native_jcc_(native_t *n, native_cc cc, int label) {
+  rinha_native_byte_(n, 0x0f);
+  rinha_native_byte_(n, 0x80 + cc);
+  rinha_native_rel_(n, label);
+}
+
+static void rinha_native_syscall_(native_t *n, int number) {
+  rinha_native_mov_imm_(n, NATIVE_RAX, number);
+  rinha_native_bytes_(n, "\x0f\x05", 2);
+}
+
+static void rinha_native_patch_(native_t *n) {
+  native_code_t *c = &n->code;
+
+  for (int i = 0; i < c->nfixups; ++i) {
+    int32_t rel = c->labels[c->fixups[i].label] - (int32_t) (c->fixups[i].at + 4);
+    memcpy(&c->bytes[c->fixups[i].at], &rel, sizeof(rel));
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Runtime
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief A string of the runtime, placed after the code.
+ */
+typedef struct {
+  int label;
+  const char *text;
+  size_t size;
+} native_string_t;
+
+enum {
+  NATIVE_TRUE, NATIVE_FALSE, NATIVE_SELF, NATIVE_NAME, NATIVE_EMPTY,
+  NATIVE_NO_FALLBACK, NATIVE_LATE, NATIVE_STRINGS
+};
+
+#define NATIVE_STRING(s) { 0, s, sizeof(s) - 1 }
+
+static native_string_t native_strings[NATIVE_STRINGS] = {
+  NATIVE_STRING("true\n"),
+  NATIVE_STRING("false\n"),
+  NATIVE_STRING("/proc/self/exe\0"),
+  NATIVE_STRING("la-rinha\0"),
+  NATIVE_STRING("\0"),
+  NATIVE_STRING("\nError: the script left the machine words and its interpreter"
+      " could not be started\n"),
+  NATIVE_STRING("\nError: the script left the machine words after its output"
+      " was written: run it with la-rinha\n"),
+};
+
+/**
+ * @brief `lea reg, [rip + string]`, and its size in `size_reg` (if >= 0).
+ */
+static void rinha_native_string_(native_t *n, int which, int reg, int size_reg) {
+  rinha_native_rip_(n, 0x8d, reg, native_strings[which].label);
+  if (size_reg >= 0)
+    rinha_native_mov_imm_(n, size_reg, native_strings[which].size);
+}
+
+/**
+ * @brief Entry point: keeps argv and envp, raises the stack limit as the
+ *        interpreter does (see rinha_stack_config) and sets the depth limit of
+ *        the calls, runs the top level, writes the output and exits.
+ */
+static void rinha_native_start_(native_t *n, int main) {
+  rinha_native_bind_(n, n->start);
+
+  // rax = argc, rcx = argv, rdx = envp = argv + 8 * (argc + 1)
+  rinha_native_bytes_(n, "\x48\x8b\x04\x24", 4);      // mov rax, [rsp]
+  rinha_native_bytes_(n, "\x48\x8d\x4c\x24\x08", 5);  // lea rcx, [rsp + 8]
+  rinha_native_bytes_(n, "\x48\x8d\x54\xc1\x08", 5);  // lea rdx, [rcx + rax * 8 + 8]
+  rinha_native_data_(n, 0x89, NATIVE_RCX, NATIVE_ARGV);
+  rinha_native_data_(n, 0x89, NATIVE_RDX, NATIVE_ENVP);
+
+  // setrlimit(RLIMIT_STACK, { RLIM_INFINITY, RLIM_INFINITY }), then getrlimit
+  rinha_native_mov_imm_(n, NATIVE_RAX, -1);
+  rinha_native_data_(n, 0x89, NATIVE_RAX, NATIVE_RLIMIT);
+  rinha_native_data_(n, 0x89, NATIVE_RAX, NATIVE_RLIMIT + 8);
+  for (int number = 160; number; number = (number == 160) ? 97 : 0) {
+    rinha_native_mov_imm_(n, NATIVE_RDI, 3);
+    rinha_native_data_(n, 0x8d, NATIVE_RSI, NATIVE_RLIMIT);
+    rinha_native_syscall_(n, number);
+  }
+
+  // The calls use half of the limit, up to RINHA_CONFIG_NATIVE_STACK
+  rinha_native_data_(n, 0x8b, NATIVE_RAX, NATIVE_RLIMIT);
+  rinha_native_bytes_(n, "\x48\xd1\xe8", 3);          // shr rax, 1
+  rinha_native_mov_imm_(n, NATIVE_RCX, RINHA_CONFIG_NATIVE_STACK);
+  rinha_native_rr_(n, 0x3b, NATIVE_RAX, NATIVE_RCX);
+  rinha_native_rr_(n, 0x0f40 + NATIVE_A, NATIVE_RAX, NATIVE_RCX);  // cmova
+  rinha_native_mov_(n, NATIVE_RCX, NATIVE_RSP);
+  rinha_native_rr_(n, 0x2b, NATIVE_RCX, NATIVE_RAX);
+  rinha_native_data_(n, 0x89, NATIVE_RCX, NATIVE_LIMIT);
+
+  rinha_native_call_(n, main);
+  rinha_native_call_(n, n->flush);
+  rinha_native_mov_imm_(n, NATIVE_RDI, 0);
+  rinha_native_syscall_(n, 231);                      // exit_group
+}
+
+/**
+ * @brief append(rsi: bytes, rdx: size) to the output; once it is full, the
+ *        output is written and the fallback is no longer possible.
+ */
+static void rinha_native_append_(native_t *n) {
+  int fits = rinha_native_label_(n);
+
+  rinha_native_bind_(n, n->append);
+  rinha_native_data_(n, 0x8b, NATIVE_RAX, NATIVE_LENGTH);
+  rinha_native_mov_(n, NATIVE_RCX, NATIVE_RAX);
+  rinha_native_rr_(n, 0x03, NATIVE_RCX, NATIVE_RDX);
+  rinha_native_imm_(n, 7, NATIVE_RCX, RINHA_CONFIG_NATIVE_OUTPUT_SIZE);
+  rinha_native_jcc_(n, NATIVE_BE, fits);
+
+  rinha_native_push_(n, NATIVE_RSI);
+  rinha_native_push_(n, NATIVE_RDX);
+  rinha_native_call_(n, n->flush);
+  rinha_native_pop_(n, NATIVE_RDX);
+  rinha_native_pop_(n, NATIVE_RSI);
+  rinha_native_mov_imm_(n, NATIVE_RAX, 1);
+  rinha_native_data_(n, 0x89, NATIVE_RAX, NATIVE_FLUSHED);
+  rinha_native_mov_imm_(n, NATIVE_RAX, 0);
+
+  rinha_native_bind_(n, fits);
+  rinha_native_data_(n, 0x8d, NATIVE_RDI, NATIVE_OUTPUT);
+  rinha_native_rr_(n, 0x03, NATIVE_RDI, NATIVE_RAX);
+  rinha_native_mov_(n, NATIVE_RCX, NATIVE_RDX);
+  rinha_native_bytes_(n, "\xf3\xa4", 2);              // rep movsb
+  rinha_native_rr_(n, 0x03, NATIVE_RAX, NATIVE_RDX);
+  rinha_native_data_(n, 0x89, NATIVE_RAX, NATIVE_LENGTH);
+  rinha_native_byte_(n, 0xc3);
+}
+
+/**
+ * @brief flush(): write the output held to stdout.
+ */
+static void rinha_native_flush_(native_t *n) {
+  int loop = rinha_native_label_(n);
+  int done = rinha_native_label_(n);
+
+  rinha_native_bind_(n, n->flush);
+  rinha_native_data_(n, 0x8b, NATIVE_RDX, NATIVE_LENGTH);
+  rinha_native_data_(n, 0x8d, NATIVE_RSI, NATIVE_OUTPUT);
+
+  rinha_native_bind_(n, loop);
+  rinha_native_rr_(n, 0x85, NATIVE_RDX, NATIVE_RDX);
+  rinha_native_jcc_(n, NATIVE_E, done);
+  rinha_native_mov_imm_(n, NATIVE_RDI, 1);
+  rinha_native_syscall_(n, 1);                        // write
+  rinha_native_rr_(n, 0x85, NATIVE_RAX, NATIVE_RAX);
+  rinha_native_jcc_(n, NATIVE_LE, done);
+  rinha_native_rr_(n, 0x03, NATIVE_RSI, NATIVE_RAX);
+  rinha_native_rr_(n, 0x2b, NATIVE_RDX, NATIVE_RAX);
+  rinha_native_jmp_(n, loop);
+
+  rinha_native_bind_(n, done);
+  rinha_native_mov_imm_(n, NATIVE_RAX, 0);
+  rinha_native_data_(n, 0x89, NATIVE_RAX, NATIVE_LENGTH);
+  rinha_native_byte_(n, 0xc3);
+}
+
+/**
+ * @brief print_int(rdi) and print_bool(rdi): `print` of an integer or of a
+ *        boolean, followed by a line feed, as rinha_print_ does.
+ */
+static void rinha_native_prints_(native_t *n) {
+  int loop = rinha_native_label_(n);
+  int positive = rinha_native_label_(n);
+  int done = rinha_native_label_(n);
+
+  rinha_native_bind_(n, n->print_int);
+  rinha_native_mov_(n, NATIVE_RAX, NATIVE_RDI);
+  rinha_native_data_(n, 0x8d, NATIVE_RSI, NATIVE_NUMBER + 24);
+  rinha_native_bytes_(n, "\xc6\x06\x0a", 3);          // mov byte [rsi], '\n'
+  rinha_native_mov_imm_(n, NATIVE_RCX, 10);
+  rinha_native_rr_(n, 0x85, NATIVE_RAX, NATIVE_RAX);
+  rinha_native_jcc_(n, NATIVE_NS, loop);
+  rinha_native_bytes_(n, "\x48\xf7\xd8", 3);          // neg rax (MIN stays 2^63)
+
+  // Digits from the last one, by unsigned division
+  rinha_native_bind_(n, loop);
+  rinha_native_mov_imm_(n, NATIVE_RDX, 0);
+  rinha_native_bytes_(n, "\x48\xf7\xf1", 3);          // div rcx
+  rinha_native_bytes_(n, "\x80\xc2\x30", 3);          // add dl, '0'
+  rinha_native_bytes_(n, "\x48\xff\xce", 3);          // dec rsi
+  rinha_native_bytes_(n, "\x88\x16", 2);              // mov [rsi], dl
+  rinha_native_rr_(n, 0x85, NATIVE_RAX, NATIVE_RAX);
+  rinha_native_jcc_(n, NATIVE_NE, loop);
+
+  rinha_native_rr_(n, 0x85, NATIVE_RDI, NATIVE_RDI);
+  rinha_native_jcc_(n, NATIVE_NS, positive);
+  rinha_native_bytes_(n, "\x48\xff\xce", 3);          // dec rsi
+  rinha_native_bytes_(n, "\xc6\x06\x2d", 3);          // mov byte [rsi], '-'
+
+  rinha_native_bind_(n, positive);
+  rinha_native_data_(n, 0x8d, NATIVE_RDX, NATIVE_NUMBER + 25);
+  rinha_native_rr_(n, 0x2b, NATIVE_RDX, NATIVE_RSI);
+  rinha_native_jmp_(n, n->append);
+
+  rinha_native_bind_(n, n->print_bool);
+  rinha_native_rr_(n, 0x85, NATIVE_RDI, NATIVE_RDI);
+  rinha_native_string_(n, NATIVE_TRUE, NATIVE_RSI, NATIVE_RDX);
+  rinha_native_jcc_(n, NATIVE_NE, done);
+  rinha_native_string_(n, NATIVE_FALSE, NATIVE_RSI, NATIVE_RDX);
+  rinha_native_bind_(n, done);
+  rinha_native_jmp_(n, n->append);
+}
+
+/**
+ * @brief fallback: the script left what native code runs. Unless output was
+ *        written already, the bundle that follows the code is copied into a
+ *        memory file and executed with the same arguments and environment;
+ *        otherwise the output held is written, and the script stops there.
+ *
+ * @param bundle  Label of the offset and size of the bundle in the file.
+ */
+static void rinha_native_fallback_(native_t *n, int bundle) {
+  int copy = rinha_native_label_(n);
+  int exec = rinha_native_label_(n);
+  int error = rinha_native_label_(n);
+  int late = rinha_native_label_(n);
+  int die = rinha_native_label_(n);
+
+  rinha_native_bind_(n, n->fallback);
+  rinha_native_data_(n, 0x8b, NATIVE_RAX, NATIVE_FLUSHED);
+  rinha_native_rr_(n, 0x85, NATIVE_RAX, NATIVE_RAX);
+  rinha_native_jcc_(n, NATIVE_NE, late);
+
+  // r12 = open("/proc/self/exe", O_RDONLY | O_CLOEXEC)
+  rinha_native_string_(n, NATIVE_SELF, NATIVE_RDI, -1);
+  rinha_native_mov_imm_(n, NATIVE_RSI, 02000000);
+  rinha_native_syscall_(n, 2);
+  rinha_native_rr_(n, 0x85, NATIVE_RAX, NATIVE_RAX);
+  rinha_native_jcc_(n, NATIVE_S, error);
+  rinha_native_mov_(n, NATIVE_R12, NATIVE_RAX);
+
+  // r13 = memfd_create("la-rinha", MFD_CLOEXEC)
+  rinha_native_string_(n, NATIVE_NAME, NATIVE_RDI, -1);
+  rinha_native_mov_imm_(n, NATIVE_RSI, 1);
+  rinha_native_syscall_(n, 319);
+  rinha_native_rr_(n, 0x85, NATIVE_RAX, NATIVE_RAX);
+  rinha_native_jcc_(n, NATIVE_S, error);
+  rinha_native_mov_(n, NATIVE_R13, NATIVE_RAX);
+
+  // sendfile(r13, r12, &offset, r14) until the r14 bytes of the bundle are in
+  rinha_native_rip_(n, 0x8b, NATIVE_RAX, bundle);
+  rinha_native_data_(n, 0x89, NATIVE_RAX, NATIVE_OFFSET);
+  rinha_native_rip_(n, 0x8b, NATIVE_R14, bundle + 1);
+
+  rinha_native_bind_(n, copy);
+  rinha_native_rr_(n, 0x85, NATIVE_R14, NATIVE_R14);
+  rinha_native_jcc_(n, NATIVE_E, exec);
+  rinha_native_mov_(n, NATIVE_RDI, NATIVE_R13);
+  rinha_native_mov_(n, NATIVE_RSI, NATIVE_R12);
+  rinha_native_data_(n, 0x8d, NATIVE_RDX, NATIVE_OFFSET);
+  rinha_native_mov_(n, NATIVE_R10, NATIVE_R14);
+  rinha_native_syscall_(n, 40);
+  rinha_native_rr_(n, 0x85, NATIVE_RAX, NATIVE_RAX);
+  rinha_native_jcc_(n, NATIVE_LE, error);
+  rinha_native_rr_(n, 0x2b, NATIVE_R14, NATIVE_RAX);
+  rinha_native_jmp_(n, copy);
+
+  // execveat(r13, "", argv, envp, AT_EMPTY_PATH): only returns on an error
+  rinha_native_bind_(n, exec);
+  rinha_native_mov_(n, NATIVE_RDI, NATIVE_R13);
+  rinha_native_string_(n, NATIVE_EMPTY, NATIVE_RSI, -1);
+  rinha_native_data_(n, 0x8b, NATIVE_RDX, NATIVE_ARGV);
+  rinha_native_data_(n, 0x8b, NATIVE_R10, NATIVE_ENVP);
+  rinha_native_mov_imm_(n, NATIVE_R8, 0x1000);
+  rinha_native_syscall_(n, 322);
+
+  rinha_native_bind_(n, error);
+  rinha_native_string_(n, NATIVE_NO_FALLBACK, NATIVE_RSI, NATIVE_RDX);
+  rinha_native_jmp_(n, die);
+
+  rinha_native_bind_(n, late);
+  rinha_native_call_(n, n->flush);
+  rinha_native_string_(n, NATIVE_LATE, NATIVE_RSI, NATIVE_RDX);
+
+  rinha_native_bind_(n, die);
+  rinha_native_mov_imm_(n, NATIVE_RDI, 2);
+  rinha_native_syscall_(n, 1);
+  rinha_native_mov_imm_(n, NATIVE_RDI, 1);
+  rinha_native_syscall_(n, 231);
+}
+
+// ---------------------------------------------------------------------------
+// Check: closures, calls and types
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief Mark the `let` tokens at the top level (outside any parenthesis or
+ *        brace), as rinha_optimize_ counts the depth.
+ */
+static void rinha_native_top_(native_t *n) {
+  int count = 0;
+
+  while (n->tokens[count].type != TOKEN_EOF)
+    count++;
+
+  n->top = calloc(count + 1, sizeof(bool));
+  if (!n->top)
+    rinha_native_fail_(n, NULL, "out of memory");
+
+  for (int i = 0, depth = 0; i < count; ++i) {
+    switch (n->tokens[i].type) {
+      case TOKEN_LPAREN:
+      case TOKEN_LBRACE:
+        depth++;
+        break;
+      case TOKEN_RPAREN:
+      case TOKEN_RBRACE:
+        depth--;
+        break;
+      case TOKEN_LET:
+        n->top[i] = (depth == 0);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+/**
+ * @brief A value bound once at the top level to an integer or boolean literal
+ *        (`let x = 5;`) is read by the closures as a constant.
+ */
+static void rinha_native_constants_(native_t *n, ir_function_t *ir) {
+  for (int i = 0; i < ir->count; ++i) {
+    ir_inst_t *inst = &ir->insts[i];
+    symbol_t *sym = (inst->op == IR_LOAD_FREE || inst->op == IR_LOAD_GLOBAL)
+        ? rinha_symbol_get(inst->hash) : NULL;
+
+    if (!sym || sym->lets != 1 || !sym->let || !n->top[sym->let - n->tokens] ||
+        (sym->let + 2)->type != TOKEN_ASSIGN ||
+        (sym->let + 4)->type != TOKEN_SEMICOLON)
+      continue;
+
+    switch ((sym->let + 3)->type) {
+      case TOKEN_NUMBER:
+      case TOKEN_TRUE:
+      case TOKEN_FALSE:
+        inst->op = IR_CONST;
+        inst->value = (sym->let + 3)->value;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+/**
+ * @brief The closure bound to `hash`: bound once, at the top level. Its IR is
+ *        built and optimized on the first reference.
+ */
+static native_fn_t *rinha_native_function_(native_t *n, int hash,
+    token_t *where) {
+  for (int i = 0; i < n->nfns; ++i) {
+    if (n->fns[i]->hash == hash && n->fns[i]->let)
+      return n->fns[i];
+  }
+
+  symbol_t *sym = rinha_symbol_get(hash);
+
+  if (!sym || sym->lets != 1 || !sym->let || !n->top[sym->let - n->tokens] ||
+      (sym->let + 2)->type != TOKEN_ASSIGN || (sym->let + 3)->type != TOKEN_FN)
+    rinha_native_fail_(n, where, "a call to a closure not bound once at the top level");
+
+  native_fn_t *fn = calloc(1, sizeof(native_fn_t));
+
+  n->fns = rinha_native_grow_(n, n->fns, &n->fns_capacity, n->nfns + 1,
+      sizeof(native_fn_t *));
+  if (!fn)
+    rinha_native_fail_(n, NULL, "out of memory");
+  n->fns[n->nfns++] = fn;
+
+  fn->hash = hash;
+  fn->let = sym->let;
+  fn->ir = rinha_ir_build(sym->let + 3, hash);
+
+  if (!fn->ir)
+    rinha_native_fail_(n, NULL, "out of memory");
+  if (fn->ir->error)
+    rinha_native_fail_(n, sym->let + 3, fn->ir->error);
+
+  rinha_native_constants_(n, fn->ir);
+  rinha_ir_optimize(fn->ir);
+
+  fn->types = calloc(fn->ir->count, sizeof(value_type));
+  if (!fn->types)
+    rinha_native_fail_(n, NULL, "out of memory");
+  return fn;
+}
+
+/**
+ * @brief The closure called by `call`: a top-level closure named by the call,
+ *        or bound before it on the top level.
+ */
+static native_fn_t *rinha_native_callee_(native_t *n, native_fn_t *fn,
+    ir_inst_t *call) {
+  ir_inst_t *callee = &fn->ir->insts[IR_OPERAND(fn->ir, call, 0)];
+
+  switch (callee->op) {
+    case IR_LOAD_FREE:
+    case IR_LOAD_GLOBAL:
+      return rinha_native_function_(n, callee->hash, call->token);
+    case IR_CLOSURE:
+      if (!fn->let)
+        return rinha_native_function_(n, callee->hash, call->token);
+      // fallthrough
+    default:
+      rinha_native_fail_(n, call->token, "a call to a value that is not a named closure");
+  }
+  return NULL;
+}
+
+static bool rinha_native_join_(native_t *n, value_type *type, value_type with,
+    token_t *where) {
+  if (with == UNDEFINED || with == *type)
+    return false;
+
+  if (*type != UNDEFINED)
+    rinha_native_fail_(n, where, "a value that is an integer or a boolean"
+        " depending on the path");
+
+  *type = with;
+  return true;
+}
+
+static void rinha_native_expect_(native_t *n, value_type type, value_type want,
+    token_t *where) {
+  if (type != UNDEFINED && type != want)
+    rinha_native_fail_(n, where, (want == INTEGER)
+        ? "an operator on a value that is not an integer"
+        : "a condition that is not a boolean");
+}
+
+/**
+ * @brief One round of type inference over a function: integers and booleans
+ *        only, operators on integers, parameters and results joined over the
+ *        calls.
+ *
+ * @return `true` if a type changed.
+ */
+static bool rinha_native_infer_(native_t *n, native_fn_t *fn) {
+  ir_function_t *ir = fn->ir;
+  bool changed = false;
+
+  for (int k = 0; k < ir->blocks_count; ++k) {
+    for (int i = ir->blocks[k].first; i >= 0; i = ir->insts[i].next) {
+      ir_inst_t *inst = &ir->insts[i];
+      value_type l = (inst->argc > 0) ? fn->types[IR_OPERAND(ir, inst, 0)]
+          : UNDEFINED;
+      value_type r = (inst->argc > 1) ? fn->types[IR_OPERAND(ir, inst, 1)]
+          : UNDEFINED;
+      value_type type = UNDEFINED;
+
+      switch (inst->op) {
+        case IR_NOP:
+        case IR_JUMP:
+        case IR_LOAD_FREE:
+        case IR_LOAD_GLOBAL:
+          continue;
+        case IR_CLOSURE:
+          if (fn->let)
+            rinha_native_fail_(n, inst->token, "a closure inside a closure");
+          continue;
+        case IR_PARAM:
+          type = fn->params[inst->arg];
+          break;
+        case IR_CONST:
+          if (inst->value.type != INTEGER && inst->value.type != BOOLEAN)
+            rinha_native_fail_(n, inst->token, (inst->value.type == BIGINT)
+                ? "an integer literal past the machine word"
+                : "a value that is not an integer or a boolean");
+          type = inst->value.type;
+          break;
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_DIV:
+        case IR_MOD:
+          rinha_native_expect_(n, l, INTEGER, inst->token);
+          rinha_native_expect_(n, r, INTEGER, inst->token);
+          type = INTEGER;
+          break;
+        case IR_EQ:
+        case IR_NEQ:
+          if (l != UNDEFINED && r != UNDEFINED && l != r)
+            rinha_native_fail_(n, inst->token, "a comparison of an integer"
+                " with a boolean");
+          type = BOOLEAN;
+          break;
+        case IR_LT:
+        case IR_LTE:
+        case IR_GT:
+        case IR_GTE:
+          rinha_native_expect_(n, l, INTEGER, inst->token);
+          rinha_native_expect_(n, r, INTEGER, inst->token);
+          type = BOOLEAN;
+          break;
+        case IR_BOOL:
+        case IR_BRANCH:
+          rinha_native_expect_(n, l, BOOLEAN, inst->token);
+          type = BOOLEAN;
+          break;
+        case IR_PRINT:
+          type = l;
+          break;
+        case IR_PHI:
+          for (int j = 0; j < inst->argc; ++j)
+            rinha_native_join_(n, &type, fn->types[IR_OPERAND(ir, inst, j)],
+                inst->token);
+          break;
+        case IR_RETURN:
+          changed |= rinha_native_join_(n, &fn->ret, l, inst->token);
+          continue;
+        case IR_CALL: {
+          native_fn_t *callee = rinha_native_callee_(n, fn, inst);
+
+          if (callee->ir->params != inst->argc - 1)
+            rinha_native_fail_(n, inst->token, "a call with a wrong number"
+                " of arguments");
+
+          for (int j = 1; j < inst->argc; ++j)
+            changed |= rinha_native_join_(n, &callee->params[j - 1],
+                fn->types[IR_OPERAND(ir, inst, j)], inst->token);
+          type = callee->ret;
+        } break;
+        default:
+          rinha_native_fail_(n, inst->token, "a value that is not an integer"
+              " or a boolean");
+      }
+
+      if (inst->op != IR_BRANCH && type != fn->types[i]) {
+        fn->types[i] = type;
+        changed = true;
+      }
+    }
+  }
+  return changed;
+}
+
+/**
+ * @brief Closures are only values to call: a load or a closure used anywhere
+ *        else is refused.
+ */
+static void rinha_native_check_uses_(native_t *n, native_fn_t *fn) {
+  ir_function_t *ir = fn->ir;
+
+  for (int k = 0; k < ir->blocks_count; ++k) {
+    for (int i = ir->blocks[k].first; i >= 0; i = ir->insts[i].next) {
+      ir_inst_t *inst = &ir->insts[i];
+
+      // The captures of a top-level closure, and the value of the script,
+      // are not used
+      if (inst->op == IR_CLOSURE || (inst->op == IR_RETURN && !fn->let))
+        continue;
+
+      for (int j = (inst->op == IR_CALL) ? 1 : 0; j < inst->argc; ++j) {
+        ir_op op = ir->insts[IR_OPERAND(ir, inst, j)].op;
+
+        if (op == IR_LOAD_FREE || op == IR_LOAD_GLOBAL || op == IR_CLOSURE)
+          rinha_native_fail_(n, inst->token, "a closure or a top-level value"
+              " used as a value");
+      }
+    }
+  }
+}
+
+/**
+ * @brief The closure bound to `hash`, and every closure or value it may read,
+ *        are bound before `at` (a call from the top level): the interpreter
+ *        would stop on an undefined symbol otherwise. Follows the identifiers
+ *        of the closure bodies, before inlining.
+ */
+static void rinha_native_bound_(native_t *n, int hash, token_t *at, bool *seen) {
+  symbol_t *sym = rinha_symbol_get(hash);
+
+  if (!sym || !sym->let || seen[sym->let - n->tokens])
+    return;
+
+  seen[sym->let - n->tokens] = true;
+
+  if (sym->let > at)
+    rinha_native_fail_(n, at, "a call before a binding it reads");
+
+  token_t *end = rinha_token_skip_value(sym->let + 3);
+
+  for (token_t *t = sym->let + 3; t < end; ++t) {
+    symbol_t *ref = (t->type == TOKEN_IDENTIFIER) ? rinha_symbol_get(t->hash)
+        : NULL;
+
+    if (ref && ref->lets == 1 && ref->let && n->top[ref->let - n->tokens])
+      rinha_native_bound_(n, t->hash, at, seen);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Register allocation: linear scan
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief A function being compiled.
+ *
+ * @var order   Blocks in reverse postorder (an order of the DAG of blocks).
+ * @var next    Block laid out after each block (-1: last).
+ * @var pos     Position of each instruction in that order.
+ * @var end     Position of the terminator of each block.
+ * @var alias   The value an instruction stands for (`bool` of a boolean is
+ *              its operand).
+ * @var fused   Comparisons emitted with the branch that uses them.
+ * @var locs    Where each value lives.
+ * @var saved   Callee-saved registers used (pushed by the prologue).
+ * @var slots   Stack slots of the spilled values (then, with a memo, the
+ *              arguments and the memo entry of the call).
+ * @var memo    First slot of the memo.
+ */
+typedef struct {
+  native_fn_t *fn;
+  int *order;
+  int norder;
+  int *next;
+  int *pos;
+  int *end;
+  int *alias;
+  bool *fused;
+  native_loc_t *locs;
+  int *labels;
+  bool saved[NATIVE_ALLOCATABLE];
+  int nsaved;
+  int slots;
+  int memo;
+} native_func_t;
+
+typedef struct {
+  int value;
+  int start;
+  int end;
+} native_interval_t;
+
+static void rinha_native_rpo_(ir_function_t *ir, int block, bool *seen,
+    int *post, int *count) {
+  if (block < 0 || seen[block])
+    return;
+
+  seen[block] = true;
+
+  int last = ir->blocks[block].last;
+
+  // The true branch is visited last, to be laid out right after the block
+  if (last >= 0) {
+    rinha_native_rpo_(ir, ir->insts[last].target[1], seen, post, count);
+    rinha_native_rpo_(ir, ir->insts[last].target[0], seen, post, count);
+  }
+  post[(*count)++] = block;
+}
+
+static int rinha_native_compare_interval_(const void *a, const void *b) {
+  const native_interval_t *x = a;
+  const native_interval_t *y = b;
+
+  return (x->start != y->start) ? x->start - y->start : x->value - y->value;
+}
+
+static bool rinha_native_is_compare_(ir_op op) {
+  return op >= IR_EQ && op <= IR_GTE;
+}
+
+/**
+ * @brief Order the blocks, number the instructions, and allocate each value
+ *        to a register or a stack slot by linear scan over its live interval:
+ *        from its definition (the end of the first predecessor for a phi) to
+ *        its last use (the end of the predecessor for a phi operand).
+ */
+static void rinha_native_allocate_(native_t *n, native_func_t *f) {
+  ir_function_t *ir = f->fn->ir;
+  int count = ir->count;
+  int blocks = ir->blocks_count;
+  bool *seen = calloc(blocks, sizeof(bool));
+  int *post = calloc(blocks, sizeof(int));
+  int *uses = calloc(count, sizeof(int));
+  int *user = calloc(count, sizeof(int));
+  int *interval = calloc(count, sizeof(int));
+  native_interval_t *intervals = calloc(count, sizeof(native_interval_t));
+
+  f->order = calloc(blocks, sizeof(int));
+  f->next = calloc(blocks, sizeof(int));
+  f->end = calloc(blocks, sizeof(int));
+  f->labels = calloc(blocks, sizeof(int));
+  f->pos = calloc(count, sizeof(int));
+  f->alias = calloc(count, sizeof(int));
+  f->fused = calloc(count, sizeof(bool));
+  f->locs = calloc(count, sizeof(native_loc_t));
+
+  if (!seen || !post || !uses || !user || !interval || !intervals || !f->order ||
+      !f->next || !f->end || !f->labels || !f->pos || !f->alias ||
+      !f->fused || !f->locs) {
+    free(seen); free(post); free(uses); free(user); free(interval);
+    free(intervals);
+    rinha_native_fail_(n, NULL, "out of memory");
+  }
+
+  int norder = 0;
+  rinha_native_rpo_(ir, 0, seen, post, &norder);
+
+  for (int k = 0; k < blocks; ++k)
+    f->next[k] = -1;
+  for (int k = 0; k < norder; ++k) {
+    f->order[k] = post[norder - 1 - k];
+    if (k > 0)
+      f->next[f->order[k - 1]] = f->order[k];
+  }
+  f->norder = norder;
+
+  int p = 0;
+
+  for (int k = 0; k < norder; ++k) {
+    int b = f->order[k];
+
+    f->labels[b] = rinha_native_label_(n);
+    for (int i = ir->blocks[b].first; i >= 0; i = ir->insts[i].next) {
+      ir_inst_t *inst = &ir->insts[i];
+
+      f->pos[i] = p++;
+      f->alias[i] = (inst->op == IR_BOOL) ? f->alias[IR_OPERAND(ir, inst, 0)] : i;
+    }
+    f->end[b] = p - 1;
+  }
+
+  for (int k = 0; k < norder; ++k) {
+    int b = f->order[k];
+
+    for (int i = ir->blocks[b].first; i >= 0; i = ir->insts[i].next) {
+      ir_inst_t *inst = &ir->insts[i];
+
+      if (inst->op == IR_BOOL)
+        continue;
+      for (int j = (inst->op == IR_CALL) ? 1 : 0; j < inst->argc; ++j) {
+        int v = f->alias[IR_OPERAND(ir, inst, j)];
+        uses[v]++;
+        user[v] = i;
+      }
+    }
+  }
+
+  // A comparison only used by the branch of its block sets the flags for it
+  for (int i = 0; i < count; ++i) {
+    ir_inst_t *inst = &ir->insts[i];
+
+    f->fused[i] = rinha_native_is_compare_(inst->op) && uses[i] == 1 &&
+        ir->insts[user[i]].op == IR_BRANCH &&
+        ir->insts[user[i]].block == inst->block;
+  }
+
+  // Live intervals of the values that are stored
+  int nintervals = 0;
+
+  for (int i = 0; i < count; ++i)
+    interval[i] = -1;
+  for (int k = 0; k < norder; ++k) {
+    int b = f->order[k];
+
+    for (int i = ir->blocks[b].first; i >= 0; i = ir->insts[i].next) {
+      ir_inst_t *inst = &ir->insts[i];
+
+      switch (inst->op) {
+        case IR_PARAM:
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_DIV:
+        case IR_MOD:
+        case IR_EQ:
+        case IR_NEQ:
+        case IR_LT:
+        case IR_LTE:
+        case IR_GT:
+        case IR_GTE:
+        case IR_CALL:
+        case IR_PRINT:
+        case IR_PHI:
+          break;
+        default:
+          continue;
+      }
+
+      if (!uses[i] || f->fused[i])
+        continue;
+
+      native_interval_t *it = &intervals[nintervals];
+
+      interval[i] = nintervals;
+      it->value = i;
+      it->start = it->end = (inst->op == IR_PARAM) ? 0 : f->pos[i];
+
+      if (inst->op == IR_PHI) {
+        ir_block_t *join = &ir->blocks[inst->block];
+
+        for (int j = 0; j < join->npreds; ++j) {
+          if (f->end[join->preds[j]] < it->start)
+            it->start = f->end[join->preds[j]];
+        }
+      }
+      nintervals++;
+    }
+  }
+
+  // Last uses
+  for (int k = 0; k < norder; ++k) {
+    int b = f->order[k];
+
+    for (int i = ir->blocks[b].first; i >= 0; i = ir->insts[i].next) {
+      ir_inst_t *inst = &ir->insts[i];
+      int at = f->pos[i];
+
+      if (inst->op == IR_BOOL)
+        continue;
+      if (f->fused[i])
+        at = f->pos[user[i]];
+
+      for (int j = (inst->op == IR_CALL) ? 1 : 0; j < inst->argc; ++j) {
+        int v = f->alias[IR_OPERAND(ir, inst, j)];
+        int use = (inst->op == IR_PHI)
+            ? f->end[ir->blocks[inst->block].preds[j]] : at;
+
+        if (interval[v] >= 0 && intervals[interval[v]].end < use)
+          intervals[interval[v]].end = use;
+      }
+    }
+  }
+
+  qsort(intervals, nintervals, sizeof(native_interval_t),
+      rinha_native_compare_interval_);
+
+  // Active intervals, by register
+  int active[NATIVE_ALLOCATABLE];
+
+  for (int r = 0; r < NATIVE_ALLOCATABLE; ++r)
+    active[r] = -1;
+
+  for (int t = 0; t < nintervals; ++t) {
+    native_interval_t *it = &intervals[t];
+    int free_reg = -1;
+    int furthest = -1;
+
+    for (int r = 0; r < NATIVE_ALLOCATABLE; ++r) {
+      if (active[r] >= 0 && intervals[active[r]].end < it->start)
+        active[r] = -1;
+      if (active[r] < 0) {
+        if (free_reg < 0)
+          free_reg = r;
+      } else if (furthest < 0 ||
+                 intervals[active[r]].end > intervals[active[furthest]].end) {
+        furthest = r;
+      }
+    }
+
+    if (free_reg < 0 && intervals[active[furthest]].end > it->end) {
+      // The active interval that lives longest gives its register away
+      native_loc_t *spilled = &f->locs[intervals[active[furthest]].value];
+
+      spilled->kind = NATIVE_SLOT;
+      spilled->index = f->slots++;
+      free_reg = furthest;
+    }
+
+    if (free_reg < 0) {
+      f->locs[it->value].kind = NATIVE_SLOT;
+      f->locs[it->value].index = f->slots++;
+      continue;
+    }
+
+    active[free_reg] = t;
+    f->locs[it->value].kind = NATIVE_REG;
+    f->locs[it->value].index = free_reg;
+    if (!f->saved[free_reg]) {
+      f->saved[free_reg] = true;
+      f->nsaved++;
+    }
+  }
+
+  free(seen);
+  free(post);
+  free(uses);
+  free(user);
+  free(interval);
+  free(intervals);
+}
+
+// ---------------------------------------------------------------------------
+// Instruction selection
+// ---------------------------------------------------------------------------
+
+static int32_t rinha_native_slot_(native_func_t *f, int slot) {
+  return -8 * (f->nsaved + 1 + slot);
+}
+
+static bool rinha_native_const_(native_func_t *f, int value, int64_t *imm) {
+  ir_inst_t *inst = &f->fn->ir->insts[f->alias[value]];
+
+  if (inst->op != IR_CONST)
+    return false;
+
+  *imm = (inst->value.type == BOOLEAN) ? inst->value.boolean
+      : inst->value.number;
+  return true;
+}
+
+static void rinha_native_load_(native_t *n, native_func_t *f, int value,
+    int reg) {
+  int64_t imm;
+  native_loc_t *loc = &f->locs[f->alias[value]];
+
+  if (rinha_native_const_(f, value, &imm))
+    rinha_native_mov_imm_(n, reg, imm);
+  else if (loc->kind == NATIVE_REG)
+    rinha_native_mov_(n, reg, native_allocatable[loc->index]);
+  else if (loc->kind == NATIVE_SLOT)
+    rinha_native_rbp_(n, 0x8b, reg, rinha_native_slot_(f, loc->index));
+  else
+    rinha_native_mov_imm_(n, reg, 0);
+}
+
+static void rinha_native_store_(native_t *n, native_func_t *f, int value,
+    int reg) {
+  native_loc_t *loc = &f->locs[value];
+
+  if (loc->kind == NATIVE_REG)
+    rinha_native_mov_(n, native_allocatable[loc->index], reg);
+  else if (loc->kind == NATIVE_SLOT)
+    rinha_native_rbp_(n, 0x89, reg, rinha_native_slot_(f, loc->index));
+}
+
+/**
+ * @brief `op rax, value`, with `op` in its `r64, r/m64` form (0x03 add, 0x2b
+ *        sub, 0x3b cmp, 0x0faf imul) and `ext` its imm32 form in the 0x81
+ *        group (-1: imul, 0x69).
+ */
+static void rinha_native_alu_(native_t *n, native_func_t *f, int op, int ext,
+    int value) {
+  int64_t imm;
+  native_loc_t *loc = &f->locs[f->alias[value]];
+
+  if (rinha_native_const_(f, value, &imm) && imm >= INT32_MIN &&
+      imm <= INT32_MAX) {
+    if (ext >= 0) {
+      rinha_native_imm_(n, ext, NATIVE_RAX, (int32_t) imm);
+    } else {
+      rinha_native_rr_(n, 0x69, NATIVE_RAX, NATIVE_RAX);
+      rinha_native_u32_(n, (uint32_t) imm);
+    }
+  } else if (loc->kind == NATIVE_REG) {
+    rinha_native_rr_(n, op, NATIVE_RAX, native_allocatable[loc->index]);
+  } else if (loc->kind == NATIVE_SLOT) {
+    rinha_native_rbp_(n, op, NATIVE_RAX, rinha_native_slot_(f, loc->index));
+  } else {
+    rinha_native_load_(n, f, value, NATIVE_RCX);
+    rinha_native_rr_(n, op, NATIVE_RAX, NATIVE_RCX);
+  }
+}
+
+static native_cc rinha_native_cc_(ir_op op) {
+  switch (op) {
+    case IR_EQ:  return NATIVE_E;
+    case IR_NEQ: return NATIVE_NE;
+    case IR_LT:  return NATIVE_L;
+    case IR_LTE: return NATIVE_LE;
+    case IR_GT:  return NATIVE_G;
+    default:     return NATIVE_GE;
+  }
+}
+
+/**
+ * @brief `l / r` or `l % r` by idiv. A zero divisor, or MIN / -1 (a bignum),
+ *        goes to the fallback.
+ */
+static void rinha_native_div_(native_t *n, native_func_t *f, ir_inst_t *inst) {
+  ir_function_t *ir = f->fn->ir;
+  int64_t k;
+  bool constant = rinha_native_const_(f, IR_OPERAND(ir, inst, 1), &k);
+
+  rinha_native_load_(n, f, IR_OPERAND(ir, inst, 0), NATIVE_RAX);
+  rinha_native_load_(n, f, IR_OPERAND(ir, inst, 1), NATIVE_RCX);
+
+  if (constant && k == 0) {
+    rinha_native_jmp_(n, n->fallback);
+    return;
+  }
+
+  if (!constant) {
+    rinha_native_rr_(n, 0x85, NATIVE_RCX, NATIVE_RCX);
+    rinha_native_jcc_(n, NATIVE_E, n->fallback);
+  }
+
+  if (!constant || k == -1) {
+    int ok = rinha_native_label_(n);
+
+    rinha_native_imm_(n, 7, NATIVE_RCX, -1);
+    rinha_native_jcc_(n, NATIVE_NE, ok);
+    rinha_native_mov_imm_(n, NATIVE_RDX, INT64_MIN);
+    rinha_native_rr_(n, 0x3b, NATIVE_RAX, NATIVE_RDX);
+    rinha_native_jcc_(n, NATIVE_E, n->fallback);
+    rinha_native_bind_(n, ok);
+  }
+
+  rinha_native_bytes_(n, "\x48\x99", 2);              // cqo
+  rinha_native_bytes_(n, "\x48\xf7\xf9", 3);          // idiv rcx
+  if (inst->op == IR_MOD)
+    rinha_native_mov_(n, NATIVE_RAX, NATIVE_RDX);
+}
+
+/**
+ * @brief The phis of `to` take their operands from `from`, all read before any
+ *        of them is written.
+ */
+static void rinha_native_phis_(native_t *n, native_func_t *f, int from, int to) {
+  ir_function_t *ir = f->fn->ir;
+  ir_block_t *join = &ir->blocks[to];
+  int pred = 0;
+  int phis[RINHA_CONFIG_SYMBOLS_SIZE];
+  int count = 0;
+
+  while (pred < join->npreds && join->preds[pred] != from)
+    pred++;
+
+  for (int i = join->first; i >= 0 && ir->insts[i].op == IR_PHI;
+       i = ir->insts[i].next) {
+    if (f->locs[i].kind != NATIVE_NONE && count < RINHA_CONFIG_SYMBOLS_SIZE)
+      phis[count++] = i;
+  }
+
+  if (count == 1) {
+    rinha_native_load_(n, f, IR_OPERAND(ir, &ir->insts[phis[0]], pred), NATIVE_RAX);
+    rinha_native_store_(n, f, phis[0], NATIVE_RAX);
+    return;
+  }
+
+  for (int j = 0; j < count; ++j) {
+    rinha_native_load_(n, f, IR_OPERAND(ir, &ir->insts[phis[j]], pred), NATIVE_RAX);
+    rinha_native_push_(n, NATIVE_RAX);
+  }
+  for (int j = count - 1; j >= 0; --j) {
+    rinha_native_pop_(n, NATIVE_RAX);
+    rinha_native_store_(n, f, phis[j], NATIVE_RAX);
+  }
+}
+
+/**
+ * @brief Look the arguments up in the memo of the function: a hit returns
+ *        before the prologue; r10 is left on the entry for the prologue to keep.
+ */
+static void rinha_native_memo_get_(native_t *n, native_fn_t *fn) {
+  int miss = rinha_native_label_(n);
+  int params = fn->ir->params;
+
+  rinha_native_mov_(n, NATIVE_RAX, NATIVE_RDI);
+  rinha_native_mov_imm_(n, NATIVE_R11, (int64_t) 0x9e3779b97f4a7c15ull);
+  for (int j = 1; j < params; ++j) {
+    rinha_native_rr_(n, 0x0faf, NATIVE_RAX, NATIVE_R11);
+    rinha_native_rr_(n, 0x33, NATIVE_RAX, native_args[j]);
+  }
+  rinha_native_rr_(n, 0x0faf, NATIVE_RAX, NATIVE_R11);
+  rinha_native_rr_(n, 0xc1, 5, NATIVE_RAX);           // shr rax, 64 - bits
+  rinha_native_byte_(n, 64 - RINHA_CONFIG_NATIVE_MEMO_BITS);
+  rinha_native_rr_(n, 0x69, NATIVE_RAX, NATIVE_RAX);
+  rinha_native_u32_(n, NATIVE_MEMO_ENTRY);
+  rinha_native_mov_imm_(n, NATIVE_R10, NATIVE_DATA + fn->memo);
+  rinha_native_rr_(n, 0x03, NATIVE_R10, NATIVE_RAX);
+
+  // [r10 + disp8] operands
+  rinha_native_op_(n, 0x83, 0, NATIVE_R10);           // cmp qword [r10 + set], 0
+  rinha_native_byte_(n, 0x40 | (7 << 3) | (NATIVE_R10 & 7));
+  rinha_native_byte_(n, NATIVE_MEMO_SET);
+  rinha_native_byte_(n, 0);
+  rinha_native_jcc_(n, NATIVE_E, miss);
+  for (int j = 0; j < params; ++j) {
+    rinha_native_op_(n, 0x3b, native_args[j], NATIVE_R10);
+    rinha_native_byte_(n, 0x40 | ((native_args[j] & 7) << 3) | (NATIVE_R10 & 7));
+    rinha_native_byte_(n, 8 * j);
+    rinha_native_jcc_(n, NATIVE_NE, miss);
+  }
+  rinha_native_op_(n, 0x8b, NATIVE_RAX, NATIVE_R10);
+  rinha_native_byte_(n, 0x40 | (NATIVE_RAX << 3) | (NATIVE_R10 & 7));
+  rinha_native_byte_(n, NATIVE_MEMO_RESULT);
+  rinha_native_byte_(n, 0xc3);
+  rinha_native_bind_(n, miss);
+}
+
+/**
+ * @brief Set the memo entry of the call to its arguments and the result (rax).
+ *        The entry is written whole on return: calls in between may have
+ *        taken it.
+ */
+static void rinha_native_memo_set_(native_t *n, native_func_t *f) {
+  int params = f->fn->ir->params;
+
+  rinha_native_rbp_(n, 0x8b, NATIVE_R10, rinha_native_slot_(f, f->memo + params));
+  for (int j = 0; j <= params + 1; ++j) {
+    if (j < params)
+      rinha_native_rbp_(n, 0x8b, NATIVE_RCX, rinha_native_slot_(f, f->memo + j));
+    else
+      rinha_native_mov_imm_(n, NATIVE_RCX, 1);
+
+    int reg = (j == params) ? NATIVE_RAX : NATIVE_RCX;
+    int disp = (j < params) ? 8 * j
+        : (j == params) ? NATIVE_MEMO_RESULT : NATIVE_MEMO_SET;
+
+    rinha_native_op_(n, 0x89, reg, NATIVE_R10);
+    rinha_native_byte_(n, 0x40 | ((reg & 7) << 3) | (NATIVE_R10 & 7));
+    rinha_native_byte_(n, disp);
+  }
+}
+
+static void rinha_native_epilogue_(native_t *n, native_func_t *f) {
+  if (f->nsaved)
+    rinha_native_rbp_(n, 0x8d, NATIVE_RSP, -8 * f->nsaved);
+  else
+    rinha_native_mov_(n, NATIVE_RSP, NATIVE_RBP);
+
+  for (int r = NATIVE_ALLOCATABLE - 1; r >= 0; --r) {
+    if (f->saved[r])
+      rinha_native_pop_(n, native_allocatable[r]);
+  }
+  rinha_native_pop_(n, NATIVE_RBP);
+  rinha_native_byte_(n, 0xc3);
+}
+
+static void rinha_native_branch_(native_t *n, native_func_t *f, int block,
+    ir_inst_t *inst) {
+  ir_function_t *ir = f->fn->ir;
+  int cond = f->alias[IR_OPERAND(ir, inst, 0)];
+  int on_true = inst->target[0];
+  int on_false = inst->target[1];
+  native_cc cc = NATIVE_NE;
+
+  if (f->fused[cond]) {
+    ir_inst_t *cmp = &ir->insts[cond];
+
+    rinha_native_load_(n, f, IR_OPERAND(ir, cmp, 0), NATIVE_RAX);
+    rinha_native_alu_(n, f, 0x3b, 7, IR_OPERAND(ir, cmp, 1));
+    cc = rinha_native_cc_(cmp->op);
+  } else {
+    rinha_native_load_(n, f, cond, NATIVE_RAX);
+    rinha_native_rr_(n, 0x85, NATIVE_RAX, NATIVE_RAX);
+  }
+
+  // The inverse of a condition code flips its lowest bit
+  if (f->next[block] == on_true) {
+    rinha_native_jcc_(n, cc ^ 1, f->labels[on_false]);
+  } else {
+    rinha_native_jcc_(n, cc, f->labels[on_true]);
+    if (f->next[block] != on_false)
+      rinha_native_jmp_(n, f->labels[on_false]);
+  }
+}
+
+static void rinha_native_inst_(native_t *n, native_func_t *f, int block, int i) {
+  ir_function_t *ir = f->fn->ir;
+  ir_inst_t *inst = &ir->insts[i];
+
+  switch (inst->op) {
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL: {
+      static const int ops[] = { 0x03, 0x2b, 0x0faf };
+      static const int exts[] = { 0, 5, -1 };
+      int which = inst->op - IR_ADD;
+
+      rinha_native_load_(n, f, IR_OPERAND(ir, inst, 0), NATIVE_RAX);
+      rinha_native_alu_(n, f, ops[which], exts[which], IR_OPERAND(ir, inst, 1));
+      rinha_native_jcc_(n, NATIVE_O, n->fallback);
+      rinha_native_store_(n, f, i, NATIVE_RAX);
+    } break;
+    case IR_DIV:
+    case IR_MOD:
+      rinha_native_div_(n, f, inst);
+      rinha_native_store_(n, f, i, NATIVE_RAX);
+      break;
+    case IR_EQ:
+    case IR_NEQ:
+    case IR_LT:
+    case IR_LTE:
+    case IR_GT:
+    case IR_GTE:
+      if (f->fused[i] || f->locs[i].kind == NATIVE_NONE)
+        break;
+      rinha_native_load_(n, f, IR_OPERAND(ir, inst, 0), NATIVE_RAX);
+      rinha_native_alu_(n, f, 0x3b, 7, IR_OPERAND(ir, inst, 1));
+      rinha_native_rr_(n, 0x0f90 + rinha_native_cc_(inst->op), 0, NATIVE_RAX);
+      rinha_native_bytes_(n, "\x0f\xb6\xc0", 3);      // movzx eax, al
+      rinha_native_store_(n, f, i, NATIVE_RAX);
+      break;
+    case IR_CALL: {
+      native_fn_t *callee = rinha_native_callee_(n, f->fn, inst);
+
+      for (int j = 1; j < inst->argc; ++j)
+        rinha_native_load_(n, f, IR_OPERAND(ir, inst, j), native_args[j - 1]);
+      rinha_native_call_(n, callee->label);
+      rinha_native_store_(n, f, i, NATIVE_RAX);
+    } break;
+    case IR_PRINT: {
+      int value = IR_OPERAND(ir, inst, 0);
+
+      rinha_native_load_(n, f, value, NATIVE_RDI);
+      rinha_native_call_(n, (f->fn->types[f->alias[value]] == BOOLEAN)
+          ? n->print_bool : n->print_int);
+      if (f->locs[i].kind != NATIVE_NONE) {
+        rinha_native_load_(n, f, value, NATIVE_RAX);
+        rinha_native_store_(n, f, i, NATIVE_RAX);
+      }
+    } break;
+    case IR_JUMP:
+      rinha_native_phis_(n, f, block, inst->target[0]);
+      if (f->next[block] != inst->target[0])
+        rinha_native_jmp_(n, f->labels[inst->target[0]]);
+      break;
+    case IR_BRANCH:
+      rinha_native_branch_(n, f, block, inst);
+      break;
+    case IR_RETURN:
+      rinha_native_load_(n, f, IR_OPERAND(ir, inst, 0), NATIVE_RAX);
+      if (f->fn->memo >= 0)
+        rinha_native_memo_set_(n, f);
+      rinha_native_epilogue_(n, f);
+      break;
+    default:
+      // Parameters are stored by the prologue; constants and booleans are
+      // folded into their uses, phis set by their predecessors
+      break;
+  }
+}
+
+/**
+ * @brief Code of a function: the prologue checks the depth of the calls, saves
+ *        the callee-saved registers it allocates and keeps its parameters,
+ *        then the blocks follow in reverse postorder.
+ */
+static void rinha_native_emit_(native_t *n, native_fn_t *fn) {
+  native_func_t f = {0};
+  ir_function_t *ir = fn->ir;
+
+  f.fn = fn;
+  rinha_native_allocate_(n, &f);
+
+  // Values left without a type (never computed) are words
+  for (int i = 0; i < ir->count; ++i) {
+    if (fn->types[i] == UNDEFINED)
+      fn->types[i] = INTEGER;
+  }
+
+  if (fn->memo >= 0) {
+    f.memo = f.slots;
+    f.slots += ir->params + 1;
+  }
+
+  rinha_native_bind_(n, fn->label);
+  if (fn->memo >= 0)
+    rinha_native_memo_get_(n, fn);
+  rinha_native_push_(n, NATIVE_RBP);
+  rinha_native_mov_(n, NATIVE_RBP, NATIVE_RSP);
+  rinha_native_data_(n, 0x3b, NATIVE_RSP, NATIVE_LIMIT);
+  rinha_native_jcc_(n, NATIVE_B, n->fallback);
+
+  for (int r = 0; r < NATIVE_ALLOCATABLE; ++r) {
+    if (f.saved[r])
+      rinha_native_push_(n, native_allocatable[r]);
+  }
+  if (f.slots)
+    rinha_native_imm_(n, 5, NATIVE_RSP, 8 * f.slots);
+
+  if (fn->memo >= 0) {
+    for (int j = 0; j < ir->params; ++j)
+      rinha_native_rbp_(n, 0x89, native_args[j], rinha_native_slot_(&f, f.memo + j));
+    rinha_native_rbp_(n, 0x89, NATIVE_R10, rinha_native_slot_(&f, f.memo + ir->params));
+  }
+
+  for (int i = ir->blocks[0].first; i >= 0; i = ir->insts[i].next) {
+    if (ir->insts[i].op == IR_PARAM)
+      rinha_native_store_(n, &f, i, native_args[ir->insts[i].arg]);
+  }
+
+  for (int k = 0; k < f.norder; ++k) {
+    int b = f.order[k];
+
+    rinha_native_bind_(n, f.labels[b]);
+    for (int i = ir->blocks[b].first; i >= 0; i = ir->insts[i].next)
+      rinha_native_inst_(n, &f, b, i);
+  }
+
+  free(f.order);
+  free(f.next);
+  free(f.pos);
+  free(f.end);
+  free(f.alias);
+  free(f.fused);
+  free(f.locs);
+  free(f.labels);
+}
+
+// ---------------------------------------------------------------------------
+// Executable
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief Write the ELF headers and the code, then the bundle of the fallback,
+ *        whose offset and size go in the two words at `bundle` (file offset).
+ */
+static bool rinha_native_write_(native_t *n, size_t bundle, const char *script,
+    const char *exe, rinha_engine_t engine, const char *out) {
+  native_code_t *c = &n->code;
+  Elf64_Ehdr header = {0};
+  Elf64_Phdr segments[3] = {{0}};
+
+  memcpy(header.e_ident, ELFMAG, SELFMAG);
+  header.e_ident[EI_CLASS] = ELFCLASS64;
+  header.e_ident[EI_DATA] = ELFDATA2LSB;
+  header.e_ident[EI_VERSION] = EV_CURRENT;
+  header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+  header.e_type = ET_EXEC;
+  header.e_machine = EM_X86_64;
+  header.e_version = EV_CURRENT;
+  header.e_entry = NATIVE_TEXT + c->labels[n->start];
+  header.e_phoff = sizeof(Elf64_Ehdr);
+  header.e_ehsize = sizeof(Elf64_Ehdr);
+  header.e_phentsize = sizeof(Elf64_Phdr);
+  header.e_phnum = 3;
+
+  // The headers and the code
+  segments[0].p_type = PT_LOAD;
+  segments[0].p_flags = PF_R | PF_X;
+  segments[0].p_vaddr = segments[0].p_paddr = NATIVE_BASE;
+  segments[0].p_filesz = segments[0].p_memsz = NATIVE_HEADERS + c->size;
+  segments[0].p_align = 0x1000;
+
+  // The runtime data, zeroed
+  segments[1].p_type = PT_LOAD;
+  segments[1].p_flags = PF_R | PF_W;
+  segments[1].p_vaddr = segments[1].p_paddr = NATIVE_DATA;
+  segments[1].p_memsz = n->data;
+  segments[1].p_align = 0x1000;
+
+  segments[2].p_type = PT_GNU_STACK;
+  segments[2].p_flags = PF_R | PF_W;
+
+  uint64_t offset = NATIVE_HEADERS + c->size;
+  memcpy(&c->bytes[bundle], &offset, sizeof(offset));
+
+  FILE *fp = fopen(out, "wb");
+  bool written = fp &&
+      fwrite(&header, sizeof(header), 1, fp) == 1 &&
+      fwrite(segments, sizeof(segments), 1, fp) == 1 &&
+      fwrite(c->bytes, 1, c->size, fp) == c->size &&
+      rinha_bundle_copy(exe, script, engine, fp);
+
+  if (written) {
+    uint64_t size = ftell(fp) - offset;
+
+    written = fseek(fp, NATIVE_HEADERS + bundle + 8, SEEK_SET) == 0 &&
+        fwrite(&size, sizeof(size), 1, fp) == 1;
+  }
+
+  if (fp && fclose(fp) != 0)
+    written = false;
+
+  if (!written || chmod(out, 0755) == -1) {
+    fprintf(stderr, "Error writing file (file:%s, err: %s)", out,
+       strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+static void rinha_native_free_(native_t *n) {
+  for (int i = 0; i < n->nfns; ++i) {
+    rinha_ir_free(n->fns[i]->ir);
+    free(n->fns[i]->types);
+    free(n->fns[i]);
+  }
+  free(n->fns);
+  free(n->top);
+  free(n->code.bytes);
+  free(n->code.labels);
+  free(n->code.fixups);
+}
+
+bool rinha_native_compile(token_t *tokens, const char *script, const char *exe,
+    rinha_engine_t engine, const char *out) {
+  native_t *n = calloc(1, sizeof(native_t));
+
+  if (!n) {
+    fprintf(stderr, "Memory allocation failed (native code)\n");
+    return false;
+  }
+
+  n->tokens = tokens;
+
+  if (setjmp(n->fail)) {
+    if (n->where)
+      fprintf(stderr, "Error: native code does not support %s (Line: %d);"
+          " --bundle runs any script\n", n->error, n->where->line);
+    else
+      fprintf(stderr, "Error: %s (native code)\n", n->error);
+    rinha_native_free_(n);
+    free(n);
+    return false;
+  }
+
+  rinha_native_top_(n);
+
+  // The top level is a function without parameters
+  native_fn_t *main = calloc(1, sizeof(native_fn_t));
+
+  n->fns = rinha_native_grow_(n, n->fns, &n->fns_capacity, 1,
+      sizeof(native_fn_t *));
+  if (!main)
+    rinha_native_fail_(n, NULL, "out of memory");
+  n->fns[n->nfns++] = main;
+
+  main->ir = rinha_ir_build_program(tokens);
+  if (!main->ir)
+    rinha_native_fail_(n, NULL, "out of memory");
+  if (main->ir->error)
+    rinha_native_fail_(n, tokens, main->ir->error);
+
+  main->types = calloc(main->ir->count, sizeof(value_type));
+  if (!main->types)
+    rinha_native_fail_(n, NULL, "out of memory");
+
+  // Types to a fixed point; the closures called are added as they are found
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (int i = 0; i < n->nfns; ++i)
+      changed |= rinha_native_infer_(n, n->fns[i]);
+  }
+
+  for (int i = 0; i < n->nfns; ++i)
+    rinha_native_check_uses_(n, n->fns[i]);
+
+  ir_function_t *ir = main->ir;
+
+  for (int k = 0; k < ir->blocks_count; ++k) {
+    for (int i = ir->blocks[k].first; i >= 0; i = ir->insts[i].next) {
+      ir_inst_t *inst = &ir->insts[i];
+
+      if (inst->op != IR_CALL)
+        continue;
+
+      size_t count = 0;
+
+      while (tokens[count].type != TOKEN_EOF)
+        count++;
+
+      bool *seen = calloc(count + 1, sizeof(bool));
+
+      if (!seen)
+        rinha_native_fail_(n, NULL, "out of memory");
+      rinha_native_bound_(n, rinha_native_callee_(n, main, inst)->hash,
+          inst->token, seen);
+      free(seen);
+    }
+  }
+
+  // Runtime, then the functions, then the strings and the bundle words
+  n->start = rinha_native_label_(n);
+  n->print_int = rinha_native_label_(n);
+  n->print_bool = rinha_native_label_(n);
+  n->append = rinha_native_label_(n);
+  n->flush = rinha_native_label_(n);
+  n->fallback = rinha_native_label_(n);
+
+  // Pure closures of one to three parameters get a memo, as in the interpreter
+  n->data = NATIVE_DATA_SIZE;
+  for (int i = 0; i < n->nfns; ++i) {
+    native_fn_t *fn = n->fns[i];
+
+    fn->label = rinha_native_label_(n);
+    fn->memo = -1;
+#if RINHA_CONFIG_CACHE_ENABLE == true
+    symbol_t *sym = fn->let ? rinha_symbol_get(fn->hash) : NULL;
+
+    if (sym && sym->pure && fn->ir->params >= 1 && fn->ir->params <= 3) {
+      fn->memo = n->data;
+      n->data += (size_t) NATIVE_MEMO_ENTRY << RINHA_CONFIG_NATIVE_MEMO_BITS;
+    }
+#endif
+  }
+  for (int i = 0; i < NATIVE_STRINGS; ++i)
+    native_strings[i].label = rinha_native_label_(n);
+
+  int bundle = rinha_native_label_(n);
+  rinha_native_label_(n);  /* bundle + 1: its size */
+
+  rinha_native_start_(n, main->label);
+  rinha_native_prints_(n);
+  rinha_native_append_(n);
+  rinha_native_flush_(n);
+  rinha_native_fallback_(n, bundle);
+
+  for (int i = 0; i < n->nfns; ++i)
+    rinha_native_emit_(n, n->fns[i]);
+
+  for (int i = 0; i < NATIVE_STRINGS; ++i) {
+    rinha_native_bind_(n, native_strings[i].label);
+    rinha_native_bytes_(n, native_strings[i].text, native_strings[i].size);
+  }
+
+  while (n->code.size % 8)
+    rinha_native_byte_(n, 0);
+  rinha_native_bind_(n, bundle);
+  rinha_native_u64_(n, 0);
+  rinha_native_bind_(n, bundle + 1);
+  rinha_native_u64_(n, 0);
+
+  rinha_native_patch_(n);
+
+  bool written = rinha_native_write_(n, n->code.labels[bundle], script, exe,
+      engine, out);
+
+  rinha_native_free_(n);
+  free(n);
+  return written;
+}
@@ -0,0 +1,44 @@
+/**
+ * @file native.h
+ *
+ * @brief Rinha Language Interpreter - native x86-64 executables (--compile)
+ *
+ * Scripts whose values are all integers and booleans, with their closures
+ * bound once at the top level and called by name, are compiled ahead of time
+ * into a static x86-64 ELF executable, without a C compiler: the IR of each
+ * closure (see ir.h) goes through instruction selection and a linear-scan
+ * register allocator, and a small runtime (startup, print, exit) is emitted
+ * with the same encoder. Pure closures of one to three parameters keep a memo
+ * of their calls, as the interpreter does (RINHA_CONFIG_NATIVE_MEMO_BITS). The
+ * executable does not need the interpreter, libc nor the script file.
+ *
+ * Native code runs on machine words. Where the interpreter would go on with
+ * something else (a result that leaves the word for a bignum, a division by
+ * zero that stops with an error, a recursion deeper than
+ * RINHA_CONFIG_NATIVE_STACK), the executable runs the script from the start
+ * in the interpreter instead: a bundle (see bundle.h) follows the native code
+ * in the file, and is only read then. Output is held until the script ends
+ * (or RINHA_CONFIG_NATIVE_OUTPUT_SIZE bytes), so nothing is printed twice.
+ */
+
+#ifndef _LA_RINHA_NATIVE_H
+#define _LA_RINHA_NATIVE_H
+
+#include "rinha.h"
+
+/**
+ * @brief Compile a loaded script into a native executable.
+ *
+ * @param[in] tokens  The tokens of the script, after the load-time optimizer.
+ * @param[in] script  The script, bundled for the fallback.
+ * @param[in] exe     The interpreter bundled for the fallback.
+ * @param[in] engine  The engine running the fallback.
+ * @param[in] out     The executable to write.
+ *
+ * @return `false` (with an error on stderr) if the script uses something native
+ *         code does not support, or the executable could not be written.
+ */
+bool rinha_native_compile(token_t *tokens, const char *script, const char *exe,
+    rinha_engine_t engine, const char *out);
+
+#endif
@@ -15,11 +15,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <errno.h>
 
 #include <stdarg.h>
+#include <pthread.h>
 #include <sys/resource.h>
 
 #include "rinha.h"
+#include "ir.h"
+#include "gc.h"
+#include "bignum.h"
+#include "value.h"
+#include "vm.h"
+#include "cc.h"
+#include "native.h"
 
 
 /**
@@ -92,7 +102,7 @@ static stack_t *stack_ctx;
  *
  * Pointer to the current position in the Rinha stack.
  */
-static int rinha_sp = 0;
+int rinha_sp = 0;
 
 /**
  * @brief Token count.
@@ -133,11 +143,526 @@ static function_t calls[RINHA_CONFIG_CALLS_SIZE];
 static bool cache_enabled = RINHA_CONFIG_CACHE_ENABLE;
 static int symref = 0;
 
-static char string_pool[RINHA_CONFIG_STRING_POOL_SIZE][RINHA_CONFIG_STRING_VALUE_SIZE];
+/**
+ * @brief Symbol usage table, indexed by hash (see rinha_optimize_).
+ */
+static symbol_t *symbols = NULL;
+
+/**
+ * @brief Runtime options (see rinha_set_options).
+ */
+static rinha_options_t options = {0};
+
+void rinha_set_options(const rinha_options_t *opts) {
+  options = *opts;
+}
+
+/**
+ * @brief The per-run arena. The objects of a script (tokens, symbols, the
+ *        intern table, inline caches) are bump-allocated in chunks and released
+ *        together by rinha_arena_reset_ when the next script starts, so the
+ *        response of a script stays valid until then. Small blocks given back
+ *        early (rinha_arena_release_) are kept in free lists by size and
+ *        reused. Only the main thread allocates here: the background compiler
+ *        uses malloc. Strings and tuples are collected (see gc.h).
+ */
+typedef struct arena_chunk {
+  struct arena_chunk *next;
+  size_t used;
+  size_t size;
+  char bytes[];
+} arena_chunk_t;
+
+#define RINHA_ARENA_ALIGN(size) (((size) + 7) & ~(size_t) 7)
+
+/* Blocks of up to RINHA_ARENA_CLASSES * 8 bytes are recycled by size */
+#define RINHA_ARENA_CLASSES 32
+
+static arena_chunk_t *arena_chunks = NULL;   /* in use, current first */
+static arena_chunk_t *arena_spare = NULL;    /* kept by the last reset */
+static arena_chunk_t *arena_large = NULL;    /* one per oversized block */
+static void *arena_free[RINHA_ARENA_CLASSES];
+
+static arena_chunk_t *rinha_arena_chunk_(size_t size, bool zero) {
+  arena_chunk_t *chunk = zero ? calloc(1, sizeof(arena_chunk_t) + size)
+                              : malloc(sizeof(arena_chunk_t) + size);
+
+  if (!chunk)
+    rinha_error(rinha_current_token_ctx, "Memory allocation failed");
+
+  chunk->used = 0;
+  chunk->size = size;
+  return chunk;
+}
+
+/**
+ * @brief Oversized blocks (the token array, long strings) get a chunk of their
+ *        own; zeroed ones come from calloc, which leaves fresh pages untouched.
+ */
+static void *rinha_arena_large_(size_t size, bool zero) {
+  arena_chunk_t *chunk = rinha_arena_chunk_(size, zero);
+
+  chunk->used = size;
+  chunk->next = arena_large;
+  arena_large = chunk;
+  return chunk->bytes;
+}
+
+static void *rinha_arena_alloc_(size_t size) {
+  size = RINHA_ARENA_ALIGN(size ? size : 1);
+
+  if (size <= RINHA_ARENA_CLASSES * 8 && arena_free[size / 8 - 1]) {
+    void **block = arena_free[size / 8 - 1];
+    arena_free[size / 8 - 1] = *block;
+    return block;
+  }
+
+  if (size > RINHA_CONFIG_ARENA_CHUNK_SIZE / 4)
+    return rinha_arena_large_(size, false);
+
+  if (!arena_chunks || arena_chunks->used + size > arena_chunks->size) {
+    arena_chunk_t *chunk = arena_spare;
+
+    if (chunk)
+      arena_spare = chunk->next;
+    else
+      chunk = rinha_arena_chunk_(RINHA_CONFIG_ARENA_CHUNK_SIZE, false);
+
+    chunk->used = 0;
+    chunk->next = arena_chunks;
+    arena_chunks = chunk;
+  }
+
+  void *block = &arena_chunks->bytes[arena_chunks->used];
+
+  arena_chunks->used += size;
+  return block;
+}
+
+static void *rinha_arena_calloc_(size_t count, size_t size) {
+  if (RINHA_ARENA_ALIGN(count * size) > RINHA_CONFIG_ARENA_CHUNK_SIZE / 4)
+    return rinha_arena_large_(RINHA_ARENA_ALIGN(count * size), true);
+
+  void *block = rinha_arena_alloc_(count * size);
+
+  memset(block, 0, count * size);
+  return block;
+}
+
+/**
+ * @brief Give a block back before the run ends: the last block of the chunk
+ *        is unbumped, an oversized one is freed, a small one is kept for
+ *        reuse; anything else waits for the reset.
+ */
+static void rinha_arena_release_(void *block, size_t size) {
+  size = RINHA_ARENA_ALIGN(size ? size : 1);
+
+  if (arena_chunks &&
+      (char *) block + size == &arena_chunks->bytes[arena_chunks->used]) {
+    arena_chunks->used -= size;
+    return;
+  }
+
+  if (size > RINHA_CONFIG_ARENA_CHUNK_SIZE / 4) {
+    for (arena_chunk_t **chunk = &arena_large; *chunk; chunk = &(*chunk)->next) {
+      if ((*chunk)->bytes == block) {
+        arena_chunk_t *large = *chunk;
+        *chunk = large->next;
+        free(large);
+        return;
+      }
+    }
+    return;
+  }
+
+  if (size <= RINHA_ARENA_CLASSES * 8) {
+    *(void **) block = arena_free[size / 8 - 1];
+    arena_free[size / 8 - 1] = block;
+  }
+}
+
+/**
+ * @brief Release everything the last script allocated. Up to
+ *        RINHA_CONFIG_ARENA_KEEP_SIZE bytes of chunks are kept for the next
+ *        one, so repeated runs reuse the same memory.
+ */
+static void rinha_arena_reset_(void) {
+  size_t kept = 0;
+
+  for (arena_chunk_t *spare = arena_spare; spare; spare = spare->next)
+    kept += spare->size;
+
+  while (arena_chunks) {
+    arena_chunk_t *next = arena_chunks->next;
+
+    if (kept + arena_chunks->size <= RINHA_CONFIG_ARENA_KEEP_SIZE) {
+      kept += arena_chunks->size;
+      arena_chunks->next = arena_spare;
+      arena_spare = arena_chunks;
+    } else {
+      free(arena_chunks);
+    }
+    arena_chunks = next;
+  }
+
+  while (arena_large) {
+    arena_chunk_t *next = arena_large->next;
+    free(arena_large);
+    arena_large = next;
+  }
+
+  memset(arena_free, 0, sizeof(arena_free));
+}
+
+/**
+ * @brief A string: length-prefixed and immutable once created, so values share
+ *        it by pointer (they point to `data`).
+ *
+ * A concatenation of long strings is a rope: a node with no bytes of its own
+ * that refers to its two halves. `flat` is NULL until something needs the
+ * bytes (see rinha_value_str_), so building a string piece by piece costs a
+ * node per step instead of a copy of everything so far.
+ *
+ * Flat strings are interned: there is one per content, so equal strings are
+ * the same pointer and carry their hash.
+ *
+ * @var length  Length in bytes (of the whole rope for a rope).
+ * @var hash    Hash of the bytes (flat strings).
+ * @var flat    The bytes: `data` for a flat string, the flattened copy of a
+ *              rope, or NULL for a rope not yet flattened.
+ * @var left    Left half of a rope (a string's `data`), NULL otherwise.
+ * @var right   Right half of a rope, NULL otherwise.
+ */
+typedef struct {
+  size_t length;
+  unsigned int hash;
+  char *flat;
+  char *left;
+  char *right;
+  char data[];
+} rinha_string_t;
+
+#define RINHA_STRING(s) \
+  ((rinha_string_t *) ((char *) (s) - offsetof(rinha_string_t, data)))
+
+/**
+ * @brief Allocate a string header followed by `bytes` bytes of data.
+ */
+static rinha_string_t *rinha_string_new_(size_t bytes) {
+  rinha_string_t *string =
+      rinha_gc_alloc(RINHA_GC_STRING, sizeof(rinha_string_t) + bytes);
+
+  if (!string)
+    rinha_error(rinha_current_token_ctx, "Memory allocation failed");
+
+  return string;
+}
+
+/**
+ * @brief The interned strings (their `data`), in an open addressing table kept
+ *        at most half full.
+ */
+static char **interned = NULL;
+static size_t interned_count = 0;
+static size_t interned_capacity = 0;
+
+static unsigned int rinha_string_hash_(const char *bytes, size_t length) {
+  unsigned int hash = 5381;
+
+  for (size_t i = 0; i < length; ++i)
+    hash = ((hash << 5) + hash) + (unsigned char) bytes[i];
+
+  return hash;
+}
+
+/**
+ * @brief The slot holding a string with these bytes, or the empty slot where
+ *        it would go.
+ */
+static size_t rinha_intern_slot_(const char *bytes, size_t length,
+                                 unsigned int hash) {
+  size_t mask = interned_capacity - 1;
+
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    if (!interned[i])
+      return i;
+
+    rinha_string_t *string = RINHA_STRING(interned[i]);
+
+    if (string->hash == hash && string->length == length &&
+        memcmp(string->data, bytes, length) == 0)
+      return i;
+  }
+}
+
+static void rinha_intern_grow_(void) {
+  char **old = interned;
+  size_t old_capacity = interned_capacity;
+
+  interned_capacity = old_capacity ? old_capacity * 2
+      : RINHA_CONFIG_INTERN_TABLE_SIZE;
+  interned = rinha_arena_calloc_(interned_capacity, sizeof(char *));
+
+  for (size_t i = 0; i < old_capacity; ++i) {
+    if (!old[i])
+      continue;
+
+    size_t mask = interned_capacity - 1;
+    size_t j = RINHA_STRING(old[i])->hash & mask;
+
+    while (interned[j])
+      j = (j + 1) & mask;
+    interned[j] = old[i];
+  }
+  if (old)
+    rinha_arena_release_(old, old_capacity * sizeof(char *));
+}
+
+/**
+ * @brief Allocate a flat string of `length` bytes to be filled in and then
+ *        passed to rinha_string_intern_.
+ */
+static char *rinha_string_buffer_(size_t length) {
+  rinha_string_t *string = rinha_string_new_(length + 1);
+
+  string->length = length;
+  string->flat = string->data;
+  string->left = string->right = NULL;
+  string->data[length] = '\0';
+
+  return string->data;
+}
+
+/**
+ * @brief Intern a string just filled in by its creator.
+ *
+ * @return The canonical string with these bytes. When it already existed, the
+ *         new copy is given back to the collector.
+ */
+static char *rinha_string_intern_(char *data) {
+  rinha_string_t *string = RINHA_STRING(data);
+
+  string->hash = rinha_string_hash_(data, string->length);
+
+  if ((interned_count + 1) * 2 > interned_capacity)
+    rinha_intern_grow_();
+
+  size_t slot = rinha_intern_slot_(data, string->length, string->hash);
+
+  if (interned[slot]) {
+    rinha_gc_free(string);
+    return interned[slot];
+  }
+
+  interned[slot] = data;
+  ++interned_count;
+
+  return data;
+}
+
+/**
+ * @brief Create a string from the first `length` bytes of `value`.
+ *
+ * @return The string data (NUL terminated).
+ */
+static char *rinha_alloc_string_(const char *value, size_t length) {
+  char *data = rinha_string_buffer_(length);
+
+  memcpy(data, value, length);
+
+  return rinha_string_intern_(data);
+}
+
+/**
+ * @brief Create a rope node for the concatenation of two strings.
+ */
+static char *rinha_alloc_rope_(char *left, char *right) {
+  rinha_string_t *rope = rinha_string_new_(0);
+
+  rope->length = RINHA_STRING(left)->length + RINHA_STRING(right)->length;
+  rope->flat = NULL;
+  rope->left = left;
+  rope->right = right;
+
+  return rope->data;
+}
+
+/**
+ * @brief Copy the leaves of a rope, left to right, into one flat string and
+ *        keep it in the rope. The walk uses an explicit stack: ropes built by
+ *        a loop are as deep as the loop is long.
+ */
+static char *rinha_rope_flatten_(rinha_string_t *rope) {
+  char *flat = rinha_string_buffer_(rope->length);
+  char *out = flat;
+  size_t capacity = 32, count = 0;
+  rinha_string_t **stack = rinha_arena_alloc_(capacity * sizeof(rinha_string_t *));
+
+  stack[count++] = rope;
+  while (count) {
+    rinha_string_t *s = stack[--count];
+
+    if (s->flat) {
+      memcpy(out, s->flat, s->length);
+      out += s->length;
+      continue;
+    }
+
+    if (count + 2 > capacity) {
+      rinha_string_t **grown =
+          rinha_arena_alloc_(2 * capacity * sizeof(rinha_string_t *));
+
+      memcpy(grown, stack, count * sizeof(rinha_string_t *));
+      rinha_arena_release_(stack, capacity * sizeof(rinha_string_t *));
+      stack = grown;
+      capacity *= 2;
+    }
+    stack[count++] = RINHA_STRING(s->right);
+    stack[count++] = RINHA_STRING(s->left);
+  }
+  rinha_arena_release_(stack, capacity * sizeof(rinha_string_t *));
+
+  rope->flat = rinha_string_intern_(flat);
+  return rope->flat;
+}
+
+/**
+ * @brief The bytes of a string value, flattening it first if it is a rope.
+ *        The value is repointed to the flat copy, so this is paid once.
+ *        Small strings are in the value itself: the pointer lives as long as
+ *        the value does.
+ */
+inline static char *rinha_value_str_(rinha_value_t *value) {
+  if (value->small)
+    return RINHA_SMALL_BYTES(value);
+
+  rinha_string_t *string = RINHA_STRING(value->string);
+
+  if (string->flat != value->string)
+    value->string = string->flat ? string->flat : rinha_rope_flatten_(string);
+
+  return value->string;
+}
+
+inline static size_t rinha_value_length_(rinha_value_t *value) {
+  return value->small ? (size_t) value->small - 1
+      : RINHA_STRING(value->string)->length;
+}
+
+inline static unsigned int rinha_value_hash_(rinha_value_t *value) {
+  return value->small
+      ? rinha_string_hash_(RINHA_SMALL_BYTES(value), value->small - 1)
+      : RINHA_STRING(rinha_value_str_(value))->hash;
+}
+
+/**
+ * @brief A string value from the first `length` bytes of `bytes`: held in the
+ *        value when it fits, interned otherwise.
+ */
+static rinha_value_t rinha_value_string_(const char *bytes, size_t length) {
+  rinha_value_t ret = {0};
+
+  ret.type = STRING;
+  if (length <= RINHA_SMALL_STRING_MAX) {
+    ret.small = length + 1;
+    memcpy(RINHA_SMALL_BYTES(&ret), bytes, length);
+  } else {
+    ret.string = rinha_alloc_string_(bytes, length);
+  }
+
+  return ret;
+}
+
+/**
+ * @brief String equality. Small strings compare their bytes in place; flat
+ *        strings are interned, so once both sides are flat (ropes of different
+ *        lengths never are) it is a pointer compare.
+ */
+bool rinha_string_eq_(rinha_value_t *left, rinha_value_t *right) {
+  if (left->small || right->small)
+    return left->small == right->small &&
+        memcmp(RINHA_SMALL_BYTES(left), RINHA_SMALL_BYTES(right),
+               left->small) == 0;
+
+  if (left->string == right->string)
+    return true;
+
+  if (RINHA_STRING(left->string)->length != RINHA_STRING(right->string)->length)
+    return false;
+
+  return rinha_value_str_(left) == rinha_value_str_(right);
+}
+
+static void rinha_strings_free_(void) {
+  interned = NULL;
+  interned_count = interned_capacity = 0;
+}
+
+/**
+ * @brief Tuples are collected; those still alive when the script ends live
+ *        until the next one starts (the response of a script stays valid).
+ */
+inline static tuple_t *rinha_alloc_tuple_(void) {
+  tuple_t *tuple = rinha_gc_alloc(RINHA_GC_TUPLE, sizeof(tuple_t));
+
+  if (!tuple)
+    rinha_error(rinha_current_token_ctx, "Memory allocation failed");
+
+  return tuple;
+}
+
+static rinha_value_t rinha_value_decimal_(const rinha_value_t *value);
+
+/**
+ * @brief Decimal digits of 0 to 99, two per number.
+ */
+static const char rinha_digit_pairs_[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/**
+ * @brief Write an integer in decimal to `out` (at least RINHA_WORD_DIGITS
+ *        bytes, no NUL is added): the length comes first, from the bit length,
+ *        then the digits go in two at a time from the end.
+ *
+ * @return The number of bytes written.
+ */
+static int rinha_word_format_(RINHA_WORD value, char *out) {
+  static const uint64_t powers[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+    1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+    1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+  };
+  uint64_t n = (value < 0) ? 0 - (uint64_t) value : (uint64_t) value;
+  int sign = value < 0;
+
+  // log10(2) ~ 1233 / 4096, off by at most one
+  int digits = ((64 - __builtin_clzll(n | 1)) * 1233) >> 12;
+  digits += (digits < 20 && n >= powers[digits]) || !digits;
+
+  char *p = out + sign + digits;
+
+  while (n >= 100) {
+    unsigned int pair = (unsigned int) (n % 100) * 2;
+
+    n /= 100;
+    p -= 2;
+    memcpy(p, &rinha_digit_pairs_[pair], 2);
+  }
+
+  if (n >= 10) {
+    p -= 2;
+    memcpy(p, &rinha_digit_pairs_[n * 2], 2);
+  } else {
+    *--p = '0' + (char) n;
+  }
 
-inline static char *rinha_alloc_static_string(void) {
-   static uint32_t index = 0;
-   return string_pool[++index % RINHA_CONFIG_STRING_POOL_SIZE];
+  if (sign)
+    out[0] = '-';
+  return sign + digits;
 }
 
 /**
@@ -165,9 +690,10 @@ void rinha_print_(rinha_value_t *value, bool lf, bool debug) {
   switch (value->type) {
     case STRING:
       if (debug)
-        fprintf(stdout, "\nSTRING (%ld): ->", value->string
-                ? strlen(value->string) : 0);
-      fprintf(stdout, "%s%c", value->string ? value->string : "NULL", end_char);
+        fprintf(stdout, "\nSTRING (%ld): ->", value->small || value->string
+                ? rinha_value_length_(value) : 0);
+      fprintf(stdout, "%s%c", value->small || value->string
+              ? rinha_value_str_(value) : "NULL", end_char);
       break;
     case FUNCTION:
       if (debug)
@@ -175,11 +701,21 @@ void rinha_print_(rinha_value_t *value, bool lf, bool debug) {
              ( (function_t *) value->function)->hash);
       fprintf(stdout, "<#closure>%c", end_char);
       break;
-    case INTEGER:
+    case INTEGER: {
       if (debug)
         fprintf(stdout, "\nINTEGER: ->");
-      fprintf(stdout, "%ld%c", value->number, end_char);
-      break;
+      char digits[RINHA_WORD_DIGITS + 1];
+      int length = rinha_word_format_(value->number, digits);
+
+      digits[length++] = end_char;
+      fwrite(digits, 1, length, stdout);
+    } break;
+    case BIGINT: {
+      if (debug)
+        fprintf(stdout, "\nBIGINT: ->");
+      rinha_value_t digits = rinha_value_decimal_(value);
+      fprintf(stdout, "%s%c", rinha_value_str_(&digits), end_char);
+    } break;
     case BOOLEAN:
       if (debug)
         fprintf(stdout, "\nBOOLEAN: ->");
@@ -190,10 +726,10 @@ void rinha_print_(rinha_value_t *value, bool lf, bool debug) {
         fprintf(stdout, "\nTUPLE: ->");
       fprintf(stdout, "(");
       // Recursively print the elements of the tuple
-      rinha_print_((rinha_value_t *)&value->tuple.first, false, debug);
+      rinha_print_(&value->tuple->first, false, debug);
       fprintf(stdout, ",");
-      rinha_print_((rinha_value_t *)&value->tuple.second, false, debug);
-      fprintf(stdout, ")\n");
+      rinha_print_(&value->tuple->second, false, debug);
+      fprintf(stdout, ")%c", lf ? 0x0a : 0x00);
       break;
     default:
       // Handle unknown value type
@@ -208,46 +744,101 @@ void rinha_print_debug_(rinha_value_t *value) {
   rinha_print_(value, true, true);
 }
 
-_RINHA_CALL_ static rinha_value_t rinha_value_number_set_(RINHA_WORD value) {
-  rinha_value_t ret = {0};
-  ret.type = INTEGER;
-  ret.number = value;
+_RINHA_CALL_ static rinha_value_t rinha_value_string_set_(char *value) {
+  return rinha_value_string_(value, strlen(value));
+}
 
-  return ret;
+/**
+ * @brief An integer literal; one too long for the word becomes a bignum.
+ */
+static rinha_value_t rinha_value_literal_(const char *digits) {
+  rinha_value_t value = {0};
+  errno = 0;
+  long long n = strtoll(digits, NULL, 10);
+
+  if (errno != ERANGE && (RINHA_WORD) n == n)
+    return rinha_value_number_set_(n);
+
+  if (!rinha_bignum_parse(&value, digits))
+    rinha_error(rinha_current_token_ctx, "Memory allocation failed");
+
+  return value;
 }
 
-_RINHA_CALL_ static rinha_value_t rinha_value_bool_set_(bool value) {
-  rinha_value_t ret = {0};
-  ret.type = BOOLEAN;
-  ret.boolean = value;
+/**
+ * @brief The decimal digits of a bignum, as a string value.
+ */
+static rinha_value_t rinha_value_decimal_(const rinha_value_t *value) {
+  char *digits = malloc(rinha_bignum_digits(value) + 1);
+  size_t length = digits ? rinha_bignum_format(value, digits) : 0;
 
-  return ret;
+  if (!length)
+    rinha_error(rinha_current_token_ctx, "Memory allocation failed");
+
+  rinha_value_t string = rinha_value_string_(digits, length);
+
+  free(digits);
+  return string;
 }
 
-_RINHA_CALL_ static rinha_value_t rinha_value_string_set_(char *value) {
-  rinha_value_t ret = {0};
-  ret.type = STRING;
-  ret.string = rinha_alloc_static_string();
-  strncpy(ret.string, value, RINHA_CONFIG_STRING_VALUE_SIZE);
+void __attribute__((noinline)) rinha_value_bignum_(rinha_value_t *ret,
+    const rinha_value_t *left, const rinha_value_t *right, char op) {
+  if (RINHA_INTEGRAL(left) && RINHA_INTEGRAL(right)) {
+    if ((op == '/' || op == '%') && right->type == INTEGER && !right->number)
+      rinha_error(rinha_current_token_ctx, "Division by zero");
 
-  return ret;
+    if (!rinha_bignum_arith(ret, left, right, op))
+      rinha_error(rinha_current_token_ctx, "Memory allocation failed");
+    return;
+  }
+
+  if (left->type == BIGINT || right->type == BIGINT)
+    rinha_error(rinha_current_token_ctx, "Invalid operands for arithmetic");
+
+  rinha_value_t value = *left;
+
+  switch (op) {
+    case '+': value.number += right->number; break;
+    case '-': value.number -= right->number; break;
+    case '*': value.number *= right->number; break;
+    case '/': value.number /= right->number; break;
+    default:  value.number %= right->number;
+  }
+  if (op == '+' || op == '-')
+    value.type = INTEGER;
+  *ret = value;
+}
+
+void __attribute__((noinline)) rinha_value_bignum_k_(rinha_value_t *ret,
+    const rinha_value_t *left, RINHA_WORD k, char op) {
+  rinha_value_t right = rinha_value_number_set_(k);
+
+  rinha_value_bignum_(ret, left, &right, op);
+}
+
+int __attribute__((noinline)) rinha_value_order_(
+    const rinha_value_t *left, const rinha_value_t *right) {
+  if (RINHA_INTEGRAL(left) && RINHA_INTEGRAL(right))
+    return rinha_bignum_cmp(left, right);
+
+  return (left->number > right->number) - (left->number < right->number);
 }
 
-_RINHA_CALL_ static void  rinha_value_caller_set_(rinha_value_t *value, function_t *func) {
-  value->type = FUNCTION;
-  value->function = func;
+int __attribute__((noinline)) rinha_value_order_k_(
+    const rinha_value_t *left, RINHA_WORD k) {
+  rinha_value_t right = rinha_value_number_set_(k);
+
+  return rinha_value_order_(left, &right);
 }
 
-_RINHA_CALL_ static rinha_value_t
+_RINHA_CALL_ rinha_value_t
 rinha_value_tuple_set_(rinha_value_t *first, rinha_value_t *second) {
   rinha_value_t ret = {0};
   ret.type = TUPLE;
 
-  rinha_value_t v1 = rinha_value_set_(*first);
-  rinha_value_t v2 = rinha_value_set_(*second);
-
-  ret.tuple.first = *((struct __primitive *)&v1);
-  ret.tuple.second = *((struct __primitive *)&v2);
+  ret.tuple = rinha_alloc_tuple_();
+  ret.tuple->first = rinha_value_set_(*first);
+  ret.tuple->second = rinha_value_set_(*second);
 
   return ret;
 }
@@ -263,10 +854,14 @@ rinha_value_tuple_set_(rinha_value_t *first, rinha_value_t *second) {
  */
 _RINHA_CALL_ rinha_value_t rinha_value_set_(rinha_value_t value) {
   switch (value.type) {
-    case STRING:
-      return rinha_value_string_set_(value.string);
     case BOOLEAN:
       return rinha_value_bool_set_(value.boolean);
+    // Immutable: shared
+    case STRING:
+    case TUPLE:
+    case BIGINT:
+    case FUNCTION:
+      return value;
     default:
       return rinha_value_number_set_(value.number);
   }
@@ -293,19 +888,38 @@ inline static unsigned long rinha_hash_str_(char *str) {
 }
 
 /**
- * @brief Calculate a hash value for a combination of two integers.
- *
- * This function calculates a hash value for a combination of two integers, 'n' and 'k'.
- * It uses a simple formula: (n * 31 + k) % RINHA_CONFIG_CACHE_SIZE to generate the hash.
- * This particular hash function employs the multiplication by a prime number (31) to help
- * distribute the resulting hash values more evenly.
- *
- * @param[in] n The first integer.
- * @param[in] k The second integer.
- * @return The calculated hash value, which is within the range of [0, RINHA_CONFIG_CACHE_SIZE-1].
+ * @brief A rope whose bytes were never needed: a memo key does not flatten it,
+ *        it is keyed by the node itself.
  */
-inline int rinha_hash_num(int n, int k) {
-    return (n * 31 + k) % RINHA_CONFIG_CACHE_SIZE;
+#define RINHA_ROPE_KEY(v) \
+  (!(v)->small && (v)->string && !RINHA_STRING((v)->string)->flat)
+
+unsigned int rinha_value_key_(rinha_value_t *v) {
+  switch (v->type) {
+    case STRING:
+      return RINHA_ROPE_KEY(v) ? (unsigned int) ((uintptr_t) v->string >> 4)
+          : rinha_value_hash_(v);
+    case BIGINT:
+      return rinha_bignum_hash(v);
+    default:
+      return v->number;
+  }
+}
+
+bool rinha_value_same_key_(rinha_value_t *a, rinha_value_t *b) {
+  if (a->type != b->type)
+    return false;
+
+  switch (a->type) {
+    case STRING:
+      if (RINHA_ROPE_KEY(a) || RINHA_ROPE_KEY(b))
+        return !a->small && !b->small && a->string == b->string;
+      return rinha_string_eq_(a, b);
+    case BIGINT:
+      return rinha_bignum_cmp(a, b) == 0;
+    default:
+      return a->number == b->number;
+  }
 }
 
 /**
@@ -324,9 +938,7 @@ unsigned int rinha_hash_stack_(function_t *f) {
 
   for (register int i = 0; i < f->stack->count; i++) {
     rinha_value_t *v = &f->stack->mem[f->args.hash[i]].value;
-    hash ^= (v->type == STRING)
-        ? (unsigned int)(rinha_hash_str_(v->string))
-        : v->number;
+    hash ^= rinha_value_key_(v);
 
     hash = rinha_hash_num(hash, i);
   }
@@ -374,6 +986,10 @@ void rinha_print_statement_(rinha_value_t *value) {
 
   token_t *nt = rinha_next_token();
   rinha_exec_expression_(value);
+  rinha_exec_print_(value);
+}
+
+void rinha_exec_print_(rinha_value_t *value) {
   rinha_print_(value, /* line feed */ true, /* debug mode */ false);
   cache_enabled = false;
 }
@@ -452,7 +1068,7 @@ token_type rinha_discover_token_typeype_(char *token) {
   } else if (strcmp(token, "<=") == 0) {
     return TOKEN_LTE;
   } else if (isdigit(token[0])) {
-    tokens[rinha_tok_count].value = rinha_value_number_set_(atol(token));
+    tokens[rinha_tok_count].value = rinha_value_literal_(token);
     return TOKEN_NUMBER;
   }
 
@@ -460,7 +1076,28 @@ token_type rinha_discover_token_typeype_(char *token) {
 }
 
 /**
- * @brief Set a variable in the current stack context.
+ * @brief Record that a slot of a frame was set, so that it is cleared when the
+ *        call returns and is the only kind of slot the collector scans.
+ */
+inline static void rinha_stack_use_(stack_t *ctx, int hash) {
+  ctx->used[hash / 64] |= 1ULL << (hash % 64);
+}
+
+/**
+ * @brief Clear the slots set in a frame: the next call at this depth must not
+ *        see (nor the collector keep) the locals of the one that returned.
+ */
+static void rinha_stack_release_(stack_t *ctx) {
+  for (register size_t w = 0; w < sizeof(ctx->used) / sizeof(ctx->used[0]); ++w) {
+    for (uint64_t bits = ctx->used[w]; bits; bits &= bits - 1)
+      ctx->mem[w * 64 + __builtin_ctzll(bits)].value = (rinha_value_t) {0};
+    ctx->used[w] = 0;
+  }
+  ctx->count = 0;
+}
+
+/**
+ * @brief Set a variable in the current stack context.
  *
  * This function sets a variable in the specified stack context with the given value.
  * It also determines the variable type based on the value if it is not explicitly defined.
@@ -477,6 +1114,7 @@ _RINHA_CALL_ void rinha_var_set_(stack_t *ctx, rinha_value_t *value, int hash) {
 
   // Set the variable in the stack context
   rinha_var_copy( &ctx->mem[hash].value, value);
+  rinha_stack_use_(ctx, hash);
 
   ++ctx->count;
 }
@@ -516,11 +1154,13 @@ _RINHA_CALL_ rinha_value_t *rinha_var_get_(stack_t *ctx, int hash) {
 _RINHA_CALL_ function_t *rinha_function_set_(token_t *pc, int hash) {
   function_t *call = &calls[hash];
   call->pc = pc;
+  call->fn = pc;
   call->hash = hash;
   call->args.count = 0;
   call->cache_size = 0;
   call->cache_enabled = RINHA_CONFIG_CACHE_ENABLE;
   call->cache_checked = false;
+  call->version++;
   return call;
 }
 
@@ -563,6 +1203,7 @@ _RINHA_CALL_ void rinha_call_parameter_add(function_t *f, int hash) {
 _RINHA_CALL_ static void rinha_function_param_init_(function_t *call, rinha_value_t *value, int index) {
   // Set the parameter value in the function's stack context
   rinha_var_copy(&call->stack->mem[call->args.hash[index]].value , value);
+  rinha_stack_use_(call->stack, call->args.hash[index]);
 
   // Increment the count of items in the stack context
   ++call->stack->count;
@@ -691,10 +1332,7 @@ void rinha_tokenize_(char **code_ptr, int *rinha_tok_count) {
   int token_position = 0;
   int token_capacity = RINHA_CONFIG_TOKENS_SIZE;
 
-  tokens = (token_t *)calloc(token_capacity, sizeof(token_t));
-
-  if( !tokens )
-    rinha_error(rinha_current_token_ctx, "Memory allocation failed");
+  tokens = rinha_arena_calloc_(token_capacity, sizeof(token_t));
 
   while (**code_ptr != '\0') {
     token_type type = TOKEN_UNDEFINED;
@@ -748,11 +1386,12 @@ void rinha_tokenize_(char **code_ptr, int *rinha_tok_count) {
     size_t tokenLength = *code_ptr - token;
 
     if (*rinha_tok_count >= token_capacity) {
-        token_capacity *= 2;
-        tokens = (token_t *)realloc(tokens, token_capacity * sizeof(token_t));
+        token_t *grown = rinha_arena_calloc_(token_capacity * 2, sizeof(token_t));
 
-        if( !tokens )
-          rinha_error(rinha_current_token_ctx, "Memory allocation failed");
+        memcpy(grown, tokens, token_capacity * sizeof(token_t));
+        rinha_arena_release_(tokens, token_capacity * sizeof(token_t));
+        tokens = grown;
+        token_capacity *= 2;
     }
 
     strncpy(tokens[*rinha_tok_count].lexname, token, tokenLength);
@@ -883,7 +1522,7 @@ void rinha_exec_first(rinha_value_t *ret) {
        "first: Invalid argument, expected a tuple ");
   }
 
-  *ret = *((rinha_value_t *)&ret->tuple.first);
+  *ret = ret->tuple->first;
   rinha_token_consume_(TOKEN_RPAREN);
 }
 
@@ -906,7 +1545,7 @@ void rinha_exec_second(rinha_value_t *ret) {
        "second: Invalid argument, expected a tuple ");
   }
 
-  *ret = *((rinha_value_t *)&ret->tuple.second);
+  *ret = ret->tuple->second;
   rinha_token_consume_(TOKEN_RPAREN);
 }
 
@@ -1085,7 +1724,7 @@ function_t *rinha_prepare_closure(rinha_value_t *ret, int hash) {
       }
       token_t *end = rinha_current_token_ctx;
       rinha_current_token_ctx = token_ctx+1;
-      rinha_call_function_(call, ret);
+      rinha_call_function_(call, ret, NULL);
       rinha_current_token_ctx = end;
       rinha_token_advance();
       return NULL;
@@ -1107,6 +1746,11 @@ inline void rinha_exec_statement_(rinha_value_t *ret) {
 
   switch (rinha_current_token_ctx->type) {
   case TOKEN_LET: {
+    // Unused pure binding, removed by rinha_optimize_
+    if (rinha_current_token_ctx->jmp_pc3) {
+      rinha_current_token_ctx = rinha_current_token_ctx->jmp_pc3;
+      return;
+    }
     rinha_token_consume_(TOKEN_LET);
     int hash = rinha_current_token_ctx->hash;
     int type = rinha_current_token_ctx->type;
@@ -1176,28 +1820,25 @@ inline void rinha_exec_statement_(rinha_value_t *ret) {
 }
 
 
-static bool rinha_cmp_eq(rinha_value_t *left, rinha_value_t *right);
-static bool rinha_cmp_neq(rinha_value_t *left, rinha_value_t *right);
-
 inline static bool rinha_cmp_tuple_eq(tuple_t *left, tuple_t *right)
 {
-  return rinha_cmp_eq((rinha_value_t *) &left->first,
-          (rinha_value_t *) &right->first) &&
-    rinha_cmp_eq((rinha_value_t *) &left->second,
-           (rinha_value_t *)&right->second);
+  return left == right || (rinha_cmp_eq(&left->first, &right->first) &&
+    rinha_cmp_eq(&left->second, &right->second));
 }
 
 inline static bool rinha_cmp_tuple_neq(tuple_t *left, tuple_t *right)
 {
-  return rinha_cmp_neq((rinha_value_t *) &left->first,
-          (rinha_value_t *) &right->first) ||
-    rinha_cmp_neq((rinha_value_t *) &left->second,
-          (rinha_value_t *)&right->second);
+  return left != right && (rinha_cmp_neq(&left->first, &right->first) ||
+    rinha_cmp_neq(&left->second, &right->second));
 }
 
-inline static bool rinha_cmp_eq(rinha_value_t *left, rinha_value_t *right) {
+bool rinha_cmp_eq(rinha_value_t *left, rinha_value_t *right) {
 
   if (left->type != right->type) {
+    // A word and a bignum are never equal
+    if (RINHA_INTEGRAL(left) && RINHA_INTEGRAL(right))
+      return false;
+
     rinha_token_previous();
     rinha_error(rinha_current_token_ctx, "Comparison of different types");
   }
@@ -1205,18 +1846,24 @@ inline static bool rinha_cmp_eq(rinha_value_t *left, rinha_value_t *right) {
   switch(left->type) {
     case INTEGER:
       return (left->number == right->number);
+    case BIGINT:
+      return (rinha_bignum_cmp(left, right) == 0);
     case STRING:
-      return (strcmp(left->string, right->string) == 0);
+      return rinha_string_eq_(left, right);
     case TUPLE:
-      return rinha_cmp_tuple_eq(&left->tuple, &right->tuple);
+      return rinha_cmp_tuple_eq(left->tuple, right->tuple);
     default:
        return left->boolean == right->boolean;
   }
 }
 
-inline static bool rinha_cmp_neq(rinha_value_t *left, rinha_value_t *right) {
+bool rinha_cmp_neq(rinha_value_t *left, rinha_value_t *right) {
 
   if (left->type != right->type) {
+    // A word and a bignum are never equal
+    if (RINHA_INTEGRAL(left) && RINHA_INTEGRAL(right))
+      return true;
+
     rinha_token_previous();
     rinha_error(rinha_current_token_ctx, "Comparison of different types");
   }
@@ -1224,10 +1871,12 @@ inline static bool rinha_cmp_neq(rinha_value_t *left, rinha_value_t *right) {
   switch(left->type) {
     case INTEGER:
       return (left->number != right->number);
+    case BIGINT:
+      return (rinha_bignum_cmp(left, right) != 0);
     case STRING:
-      return (strcmp(left->string, right->string) != 0);
+      return !rinha_string_eq_(left, right);
     case TUPLE:
-      return rinha_cmp_tuple_neq(&left->tuple, &right->tuple);
+      return rinha_cmp_tuple_neq(left->tuple, right->tuple);
     default:
        return left->boolean != right->boolean;
   }
@@ -1258,16 +1907,16 @@ inline static void rinha_exec_comparison_(rinha_value_t *ret) {
         left.boolean = rinha_cmp_eq(&left, &right);
       break;
       case TOKEN_GTE:
-        left.boolean = (left.number >= right.number);
+        left.boolean = RINHA_COMPARE(&left, &right, >=);
         break;
       case TOKEN_LTE:
-        left.boolean = (left.number <= right.number);
+        left.boolean = RINHA_COMPARE(&left, &right, <=);
         break;
       case TOKEN_LT:
-        left.boolean = (left.number < right.number);
+        left.boolean = RINHA_COMPARE(&left, &right, <);
         break;
       case TOKEN_GT:
-        left.boolean = (left.number > right.number);
+        left.boolean = RINHA_COMPARE(&left, &right, >);
         break;
       case TOKEN_NEQ:
         left.boolean = rinha_cmp_neq(&left, &right);
@@ -1278,10 +1927,129 @@ inline static void rinha_exec_comparison_(rinha_value_t *ret) {
   rinha_var_copy(ret, &left);
 }
 
+/**
+ * @brief Jump over a balanced parenthesized group, starting at its '('.
+ */
+inline static void rinha_group_jump_(void) {
+  int open_paren = 0;
+
+  do {
+    switch (rinha_current_token_ctx->type) {
+      case TOKEN_LPAREN:
+        open_paren++;
+        break;
+      case TOKEN_RPAREN:
+        open_paren--;
+        break;
+      case TOKEN_EOF:
+        return;
+    }
+    rinha_token_advance();
+  } while (open_paren);
+}
+
+/**
+ * @brief Jump over a single primary expression without evaluating it.
+ *
+ * Mirrors the shapes accepted by rinha_exec_primary_: literals, identifiers
+ * (with an optional call group), parenthesized groups and tuples, first/second,
+ * if/else and closures.
+ */
+static void rinha_primary_jump_(void) {
+  switch (rinha_current_token_ctx->type) {
+    case TOKEN_IDENTIFIER:
+      rinha_token_advance();
+      if (rinha_current_token_ctx->type == TOKEN_LPAREN) {
+        rinha_group_jump_();
+      }
+      break;
+    case TOKEN_FIRST:
+    case TOKEN_SECOND:
+      rinha_token_advance();
+      rinha_group_jump_();
+      break;
+    case TOKEN_LPAREN:
+      rinha_group_jump_();
+      break;
+    case TOKEN_IF:
+      rinha_token_advance();
+      rinha_group_jump_();
+      rinha_block_jump_(NULL);
+      if (rinha_current_token_ctx->type == TOKEN_ELSE) {
+        rinha_token_advance();
+        rinha_block_jump_(NULL);
+      }
+      break;
+    case TOKEN_FN:
+      rinha_token_advance();
+      rinha_group_jump_();
+      rinha_token_consume_(TOKEN_ARROW);
+      rinha_block_jump_(NULL);
+      break;
+    case TOKEN_EOF:
+      break;
+    default:
+      rinha_token_advance();
+  }
+}
+
+/**
+ * @brief Check if a binary operator binds tighter than the logical operator `op`.
+ *
+ * @param[in] type  The operator token type.
+ * @param[in] op    TOKEN_AND or TOKEN_OR.
+ * @return true if `type` continues the right operand of `op`.
+ */
+inline static bool rinha_operand_continues_(token_type type, token_type op) {
+  switch (type) {
+    case TOKEN_MULTIPLY:
+    case TOKEN_DIVIDE:
+    case TOKEN_MOD:
+    case TOKEN_PLUS:
+    case TOKEN_MINUS:
+    case TOKEN_EQ:
+    case TOKEN_NEQ:
+    case TOKEN_LT:
+    case TOKEN_GT:
+    case TOKEN_LTE:
+    case TOKEN_GTE:
+      return true;
+    case TOKEN_AND:
+      return op == TOKEN_OR;
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Skip the right operand of a `&&`/`||` operator.
+ *
+ * The end of the operand is resolved once, by scanning, and stored in the
+ * operator token (jmp_pc3); later evaluations jump straight to it, in the same
+ * spirit as the if/else jump targets.
+ *
+ * @param[in,out] op  The operator token; the current token is the first one of
+ *                    its right operand.
+ */
+inline static void rinha_short_circuit_(token_t *op) {
+  if (op->jmp_pc3) {
+    rinha_current_token_ctx = op->jmp_pc3;
+    return;
+  }
+
+  rinha_primary_jump_();
+  while (rinha_operand_continues_(rinha_current_token_ctx->type, op->type)) {
+    rinha_token_advance();
+    rinha_primary_jump_();
+  }
+  op->jmp_pc3 = rinha_current_token_ctx;
+}
+
 /**
  * @brief Parse a logical AND expression.
  *
  * This function parses a logical AND expression and returns the result.
+ * The right operand is only evaluated when the left one is true.
  *
  * @param[in,out] left  A pointer to the left operand (updated during parsing).
  * @return The result of the logical AND expression.
@@ -1292,10 +2060,16 @@ inline static void rinha_exec_logical_and_(rinha_value_t *ret) {
   rinha_exec_comparison_(&left);
 
   while (rinha_current_token_ctx->type == TOKEN_AND) {
+    token_t *op = rinha_current_token_ctx;
     rinha_token_advance();
-    rinha_value_t right = {0};
-    rinha_exec_comparison_(&right);
-    left.boolean = left.boolean && right.boolean;
+    if (!left.boolean) {
+      rinha_short_circuit_(op);
+    } else {
+      rinha_value_t right = {0};
+      rinha_exec_comparison_(&right);
+      op->jmp_pc3 = rinha_current_token_ctx;
+      left.boolean = right.boolean;
+    }
     left.type = BOOLEAN;
   }
   rinha_var_copy(ret, &left);
@@ -1305,6 +2079,7 @@ inline static void rinha_exec_logical_and_(rinha_value_t *ret) {
  * @brief Parse a logical OR expression.
  *
  * This function parses a logical OR expression and returns the result.
+ * The right operand is only evaluated when the left one is false.
  *
  * @param[in,out] left  A pointer to the left operand (updated during parsing).
  * @return The result of the logical OR expression.
@@ -1314,10 +2089,16 @@ inline static void rinha_exec_logical_or_(rinha_value_t *ret) {
   rinha_exec_logical_and_(&left);
 
   while (rinha_current_token_ctx->type == TOKEN_OR) {
+    token_t *op = rinha_current_token_ctx;
     rinha_token_advance();
-    rinha_value_t right = {0};
-    rinha_exec_logical_and_(&right);
-    left.boolean = (left.boolean || right.boolean);
+    if (left.boolean) {
+      rinha_short_circuit_(op);
+    } else {
+      rinha_value_t right = {0};
+      rinha_exec_logical_and_(&right);
+      op->jmp_pc3 = rinha_current_token_ctx;
+      left.boolean = right.boolean;
+    }
     left.type = BOOLEAN;
   }
   rinha_var_copy(ret, &left);
@@ -1336,17 +2117,18 @@ inline void rinha_var_copy(rinha_value_t *var1, rinha_value_t *var2) {
       var1->boolean = var2->boolean;
       break;
     case STRING:
-      var1->string = rinha_alloc_static_string();
-      strcpy(var1->string, var2->string);
+      // Small strings are held in the whole value
+      *var1 = *var2;
       break;
     case FUNCTION:
       var1->function = var2->function;
       break;
     case TUPLE:
-      rinha_var_copy( (rinha_value_t *) &var1->tuple.first,
-          (rinha_value_t *) &var2->tuple.first );
-      rinha_var_copy( (rinha_value_t *) &var1->tuple.second,
-          (rinha_value_t *) &var2->tuple.second );
+      // Immutable: shared
+      var1->tuple = var2->tuple;
+      break;
+    case BIGINT:
+      var1->bignum = var2->bignum;
       break;
   }
 }
@@ -1386,14 +2168,14 @@ inline static void rinha_exec_primary_(rinha_value_t *ret) {
   switch (rinha_current_token_ctx->type) {
   case TOKEN_IDENTIFIER:
     {
-      int hash = rinha_current_token_ctx->hash;
-      rinha_value_t *v = rinha_var_get_(stack_ctx, rinha_current_token_ctx->hash);
+      token_t *site = rinha_current_token_ctx;
+      rinha_value_t *v = rinha_var_get_(stack_ctx, site->hash);
       if (v && v->type != UNDEFINED) {
 
         rinha_token_advance();
 
         if(v->type == FUNCTION) {
-           rinha_call_function_((function_t *) v->function , ret);
+           rinha_call_function_((function_t *) v->function , ret, site);
            return;
         }
         rinha_var_copy(ret, v);
@@ -1407,14 +2189,13 @@ inline static void rinha_exec_primary_(rinha_value_t *ret) {
     rinha_prepare_closure(ret, rinha_current_token_ctx->hash);
     break;
   case TOKEN_NUMBER:
-    rinha_current_token_ctx->value = rinha_value_number_set_(atol(rinha_current_token_ctx->lexname));
+    // Read once, by the tokenizer: the tier worker reads the tokens as well
     rinha_var_copy(ret, &rinha_current_token_ctx->value);
     rinha_token_advance();
     break;
   case TOKEN_STRING:
-    rinha_value_t string = rinha_value_string_set_(
-       rinha_current_token_ctx->lexname);
-    rinha_var_copy(ret, &string);
+    // Created once, by the tokenizer
+    *ret = rinha_current_token_ctx->value;
     rinha_token_advance();
     break;
   case TOKEN_LPAREN:
@@ -1505,13 +2286,13 @@ _RINHA_CALL_ void rinha_exec_term_(rinha_value_t *left) {
 
     switch (op_type) {
     case TOKEN_MULTIPLY:
-      left->number *= right.number;
+      rinha_value_arith_(left, left, &right, '*');
       break;
     case TOKEN_DIVIDE:
-      left->number /= right.number;
+      rinha_value_arith_(left, left, &right, '/');
       break;
     case TOKEN_MOD:
-      left->number %= right.number;
+      rinha_value_arith_(left, left, &right, '%');
       break;
     }
   }
@@ -1526,37 +2307,67 @@ _RINHA_CALL_ void rinha_exec_term_(rinha_value_t *left) {
  * @param[in,out] left   A pointer to the left operand and the destination for the result.
  * @param[in]     right  A pointer to the right operand.
  */
-_RINHA_CALL_ static void rinha_value_concat_(rinha_value_t *left, rinha_value_t *right) {
+_RINHA_CALL_ void rinha_value_concat_(rinha_value_t *left, rinha_value_t *right) {
 
-  // Concatenate an integer and a string
-  if (left->type == INTEGER && right->type == STRING) {
-    sprintf(tmp, "%d%s", left->number, right->string);
-    left->string = rinha_alloc_static_string();
+  rinha_value_t *operands[2] = {left, right};
+  const char *bytes[2];
+  size_t lengths[2];
+  char digits[2][RINHA_WORD_DIGITS];
+  rinha_value_t decimal[2];
 
-  // Concatenate a string and an integer
-  } else if (left->type == STRING && right->type == INTEGER) {
+  // Integers and booleans are formatted in place; bignums become strings
+  for (int i = 0; i < 2; i++) {
+    rinha_value_t *v = operands[i];
+
+    if (v->type == BIGINT) {
+      decimal[i] = rinha_value_decimal_(v);
+      operands[i] = v = &decimal[i];
+    }
 
-    sprintf(tmp, "%s%d", left->string, right->number);
+    if (v->type == STRING) {
+      lengths[i] = rinha_value_length_(v);
+      bytes[i] = (v->small || lengths[i] < RINHA_CONFIG_ROPE_MIN_LENGTH)
+          ? rinha_value_str_(v) : NULL;
+    } else if (v->type == INTEGER) {
+      lengths[i] = rinha_word_format_(v->number, digits[i]);
+      bytes[i] = digits[i];
+    } else if (v->type == BOOLEAN) {
+      bytes[i] = BOOL_NAME(v->boolean);
+      lengths[i] = strlen(bytes[i]);
+    } else {
+      rinha_error(rinha_current_token_ctx, "Invalid operands for concatenation");
+    }
+  }
 
-  // Concatenate a string and a boolean
-  } else if (left->type == STRING && right->type == BOOLEAN) {
+  size_t length = lengths[0] + lengths[1];
 
-    sprintf(tmp, "%s%d", left->string, BOOL_NAME(right->boolean));
+  if (length <= RINHA_SMALL_STRING_MAX) {
+    char small[RINHA_SMALL_STRING_MAX];
 
-  // Concatenate a boolean and a string
-  } else if (left->type == BOOLEAN && right->type == STRING) {
+    memcpy(small, bytes[0], lengths[0]);
+    memcpy(small + lengths[0], bytes[1], lengths[1]);
+    *left = rinha_value_string_(small, length);
+    return;
+  }
 
-    sprintf(tmp, "%d%s", BOOL_NAME(left->boolean), right->string);
-    left->string = rinha_alloc_static_string();
+  // Long results become a rope; short ones are cheaper to copy than to chase
+  if (length >= RINHA_CONFIG_ROPE_MIN_LENGTH) {
+    char *leaves[2];
 
-  // Concatenate two strings or unsupported types
+    for (int i = 0; i < 2; i++) {
+      leaves[i] = bytes[i] && (operands[i]->type != STRING || operands[i]->small)
+          ? rinha_alloc_string_(bytes[i], lengths[i]) : operands[i]->string;
+    }
+    left->string = rinha_alloc_rope_(leaves[0], leaves[1]);
   } else {
-    sprintf(tmp, "%s%s", left->string, right->string);
-    left->string = rinha_alloc_static_string();
-  }
+    char *string = rinha_string_buffer_(length);
 
-  strncpy(left->string, tmp, RINHA_CONFIG_STRING_VALUE_SIZE);
+    memcpy(string, bytes[0], lengths[0]);
+    memcpy(string + lengths[0], bytes[1], lengths[1]);
+    left->string = rinha_string_intern_(string);
+  }
   left->type = STRING;
+  left->small = 0;
 }
 
 void rinha_exec_calc_(rinha_value_t *left) {
@@ -1571,21 +2382,38 @@ void rinha_exec_calc_(rinha_value_t *left) {
     rinha_exec_term_(&right);
 
     if (op_type == TOKEN_PLUS &&
-        (left->type != INTEGER || right.type != INTEGER) ) {
+        (!RINHA_INTEGRAL(left) || !RINHA_INTEGRAL(&right))) {
       rinha_value_concat_(left, &right);
       continue;
     }
 
     if (op_type == TOKEN_PLUS) {
-      left->number += (RINHA_WORD) right.number;
-
+      rinha_value_arith_(left, left, &right, '+');
     } else {
-      left->number -= (RINHA_WORD) right.number;
+      rinha_value_arith_(left, left, &right, '-');
     }
-    left->type = INTEGER;
   }
 }
 
+/**
+ * @brief Check the arguments of a call before its memo key is hashed: only
+ *        integers are memoized here. Anything else turns the memo of the
+ *        closure off, so a call that accumulates a string does not pay for a
+ *        key it never uses.
+ *
+ * @return `true` if the call can use the memo.
+ */
+inline static bool rinha_call_memo_args_(function_t *call) {
+  for (register int i = 0; i < call->args.count; ++i) {
+    rinha_value_t *arg = rinha_function_get_arg(call, i);
+
+    if (arg->type != UNDEFINED && !RINHA_INTEGRAL(arg)) {
+      call->cache_enabled = false;
+      return false;
+    }
+  }
+  return true;
+}
 
 /**
  * @brief Get a cached value from the memoization cache.
@@ -1612,29 +2440,12 @@ inline static bool rinha_call_memo_cache_get_(function_t *call, rinha_value_t *r
     return false;
 
   rinha_value_t *arg0 = rinha_function_get_arg(call, 0);
-
-  if (arg0->type != UNDEFINED && arg0->type != INTEGER) {
-    call->cache_enabled = false;
-    return false;
-  }
-
   rinha_value_t *arg1 = rinha_function_get_arg(call, 1);
-
-  if (arg1->type != UNDEFINED && arg1->type != INTEGER) {
-    call->cache_enabled = false;
-    return false;
-  }
-
   rinha_value_t *arg2 = rinha_function_get_arg(call, 2);
 
-  if (arg2->type != UNDEFINED && arg2->type != INTEGER) {
-    call->cache_enabled = false;
-    return false;
-  }
-
-  if (cache->input0.number != arg0->number ||
-      cache->input1.number != arg1->number ||
-      cache->input2.number != arg2->number) {
+  if (!rinha_value_same_key_(&cache->input0, arg0) ||
+      !rinha_value_same_key_(&cache->input1, arg1) ||
+      !rinha_value_same_key_(&cache->input2, arg2)) {
     return false;
   }
 
@@ -1699,7 +2510,96 @@ inline void rinha_exec_expression_(rinha_value_t *ret) {
 }
 
 
-inline static void rinha_exec_function_(function_t *call, rinha_value_t *ret, rinha_value_t *args) {
+/**
+ * @brief A closure resolved at a call site.
+ *
+ * @var call      The closure.
+ * @var version   function_t::version when it was resolved (closures are
+ *                re-created in place, see rinha_prepare_closure).
+ * @var arity     Number of parameters.
+ * @var captures  Number of captured variables.
+ * @var capture   Hashes of the captured variables (defined slots of env).
+ */
+typedef struct {
+  function_t *call;
+  unsigned int version;
+  int arity;
+  int captures;
+  unsigned char capture[RINHA_CONFIG_SYMBOLS_SIZE];
+} inline_cache_entry_t;
+
+/**
+ * @brief The inline cache of a call site: the last closures it called.
+ */
+typedef struct {
+  int count;
+  int next;
+  inline_cache_entry_t entries[RINHA_CONFIG_INLINE_CACHE_SIZE];
+} inline_cache_t;
+
+static inline_cache_t **inline_caches = NULL;
+
+/**
+ * @brief Find the closure in the inline cache of a call site, adding it (over
+ *        the oldest entry when full) on a miss.
+ *
+ * @param[in] site  The identifier token of the call, or NULL.
+ * @param[in] call  The closure the identifier resolved to.
+ * @return The entry, or NULL if the call site has no cache.
+ */
+static inline_cache_entry_t *rinha_inline_cache_(token_t *site,
+    function_t *call) {
+#if RINHA_CONFIG_INLINE_CACHE_ENABLE == true
+  if (!site || !inline_caches)
+    return NULL;
+
+  inline_cache_t **slot = &inline_caches[site - tokens];
+  inline_cache_t *ic = *slot;
+
+  if (!ic) {
+    ic = *slot = rinha_arena_calloc_(1, sizeof(inline_cache_t));
+  }
+
+  for (register int i = 0; i < ic->count; ++i) {
+    inline_cache_entry_t *entry = &ic->entries[i];
+    if (entry->call == call && entry->version == call->version)
+      return entry;
+  }
+
+  inline_cache_entry_t *entry = &ic->entries[ic->next];
+
+  if (ic->count < RINHA_CONFIG_INLINE_CACHE_SIZE)
+    ic->count++;
+  ic->next = (ic->next + 1) % RINHA_CONFIG_INLINE_CACHE_SIZE;
+
+  entry->call = call;
+  entry->version = call->version;
+  entry->arity = call->args.count;
+  entry->captures = 0;
+
+  for (register int i = 0; i < RINHA_CONFIG_SYMBOLS_SIZE; ++i) {
+    if (call->env[i].type != UNDEFINED)
+      entry->capture[entry->captures++] = i;
+  }
+
+  return entry;
+#else
+  return NULL;
+#endif
+}
+
+static void rinha_inline_caches_free_(void) {
+  inline_caches = NULL;
+}
+
+/**
+ * @brief Run a closure on the token walker.
+ *
+ * @param[in] entry  The inline cache entry of the call site, or NULL: the
+ *                   captured variables are then found by scanning env.
+ */
+inline static void rinha_exec_function_(function_t *call, rinha_value_t *ret,
+    rinha_value_t *args, inline_cache_entry_t *entry) {
 
   if ( rinha_sp == 0 ) {
     cache_enabled = RINHA_CONFIG_CACHE_ENABLE;
@@ -1708,9 +2608,22 @@ inline static void rinha_exec_function_(function_t *call, rinha_value_t *ret, ri
   stack_ctx = &stacks[rinha_sp];
   call->stack = &stacks[++rinha_sp];
 
-  for (register int i = 0; i < RINHA_CONFIG_SYMBOLS_SIZE; ++i) {
-    if (call->env[i].type != UNDEFINED ) {
-      rinha_var_copy(&call->stack->mem[i].value, &call->env[i]);
+  // Active calls, for the backedges of the tiered engine
+  if (options.engine == RINHA_ENGINE_TIERED)
+    call->depth++;
+
+  if (entry) {
+    for (register int i = 0; i < entry->captures; ++i) {
+      int slot = entry->capture[i];
+      rinha_var_copy(&call->stack->mem[slot].value, &call->env[slot]);
+      rinha_stack_use_(call->stack, slot);
+    }
+  } else {
+    for (register int i = 0; i < RINHA_CONFIG_SYMBOLS_SIZE; ++i) {
+      if (call->env[i].type != UNDEFINED ) {
+        rinha_var_copy(&call->stack->mem[i].value, &call->env[i]);
+        rinha_stack_use_(call->stack, i);
+      }
     }
   }
 
@@ -1719,7 +2632,7 @@ inline static void rinha_exec_function_(function_t *call, rinha_value_t *ret, ri
   }
   unsigned int hash = 0;
 
-  if (cache_enabled && call->cache_enabled)
+  if (cache_enabled && call->cache_enabled && rinha_call_memo_args_(call))
     hash = rinha_hash_stack_(call);
 
   token_t *current_pc = rinha_current_token_ctx;
@@ -1734,12 +2647,21 @@ inline static void rinha_exec_function_(function_t *call, rinha_value_t *ret, ri
   }
 
   --rinha_sp;
-  call->stack->count = 0;
+  if (options.engine == RINHA_ENGINE_TIERED)
+    call->depth--;
+  rinha_stack_release_(call->stack);
   stack_ctx = call->stack = &stacks[rinha_sp];
   rinha_current_token_ctx = current_pc;
   rinha_token_advance();
 }
 
+static bool rinha_precompute_literal_args_(token_t *t);
+static uint64_t rinha_precompute_key_(function_t *call, rinha_value_t *args);
+static bool rinha_precompute_get_(uint64_t key, rinha_value_t *ret);
+static void rinha_precompute_set_(uint64_t key, rinha_value_t *value);
+static bool rinha_tier_call_(function_t *call, rinha_value_t *args,
+    rinha_value_t *ret);
+
 /**
  * @brief Execute a Rinha function call.
  *
@@ -1748,8 +2670,10 @@ inline static void rinha_exec_function_(function_t *call, rinha_value_t *ret, ri
  *
  * @param[in]  call  A pointer to the function call structure.
  * @param[out] ret   A pointer to store the return value (updated during execution).
+ * @param[in]  site  The identifier token of the call (inline cache), or NULL.
  */
-inline static void rinha_call_function_(function_t *call, rinha_value_t *ret)
+inline static void rinha_call_function_(function_t *call, rinha_value_t *ret,
+    token_t *site)
 {
   if (rinha_current_token_ctx->type != TOKEN_LPAREN) {
     rinha_value_caller_set_(ret, call);
@@ -1760,12 +2684,17 @@ inline static void rinha_call_function_(function_t *call, rinha_value_t *ret)
     rinha_error(rinha_current_token_ctx, "Stack overflow!");
   }
 
+  bool precompute = options.precompute && rinha_sp == 0 &&
+      rinha_precompute_literal_args_(rinha_current_token_ctx);
+
   rinha_token_consume_(TOKEN_LPAREN);
 
   rinha_value_t args[RINHA_CONFIG_FUNCTION_ARGS_SIZE];
+  inline_cache_entry_t *entry = rinha_inline_cache_(site, call);
+  int arity = entry ? entry->arity : call->args.count;
 
   // Parse function arguments
-  for (register int i = 0; i < call->args.count; ++i) {
+  for (register int i = 0; i < arity; ++i) {
 
     if (call->args.values[i].type != UNDEFINED) {
         rinha_var_copy((rinha_value_t *) &args[i], &call->args.values[i]);
@@ -1777,7 +2706,44 @@ inline static void rinha_call_function_(function_t *call, rinha_value_t *ret)
     }
   }
 
-  rinha_exec_function_(call, ret, args);
+  uint64_t key = precompute ? rinha_precompute_key_(call, args) : 0;
+
+  if (key && rinha_precompute_get_(key, ret)) {
+    rinha_token_advance();
+    return;
+  }
+
+#if RINHA_CONFIG_RECURRENCE_ENABLE == true
+  if (rinha_recurrence_call_(call, args, ret)) {
+    rinha_token_advance();
+    if (key)
+      rinha_precompute_set_(key, ret);
+    return;
+  }
+#endif
+
+  if ((options.engine == RINHA_ENGINE_REGVM && rinha_vm_call(call, args, ret)) ||
+      (options.engine == RINHA_ENGINE_CLOSURE && rinha_cc_call(call, args, ret)) ||
+      (options.engine == RINHA_ENGINE_TIERED && rinha_tier_call_(call, args, ret))) {
+    rinha_token_advance();
+    if (key)
+      rinha_precompute_set_(key, ret);
+    return;
+  }
+
+  rinha_exec_function_(call, ret, args, entry);
+
+  if (key)
+    rinha_precompute_set_(key, ret);
+}
+
+void rinha_exec_call_(function_t *call, rinha_value_t *args, rinha_value_t *ret,
+    token_t *token) {
+  token_t *ctx = rinha_current_token_ctx;
+
+  rinha_current_token_ctx = token;
+  rinha_exec_function_(call, ret, args, NULL);
+  rinha_current_token_ctx = ctx;
 }
 
 /**
@@ -1803,36 +2769,50 @@ inline void rinha_exec_block_(rinha_value_t *ret) {
   rinha_token_consume_(TOKEN_RBRACE);
 }
 
+/**
+ * @brief Parse an if/else statement and execute the selected branch.
+ *
+ * Skipped branches are scanned only once: the end of the then-branch is stored
+ * in its first token (jmp_pc2) and the end of the else-branch in the `else`
+ * token (jmp_pc1). Conditions folded by rinha_optimize_ are not evaluated.
+ *
+ * @param[out] ret  A pointer to store the value of the executed branch.
+ */
 inline void rinha_exec_if_statement_(rinha_value_t *ret) {
-  rinha_token_consume_(TOKEN_IF);
-  rinha_token_consume_(TOKEN_LPAREN);
-  rinha_exec_logical_or_(ret);
-  rinha_token_consume_(TOKEN_RPAREN);
+  token_t *if_token = rinha_current_token_ctx;
 
-  if (ret->boolean) {
+  if (if_token->jmp_pc3) {
+    rinha_var_copy(ret, &if_token->value);
+    rinha_current_token_ctx = if_token->jmp_pc3;
+  } else {
+    rinha_token_consume_(TOKEN_IF);
+    rinha_token_consume_(TOKEN_LPAREN);
+    rinha_exec_logical_or_(ret);
+    rinha_token_consume_(TOKEN_RPAREN);
+  }
 
+  if (ret->boolean) {
     rinha_exec_block_(ret);
-    token_t *tmp_pc = rinha_current_token_ctx;
 
-    if (rinha_current_token_ctx->jmp_pc1) {
-      rinha_current_token_ctx = rinha_current_token_ctx->jmp_pc1;
-      rinha_token_advance();
-      return;
-    }
-    if (rinha_current_token_ctx->type == TOKEN_ELSE) {
-      rinha_token_consume_(TOKEN_ELSE);
-      rinha_block_jump_(NULL);
+    token_t *else_token = rinha_current_token_ctx;
+
+    if (else_token->type == TOKEN_ELSE) {
+      if (else_token->jmp_pc1) {
+        rinha_current_token_ctx = else_token->jmp_pc1;
+      } else {
+        rinha_token_consume_(TOKEN_ELSE);
+        rinha_block_jump_(NULL);
+        else_token->jmp_pc1 = rinha_current_token_ctx;
+      }
     }
-    rinha_current_token_ctx->jmp_pc1 = rinha_current_token_ctx;
   } else {
-    int tmp_pc = rinha_pc;
+    token_t *then_token = rinha_current_token_ctx;
 
-    if (!rinha_current_token_ctx->jmp_pc2) {
-      rinha_block_jump_(NULL);
-      rinha_current_token_ctx->jmp_pc2 = rinha_current_token_ctx;
+    if (then_token->jmp_pc2) {
+      rinha_current_token_ctx = then_token->jmp_pc2;
     } else {
-      rinha_current_token_ctx = rinha_current_token_ctx->jmp_pc2;
-      rinha_token_advance();
+      rinha_block_jump_(NULL);
+      then_token->jmp_pc2 = rinha_current_token_ctx;
     }
 
     if (rinha_current_token_ctx->type == TOKEN_ELSE) {
@@ -1866,7 +2846,7 @@ void rinha_yaswoc(rinha_value_t *value) {
   int l = strlen(dialog);
   int i = 1;
 
-  v.string = rinha_alloc_static_string();
+  v.string = tmp;
 
   v.string[0] = 0x20;
   for (; i < l; ++i)
@@ -1887,74 +2867,1626 @@ void rinha_yaswoc(rinha_value_t *value) {
     v.string[i++] = woc[j];
   v.string[i++] = 0x0A;
   v.string[i++] = 0x00;
+  v = rinha_value_string_(tmp, i - 1);
 
   rinha_print_(&v, true, false);
   rinha_token_advance();
 }
 
-void rinha_clear_stack(void) {
-
-  tokens = NULL;
-  //memset(tokens, 0, sizeof(tokens));
-  memset(calls, 0, sizeof(calls));
-  memset(tmp, 0, sizeof(tmp));
-  memset(string_pool, 0, sizeof(string_pool));
-}
-
-inline static void rinha_clear_context(void) {
-  stack_ctx       = NULL;
-  rinha_sp        = 0;
-  rinha_pc        = 0;
-  rinha_tok_count = 0;
-  on_tests        = false;
-  symref          = 0;
+/**
+ * @brief Jump over a whole expression, including `&&`, `||` and assignments.
+ */
+static void rinha_value_jump_(void) {
+  rinha_primary_jump_();
+  while (rinha_operand_continues_(rinha_current_token_ctx->type, TOKEN_OR) ||
+         rinha_current_token_ctx->type == TOKEN_OR ||
+         rinha_current_token_ctx->type == TOKEN_ASSIGN) {
+    rinha_token_advance();
+    rinha_primary_jump_();
+  }
 }
 
 /**
- * @brief Execute a Rinha script.
- *
- * This function executes a Rinha script, parsing and interpreting the provided script code.
- *
- * @param name Script name.
- * @param script The Rinha script code to execute.
- * @param[out] response The result of script execution.
- * @param test Set to true if running in test mode, false otherwise.
+ * @brief Find the end of the expression starting at `start`.
  *
- * @return `true` if the script executed successfully, `false` on failure.
+ * @param[in] start  The first token of the expression.
+ * @return The first token after the expression.
  */
-bool rinha_script_exec(char *name, char *script, rinha_value_t *response, bool test) {
+static token_t *rinha_value_end_(token_t *start) {
+  token_t *ctx = rinha_current_token_ctx;
 
-    stacks = calloc(RINHA_CONFIG_STACK_SIZE, sizeof(stack_t));
-
-    if (stacks == NULL) {
-      fprintf(stderr, "Memory allocation failed (Size:%d Mb)",
-      (( RINHA_CONFIG_STACK_SIZE * sizeof(stack_t) ) / 1024) / 1024 );
-       return false;
-    }
+  rinha_current_token_ctx = start;
+  rinha_value_jump_();
 
-    rinha_clear_context();
+  token_t *end = rinha_current_token_ctx;
+  rinha_current_token_ctx = ctx;
+  return end;
+}
 
-    strcpy(source_name, name);
-    on_tests = test;
+/**
+ * @brief End of the value of each `fn` token, by token index, found the first
+ *        time it is needed.
+ *
+ * Only the main thread fills it (rinha_value_end_ moves the token walker): the
+ * background compiler reads the entries warmed up by rinha_fn_ends_warm_.
+ */
+static token_t **fn_ends = NULL;
 
-    stack_ctx = stacks;
-    char *code_ptr = source_code = script;
+token_t *rinha_token_skip_value(token_t *start) {
+  if (!fn_ends || start->type != TOKEN_FN)
+    return rinha_value_end_(start);
 
-    while (*code_ptr != '\0') {
-      rinha_tokenize_(&code_ptr, &rinha_tok_count);
-    }
+  token_t **end = &fn_ends[start - tokens];
 
-    tokens[rinha_tok_count++].type = TOKEN_EOF;
+  if (!*end)
+    *end = rinha_value_end_(start);
 
-    // Initialize current token
-    rinha_current_token_ctx = tokens;
-    rinha_value_t ret = {0};
+  return *end;
+}
 
-    rinha_exec_program_(&ret);
-    *response = ret;
+static void rinha_fn_ends_free_(void) {
+  fn_ends = NULL;
+}
 
-    free(stacks); stacks = NULL;
+inline static symbol_t *rinha_symbol_(int hash) {
+  return (hash > 0 && hash <= symref) ? &symbols[hash] : NULL;
+}
 
-    return true;
+symbol_t *rinha_symbol_get(int hash) {
+  return symbols ? rinha_symbol_(hash) : NULL;
 }
 
+/**
+ * @brief Check if evaluating the tokens in [start, end) has no side effects.
+ *
+ * Prints, assignments and calls to anything but pure closures are effects. A
+ * callee is only known by its name when the name is stable: a parameter or an
+ * assignment could make it refer to another closure. Creating a closure is
+ * pure, but its body is scanned as well (conservative).
+ *
+ * With `safe`, what may stop the script is an effect as well (code that is
+ * dropped must not hide an error): a division or modulo by anything but a
+ * nonzero literal, first/second, and calls to closures that are not safe (see
+ * ir_is_removable_ for the same rule on the IR).
+ */
+static bool rinha_tokens_pure_(token_t *start, token_t *end, bool safe) {
+  for (token_t *t = start; t < end; ++t) {
+    switch (t->type) {
+      case TOKEN_PRINT:
+      case TOKEN_YASWOC:
+        return false;
+      case TOKEN_ASSIGN:
+        if (t - 2 < start || (t - 2)->type != TOKEN_LET)
+          return false;
+        break;
+      case TOKEN_RPAREN:
+        if (t + 1 < end && (t + 1)->type == TOKEN_LPAREN)
+          return false;
+        break;
+      case TOKEN_IDENTIFIER:
+        if (t + 1 < end && (t + 1)->type == TOKEN_LPAREN) {
+          symbol_t *sym = rinha_symbol_(t->hash);
+          if (!sym || !sym->pure || !sym->stable || (safe && !sym->safe))
+            return false;
+        }
+        break;
+      case TOKEN_DIVIDE:
+      case TOKEN_MOD:
+        if (safe && (t + 1 >= end || (t + 1)->type != TOKEN_NUMBER ||
+            ((t + 1)->value.type == INTEGER && !(t + 1)->value.number)))
+          return false;
+        break;
+      case TOKEN_FIRST:
+      case TOKEN_SECOND:
+        if (safe)
+          return false;
+        break;
+      default:
+        break;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Fold an if condition made only of literals.
+ *
+ * The folded value is stored in the `if` token and jmp_pc3 points to the
+ * first token of the then-branch.
+ */
+static void rinha_fold_if_(token_t *if_token) {
+  token_t *start = if_token + 2;
+  token_t *t = start;
+
+  if ((if_token + 1)->type != TOKEN_LPAREN)
+    return;
+
+  for (int open_paren = 1; open_paren; ++t) {
+    switch (t->type) {
+      case TOKEN_LPAREN:
+        open_paren++;
+        break;
+      case TOKEN_RPAREN:
+        open_paren--;
+        break;
+      case TOKEN_NUMBER:
+      case TOKEN_STRING:
+      case TOKEN_TRUE:
+      case TOKEN_FALSE:
+      case TOKEN_PLUS:
+      case TOKEN_MINUS:
+      case TOKEN_MULTIPLY:
+      case TOKEN_EQ:
+      case TOKEN_NEQ:
+      case TOKEN_LT:
+      case TOKEN_GT:
+      case TOKEN_LTE:
+      case TOKEN_GTE:
+      case TOKEN_AND:
+      case TOKEN_OR:
+        break;
+      default:
+        return;
+    }
+  }
+
+  token_t *ctx = rinha_current_token_ctx;
+  rinha_value_t value = {0};
+
+  rinha_current_token_ctx = start;
+  rinha_exec_logical_or_(&value);
+
+  if (rinha_current_token_ctx == t - 1) {
+    rinha_var_copy(&if_token->value, &value);
+    if_token->jmp_pc3 = t;
+  }
+  rinha_current_token_ctx = ctx;
+}
+
+/**
+ * @brief State of the recurrence compiler.
+ *
+ * @var t           Current token.
+ * @var param       Hash of the closure parameter (n).
+ * @var self        Hash of the closure name.
+ * @var allow_self  Self calls f(n - k) are allowed (recursive case only).
+ * @var order       Largest k seen in f(n - k).
+ */
+typedef struct {
+  token_t *t;
+  int param;
+  int self;
+  bool allow_self;
+  int order;
+  recurrence_inst_t *code;
+  int size;
+} recurrence_ctx_t;
+
+inline static bool rinha_recurrence_emit_(recurrence_ctx_t *ctx,
+    recurrence_op op, RINHA_WORD arg) {
+  if (ctx->size >= RINHA_CONFIG_RECURRENCE_CODE_SIZE)
+    return false;
+
+  ctx->code[ctx->size].op = op;
+  ctx->code[ctx->size++].arg = arg;
+  return true;
+}
+
+static bool rinha_recurrence_expr_(recurrence_ctx_t *ctx);
+
+static bool rinha_recurrence_primary_(recurrence_ctx_t *ctx) {
+  token_t *t = ctx->t;
+
+  switch (t->type) {
+    case TOKEN_NUMBER:
+      if (t->value.type != INTEGER)
+        return false;
+      ctx->t++;
+      return rinha_recurrence_emit_(ctx, RECURRENCE_CONST, t->value.number);
+    case TOKEN_LPAREN:
+      ctx->t++;
+      if (!rinha_recurrence_expr_(ctx) || ctx->t->type != TOKEN_RPAREN)
+        return false;
+      ctx->t++;
+      return true;
+    case TOKEN_IDENTIFIER:
+      if (t->hash == ctx->param) {
+        ctx->t++;
+        return rinha_recurrence_emit_(ctx, RECURRENCE_N, 0);
+      }
+
+      // f(n - k)
+      if (!ctx->allow_self || t->hash != ctx->self ||
+          (t + 1)->type != TOKEN_LPAREN ||
+          (t + 2)->type != TOKEN_IDENTIFIER || (t + 2)->hash != ctx->param ||
+          (t + 3)->type != TOKEN_MINUS || (t + 4)->type != TOKEN_NUMBER ||
+          (t + 4)->value.type != INTEGER || (t + 5)->type != TOKEN_RPAREN)
+        return false;
+
+      RINHA_WORD k = (t + 4)->value.number;
+
+      if (k < 1 || k > RINHA_CONFIG_RECURRENCE_ORDER)
+        return false;
+
+      if (k > ctx->order)
+        ctx->order = k;
+
+      ctx->t += 6;
+      return rinha_recurrence_emit_(ctx, RECURRENCE_PREV, k);
+    default:
+      return false;
+  }
+}
+
+static bool rinha_recurrence_term_(recurrence_ctx_t *ctx) {
+  if (!rinha_recurrence_primary_(ctx))
+    return false;
+
+  while (ctx->t->type == TOKEN_MULTIPLY) {
+    ctx->t++;
+    if (!rinha_recurrence_primary_(ctx) ||
+        !rinha_recurrence_emit_(ctx, RECURRENCE_MUL, 0))
+      return false;
+  }
+  return true;
+}
+
+static bool rinha_recurrence_expr_(recurrence_ctx_t *ctx) {
+  if (!rinha_recurrence_term_(ctx))
+    return false;
+
+  while (ctx->t->type == TOKEN_PLUS || ctx->t->type == TOKEN_MINUS) {
+    recurrence_op op = (ctx->t->type == TOKEN_PLUS)
+        ? RECURRENCE_ADD : RECURRENCE_SUB;
+    ctx->t++;
+    if (!rinha_recurrence_term_(ctx) || !rinha_recurrence_emit_(ctx, op, 0))
+      return false;
+  }
+  return true;
+}
+
+static bool rinha_recurrence_block_(recurrence_ctx_t *ctx) {
+  bool braces = (ctx->t->type == TOKEN_LBRACE);
+
+  if (braces)
+    ctx->t++;
+
+  if (!rinha_recurrence_expr_(ctx))
+    return false;
+
+  if (braces) {
+    if (ctx->t->type == TOKEN_SEMICOLON)
+      ctx->t++;
+    if (ctx->t->type != TOKEN_RBRACE)
+      return false;
+    ctx->t++;
+  }
+  return true;
+}
+
+/**
+ * @brief Recognise `let f = fn (n) => if (n <cmp> c) { base } else { step }`.
+ *
+ * `cmp` is one of <, <= or ==, `base` an integer expression of n and `step` an
+ * integer expression (+, -, *) of n and f(n - k), 1 <= k <= order. With `==`
+ * the order must be 1, otherwise the recursion could jump over the base case.
+ *
+ * @param[in] sym   The symbol bound (once) to the closure.
+ * @param[in] hash  The hash of the symbol.
+ * @return The compiled recurrence, or NULL if the closure does not match.
+ */
+static recurrence_t *rinha_recurrence_compile_(symbol_t *sym, int hash) {
+  token_t *t = sym->let + 3;
+  token_t *end = rinha_token_skip_value(t);
+
+  if ((t + 1)->type != TOKEN_LPAREN || (t + 2)->type != TOKEN_IDENTIFIER ||
+      (t + 3)->type != TOKEN_RPAREN || (t + 4)->type != TOKEN_ARROW)
+    return NULL;
+
+  int param = (t + 2)->hash;
+  t += 5;
+
+  bool braces = (t->type == TOKEN_LBRACE);
+
+  if (braces)
+    t++;
+
+  if (t->type != TOKEN_IF || (t + 1)->type != TOKEN_LPAREN ||
+      (t + 2)->type != TOKEN_IDENTIFIER || (t + 2)->hash != param ||
+      (t + 4)->type != TOKEN_NUMBER || (t + 4)->value.type != INTEGER ||
+      (t + 5)->type != TOKEN_RPAREN)
+    return NULL;
+
+  recurrence_t r = {0};
+  r.cmp = (t + 3)->type;
+  r.limit = (t + 4)->value.number;
+
+  if (r.cmp != TOKEN_LT && r.cmp != TOKEN_LTE && r.cmp != TOKEN_EQ)
+    return NULL;
+
+  recurrence_ctx_t ctx = {0};
+  ctx.t = t + 6;
+  ctx.param = param;
+  ctx.self = hash;
+  ctx.code = r.base;
+
+  if (!rinha_recurrence_block_(&ctx) || ctx.t->type != TOKEN_ELSE)
+    return NULL;
+
+  r.base_size = ctx.size;
+
+  ctx.t++;
+  ctx.code = r.step;
+  ctx.size = 0;
+  ctx.allow_self = true;
+
+  if (!rinha_recurrence_block_(&ctx))
+    return NULL;
+
+  r.step_size = ctx.size;
+  r.order = ctx.order;
+
+  if (braces) {
+    if (ctx.t->type == TOKEN_SEMICOLON)
+      ctx.t++;
+    if (ctx.t->type != TOKEN_RBRACE)
+      return NULL;
+    ctx.t++;
+  }
+
+  if (ctx.t != end || !r.order || (r.cmp == TOKEN_EQ && r.order != 1))
+    return NULL;
+
+  recurrence_t *ret = rinha_arena_alloc_(sizeof(recurrence_t));
+
+  *ret = r;
+  return ret;
+}
+
+inline static int rinha_recurrence_slot_(RINHA_WORD n, int order) {
+  return ((n % order) + order) % order;
+}
+
+/**
+ * @brief Run recurrence code for argument `n`; f(n - k) is read from the window.
+ *
+ * @return `false` if the result does not fit in the word (`out` is left as
+ *         it is, see rinha_recurrence_run_big_).
+ */
+static bool rinha_recurrence_run_(recurrence_inst_t *code, int size,
+    RINHA_WORD n, RINHA_WORD *window, int order, RINHA_WORD *out) {
+  RINHA_WORD stack[RINHA_CONFIG_RECURRENCE_CODE_SIZE];
+  bool overflow = false;
+  int sp = 0;
+
+  for (register int i = 0; i < size; ++i) {
+    switch (code[i].op) {
+      case RECURRENCE_N:
+        stack[sp++] = n;
+        break;
+      case RECURRENCE_CONST:
+        stack[sp++] = code[i].arg;
+        break;
+      case RECURRENCE_PREV:
+        stack[sp++] = window[rinha_recurrence_slot_(n - code[i].arg, order)];
+        break;
+      case RECURRENCE_ADD:
+        --sp;
+        overflow |= __builtin_add_overflow(stack[sp - 1], stack[sp], &stack[sp - 1]);
+        break;
+      case RECURRENCE_SUB:
+        --sp;
+        overflow |= __builtin_sub_overflow(stack[sp - 1], stack[sp], &stack[sp - 1]);
+        break;
+      case RECURRENCE_MUL:
+        --sp;
+        overflow |= __builtin_mul_overflow(stack[sp - 1], stack[sp], &stack[sp - 1]);
+        break;
+    }
+  }
+
+  if (overflow)
+    return false;
+
+  *out = stack[0];
+  return true;
+}
+
+/**
+ * @brief rinha_recurrence_run_ once the values have left the word.
+ */
+static void rinha_recurrence_run_big_(recurrence_inst_t *code, int size,
+    RINHA_WORD n, rinha_value_t *window, int order, rinha_value_t *out) {
+  rinha_value_t stack[RINHA_CONFIG_RECURRENCE_CODE_SIZE];
+  int sp = 0;
+
+  for (register int i = 0; i < size; ++i) {
+    switch (code[i].op) {
+      case RECURRENCE_N:
+        stack[sp++] = rinha_value_number_set_(n);
+        break;
+      case RECURRENCE_CONST:
+        stack[sp++] = rinha_value_number_set_(code[i].arg);
+        break;
+      case RECURRENCE_PREV:
+        stack[sp++] = window[rinha_recurrence_slot_(n - code[i].arg, order)];
+        break;
+      case RECURRENCE_ADD:
+        --sp;
+        rinha_value_arith_(&stack[sp - 1], &stack[sp - 1], &stack[sp], '+');
+        break;
+      case RECURRENCE_SUB:
+        --sp;
+        rinha_value_arith_(&stack[sp - 1], &stack[sp - 1], &stack[sp], '-');
+        break;
+      case RECURRENCE_MUL:
+        --sp;
+        rinha_value_arith_(&stack[sp - 1], &stack[sp - 1], &stack[sp], '*');
+        break;
+    }
+  }
+  *out = stack[0];
+}
+
+/**
+ * @brief Evaluate a call to a recurrence bottom-up, keeping only the last
+ *        `order` values.
+ *
+ * @param[in]  call  The function being called.
+ * @param[in]  args  The evaluated arguments.
+ * @param[out] ret   The result of the call.
+ * @return `false` if the call must run through the interpreter (not a
+ *         recurrence, non-integer argument or base case).
+ */
+bool rinha_recurrence_call_(function_t *call, rinha_value_t *args,
+    rinha_value_t *ret) {
+  symbol_t *sym = symbols ? rinha_symbol_(call->hash) : NULL;
+
+  if (!sym || args[0].type != INTEGER)
+    return false;
+
+  // Compiled on the first call, not at load
+  if (!sym->recurrence_checked) {
+    sym->recurrence_checked = true;
+    if (sym->pure && sym->stable)
+      sym->recurrence = rinha_recurrence_compile_(sym, call->hash);
+  }
+
+  if (!sym->recurrence)
+    return false;
+
+  recurrence_t *r = sym->recurrence;
+  RINHA_WORD n = args[0].number;
+  RINHA_WORD lo;
+
+  switch (r->cmp) {
+    case TOKEN_LT:
+      if (n < r->limit)
+        return false;
+      lo = r->limit - r->order;
+      break;
+    case TOKEN_LTE:
+      if (n <= r->limit)
+        return false;
+      lo = r->limit + 1 - r->order;
+      break;
+    default:
+      if (n <= r->limit)
+        return false;
+      lo = r->limit;
+  }
+
+  RINHA_WORD window[RINHA_CONFIG_RECURRENCE_ORDER] = {0};
+  RINHA_WORD m;
+
+  for (m = lo; m <= n; ++m) {
+    bool base = (r->cmp == TOKEN_LT) ? (m < r->limit)
+        : (r->cmp == TOKEN_LTE) ? (m <= r->limit) : (m == r->limit);
+    RINHA_WORD *slot = &window[rinha_recurrence_slot_(m, r->order)];
+
+    if (!(base
+        ? rinha_recurrence_run_(r->base, r->base_size, m, window, r->order, slot)
+        : rinha_recurrence_run_(r->step, r->step_size, m, window, r->order, slot)))
+      break;
+  }
+
+  if (m > n) {
+    *ret = rinha_value_number_set_(window[rinha_recurrence_slot_(n, r->order)]);
+    return true;
+  }
+
+  // A value left the word: go on with bignums from there
+  rinha_value_t big[RINHA_CONFIG_RECURRENCE_ORDER];
+
+  for (register int i = 0; i < r->order; ++i)
+    big[i] = rinha_value_number_set_(window[i]);
+
+  for (; m <= n; ++m) {
+    bool base = (r->cmp == TOKEN_LT) ? (m < r->limit)
+        : (r->cmp == TOKEN_LTE) ? (m <= r->limit) : (m == r->limit);
+    rinha_value_t *slot = &big[rinha_recurrence_slot_(m, r->order)];
+
+    if (base)
+      rinha_recurrence_run_big_(r->base, r->base_size, m, big, r->order, slot);
+    else
+      rinha_recurrence_run_big_(r->step, r->step_size, m, big, r->order, slot);
+  }
+
+  *ret = big[rinha_recurrence_slot_(n, r->order)];
+  return true;
+}
+
+/**
+ * @brief Check if the closure in [start, end) is closed: every identifier is a
+ *        parameter or a binding of the closure itself, or a closed closure.
+ *
+ * @param[in]  start   First token of the closure (`fn`).
+ * @param[in]  end     First token after the closure.
+ * @param[out] locals  Scratch array of symref + 1 flags.
+ */
+static bool rinha_tokens_closed_(token_t *start, token_t *end, bool *locals) {
+  memset(locals, 0, (symref + 1) * sizeof(bool));
+
+  for (token_t *t = start; t < end; ++t) {
+    if (t->type == TOKEN_IDENTIFIER && (t - 1)->type == TOKEN_LET &&
+        rinha_symbol_(t->hash)) {
+      locals[t->hash] = true;
+    } else if (t->type == TOKEN_FN) {
+      for (token_t *p = t + 2; p < end && p->type != TOKEN_RPAREN; ++p) {
+        if (p->type == TOKEN_IDENTIFIER && rinha_symbol_(p->hash))
+          locals[p->hash] = true;
+      }
+    }
+  }
+
+  for (token_t *t = start; t < end; ++t) {
+    if (t->type != TOKEN_IDENTIFIER)
+      continue;
+
+    symbol_t *sym = rinha_symbol_(t->hash);
+
+    if (!sym || (!sym->closed && !locals[t->hash]))
+      return false;
+  }
+  return true;
+}
+
+#define RINHA_DIGEST_INIT 14695981039346656037ULL
+
+/**
+ * @brief FNV-1a digest of `size` bytes, chained from `hash`.
+ */
+inline static uint64_t rinha_digest_(uint64_t hash, const void *data, size_t size) {
+  const unsigned char *p = data;
+
+  while (size--) {
+    hash ^= *p++;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * @brief Digest of the tokens of a closed closure and of the closures it refers to.
+ *
+ * @param[in]     hash     The symbol bound to the closure.
+ * @param[in,out] visited  Closures already included (symref + 1 flags).
+ */
+static uint64_t rinha_symbol_digest_(int hash, bool *visited) {
+  symbol_t *sym = &symbols[hash];
+  token_t *start = sym->let + 1;
+  token_t *end = rinha_value_end_(sym->let + 3);
+  uint64_t digest = RINHA_DIGEST_INIT;
+
+  visited[hash] = true;
+
+  for (token_t *t = start; t < end; ++t) {
+    digest = rinha_digest_(digest, &t->type, sizeof(t->type));
+    digest = rinha_digest_(digest, t->lexname, strlen(t->lexname) + 1);
+  }
+
+  for (token_t *t = start; t < end; ++t) {
+    symbol_t *ref = rinha_symbol_(t->hash);
+
+    if (t->type == TOKEN_IDENTIFIER && ref && ref->closed && !visited[t->hash]) {
+      uint64_t sub = rinha_symbol_digest_(t->hash, visited);
+      digest = rinha_digest_(digest, &sub, sizeof(sub));
+    }
+  }
+  return digest;
+}
+
+/**
+ * @brief A result of a precomputed call.
+ *
+ * @var key    Digest of the called closure and of the arguments.
+ * @var value  The result (INTEGER, BOOLEAN or a malloc'ed STRING).
+ */
+typedef struct {
+  uint64_t key;
+  rinha_value_t value;
+} precompute_t;
+
+static precompute_t *precomputed = NULL;
+static int precomputed_count = 0;
+static char precompute_path[256];
+
+static void rinha_precompute_add_(uint64_t key, rinha_value_t *value) {
+  static int capacity = 0;
+
+  if (precomputed_count >= capacity) {
+    capacity = capacity ? capacity * 2 : 16;
+    precompute_t *p = realloc(precomputed, capacity * sizeof(precompute_t));
+    if (!p)
+      return;
+    precomputed = p;
+  }
+
+  precomputed[precomputed_count].key = key;
+  precomputed[precomputed_count++].value = *value;
+}
+
+/**
+ * @brief Check if a call, starting at its '(', only has literal arguments.
+ */
+static bool rinha_precompute_literal_args_(token_t *t) {
+  if ((++t)->type == TOKEN_RPAREN)
+    return true;
+
+  for (;; t += 2) {
+    switch (t->type) {
+      case TOKEN_NUMBER:
+      case TOKEN_STRING:
+      case TOKEN_TRUE:
+      case TOKEN_FALSE:
+        break;
+      default:
+        return false;
+    }
+    if ((t + 1)->type == TOKEN_RPAREN)
+      return true;
+    if ((t + 1)->type != TOKEN_COMMA)
+      return false;
+  }
+}
+
+/**
+ * @brief Key of a call in the result cache.
+ *
+ * @return The digest of the closure (with the closures it calls) and of the
+ *         argument values, or 0 if the closure is not closed.
+ */
+static uint64_t rinha_precompute_key_(function_t *call, rinha_value_t *args) {
+  symbol_t *sym = symbols ? rinha_symbol_(call->hash) : NULL;
+
+  if (!sym || !sym->closed)
+    return 0;
+
+  bool *visited = calloc(symref + 1, sizeof(bool));
+
+  if (!visited)
+    return 0;
+
+  uint64_t key = rinha_symbol_digest_(call->hash, visited);
+  free(visited);
+
+  for (register int i = 0; i < call->args.count; ++i) {
+    rinha_value_t *arg = &args[i];
+    key = rinha_digest_(key, &arg->type, sizeof(arg->type));
+
+    switch (arg->type) {
+      case STRING:
+        key = rinha_digest_(key, rinha_value_str_(arg),
+                            rinha_value_length_(arg) + 1);
+        break;
+      case BOOLEAN:
+        key = rinha_digest_(key, &arg->boolean, sizeof(arg->boolean));
+        break;
+      case BIGINT:
+        key = rinha_digest_(key, arg->bignum, sizeof(rinha_bignum_t) +
+                            arg->bignum->size * sizeof(uint32_t));
+        break;
+      default:
+        key = rinha_digest_(key, &arg->number, sizeof(arg->number));
+    }
+  }
+  return key ? key : 1;
+}
+
+static bool rinha_precompute_get_(uint64_t key, rinha_value_t *ret) {
+  for (register int i = 0; i < precomputed_count; ++i) {
+    rinha_value_t *value = &precomputed[i].value;
+
+    if (precomputed[i].key != key)
+      continue;
+
+    *ret = (value->type == STRING)
+        ? rinha_value_string_set_(value->string) : *value;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Keep the result of a call, in memory and in the result cache file.
+ *
+ * Each entry is a line `<key> <type> <value>`; strings are written as
+ * `<length>:<bytes>`.
+ */
+static void rinha_precompute_set_(uint64_t key, rinha_value_t *value) {
+  rinha_value_t v = *value;
+
+  switch (v.type) {
+    case STRING:
+      v.string = strdup(rinha_value_str_(value));
+      v.small = 0;
+      if (!v.string)
+        return;
+      break;
+    case INTEGER:
+    case BOOLEAN:
+      break;
+    default:
+      return;
+  }
+
+  rinha_precompute_add_(key, &v);
+
+  FILE *fp = fopen(precompute_path, "a");
+
+  if (!fp)
+    return;
+
+  fprintf(fp, "%016llx %d ", (unsigned long long) key, v.type);
+
+  if (v.type == STRING) {
+    size_t len = strlen(v.string);
+    fprintf(fp, "%zu:", len);
+    fwrite(v.string, 1, len, fp);
+  } else {
+    fprintf(fp, "%lld", (long long) (v.type == BOOLEAN ? v.boolean : v.number));
+  }
+  fputc('\n', fp);
+  fclose(fp);
+}
+
+static void rinha_precompute_load_(void) {
+  if (options.cache_path) {
+    snprintf(precompute_path, sizeof(precompute_path), "%s", options.cache_path);
+  } else {
+    snprintf(precompute_path, sizeof(precompute_path), "%s%s", source_name,
+        RINHA_CONFIG_PRECOMPUTE_SUFFIX);
+  }
+
+  FILE *fp = fopen(precompute_path, "r");
+
+  if (!fp)
+    return;
+
+  unsigned long long key;
+  int type;
+
+  // The file may have been edited: only the types rinha_precompute_set_ writes
+  // are read back, other lines are skipped like stale entries
+  while (fscanf(fp, "%llx %d", &key, &type) == 2) {
+    rinha_value_t v = {0};
+
+    if (type != STRING && type != INTEGER && type != BOOLEAN) {
+      for (int c = fgetc(fp); c != EOF && c != '\n'; c = fgetc(fp))
+        ;
+      continue;
+    }
+    v.type = type;
+
+    if (type == STRING) {
+      size_t len;
+      if (fscanf(fp, " %zu:", &len) != 1 || !(v.string = malloc(len + 1)))
+        break;
+      if (fread(v.string, 1, len, fp) != len) {
+        free(v.string);
+        break;
+      }
+      v.string[len] = '\0';
+    } else {
+      long long n;
+      if (fscanf(fp, " %lld", &n) != 1)
+        break;
+      if (type == BOOLEAN && n != 0 && n != 1)
+        continue;
+      v.number = n;
+      if (type == BOOLEAN)
+        v.boolean = (n != 0);
+    }
+    rinha_precompute_add_(key, &v);
+  }
+  fclose(fp);
+}
+
+static void rinha_precompute_free_(void) {
+  for (register int i = 0; i < precomputed_count; ++i) {
+    if (precomputed[i].value.type == STRING)
+      free(precomputed[i].value.string);
+  }
+  precomputed_count = 0;
+}
+
+/**
+ * @brief Load-time dead-code elimination.
+ *
+ * - Counts bindings and uses of every symbol;
+ * - Marks closures bound once whose calls have no side effects (fixed point)
+ *   and the ones among them that are closed (see rinha_tokens_closed_). Closure
+ *   bodies are not compiled here: recurrences (rinha_recurrence_compile_) and
+ *   engine code are compiled on the first call;
+ * - Sets a skip target (jmp_pc3) on `let` statements binding an unused symbol
+ *   (or `_`) to a pure value, including closures that are never called. The last
+ *   statement of a block is kept, since it is the block's value;
+ * - Folds if conditions made only of literals.
+ */
+static void rinha_optimize_(void) {
+  symbols = rinha_arena_calloc_(symref + 1, sizeof(symbol_t));
+
+  // Symbols assigned (x = ...) or used as a parameter name
+  bool *shadowed = calloc(symref + 1, sizeof(bool));
+  int depth = 0;
+  token_t *params = NULL;
+
+  if (!shadowed)
+    return;
+
+  for (register int i = 1; i < rinha_tok_count; ++i) {
+    token_t *t = &tokens[i];
+    symbol_t *sym = rinha_symbol_(t->hash);
+
+    switch (t->type) {
+      case TOKEN_LPAREN:
+      case TOKEN_LBRACE:
+        depth++;
+        params = (tokens[i - 1].type == TOKEN_FN) ? t : NULL;
+        continue;
+      case TOKEN_RPAREN:
+      case TOKEN_RBRACE:
+        depth--;
+        params = NULL;
+        continue;
+      case TOKEN_IDENTIFIER:
+        break;
+      default:
+        continue;
+    }
+
+    if (!sym)
+      continue;
+
+    if (tokens[i - 1].type == TOKEN_LET) {
+      sym->let = &tokens[i - 1];
+      sym->lets++;
+      sym->stable = (depth == 0);
+    } else {
+      sym->refs++;
+      if (params || tokens[i + 1].type == TOKEN_ASSIGN)
+        shadowed[t->hash] = true;
+    }
+  }
+
+  for (register int i = 0; i <= symref; ++i) {
+    symbol_t *sym = &symbols[i];
+    sym->pure = (sym->lets == 1 && (sym->let + 2)->type == TOKEN_ASSIGN &&
+        (sym->let + 3)->type == TOKEN_FN);
+    sym->stable = sym->pure && sym->stable && !shadowed[i];
+  }
+  free(shadowed);
+
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (register int i = 0; i <= symref; ++i) {
+      symbol_t *sym = &symbols[i];
+      token_t *start = sym->let + 3;
+
+      if (sym->pure &&
+          !rinha_tokens_pure_(start, rinha_token_skip_value(start), false)) {
+        sym->pure = false;
+        changed = true;
+      }
+    }
+  }
+
+  for (register int i = 0; i <= symref; ++i) {
+    symbols[i].safe = symbols[i].pure;
+  }
+
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (register int i = 0; i <= symref; ++i) {
+      symbol_t *sym = &symbols[i];
+      token_t *start = sym->let + 3;
+
+      if (sym->safe &&
+          !rinha_tokens_pure_(start, rinha_token_skip_value(start), true)) {
+        sym->safe = false;
+        changed = true;
+      }
+    }
+  }
+
+  bool *locals = calloc(symref + 1, sizeof(bool));
+
+  for (register int i = 0; i <= symref; ++i) {
+    symbols[i].closed = symbols[i].pure && locals;
+  }
+
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (register int i = 0; i <= symref; ++i) {
+      symbol_t *sym = &symbols[i];
+      token_t *start = sym->let + 3;
+
+      if (sym->closed &&
+          !rinha_tokens_closed_(start, rinha_token_skip_value(start), locals)) {
+        sym->closed = false;
+        changed = true;
+      }
+    }
+  }
+  free(locals);
+
+  for (register int i = 0; i < rinha_tok_count; ++i) {
+    token_t *t = &tokens[i];
+
+    if (t->type == TOKEN_IF) {
+      rinha_fold_if_(t);
+      continue;
+    }
+
+    if (t->type != TOKEN_LET || (t + 2)->type != TOKEN_ASSIGN)
+      continue;
+
+    symbol_t *sym = rinha_symbol_((t + 1)->hash);
+
+    if ((t + 1)->type != TOKEN_WILDCARD && (!sym || sym->refs))
+      continue;
+
+    token_t *start = t + 3;
+    token_t *end = rinha_value_end_(start);
+    token_t *next = (end->type == TOKEN_SEMICOLON) ? end + 1 : end;
+
+    if (next->type == TOKEN_RBRACE || next->type == TOKEN_RPAREN ||
+        next->type == TOKEN_EOF)
+      continue;
+
+    if (start->type == TOKEN_FN || rinha_tokens_pure_(start, end, true)) {
+      t->jmp_pc3 = end;
+    }
+  }
+}
+
+// Tiered execution (--engine=tiered)
+
+static const char *rinha_engine_names_[] = {
+  "walker", "regvm", "closure", "tiered"
+};
+
+static const char *rinha_function_name_(function_t *call) {
+  symbol_t *sym = rinha_symbol_get(call->hash);
+  return (sym && sym->let) ? (sym->let + 1)->lexname : "<anonymous>";
+}
+
+#if RINHA_CONFIG_TIER_BACKGROUND == true
+
+/**
+ * @brief A closure to compile for a tier.
+ *
+ * @var vm  Closure compilation: the VM code to compile.
+ */
+typedef struct {
+  token_t *fn;
+  int hash;
+  rinha_engine_t tier;
+  vm_code_t *vm;
+} tier_job_t;
+
+static pthread_t tier_thread;
+static pthread_mutex_t tier_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tier_wake = PTHREAD_COND_INITIALIZER;
+static tier_job_t tier_jobs[RINHA_CONFIG_TIER_QUEUE_SIZE];
+static int tier_head = 0;
+static int tier_count = 0;
+static bool tier_started = false;
+static bool tier_stop = false;
+
+/**
+ * @brief Compile a closure and publish the code: the interpreter picks it up
+ *        at its next call.
+ */
+static void rinha_tier_compile_(tier_job_t *job) {
+  if (job->tier == RINHA_ENGINE_REGVM)
+    rinha_vm_publish(job->fn, rinha_vm_compile(job->fn, job->hash));
+  else
+    rinha_cc_publish(job->fn, rinha_cc_compile(job->vm));
+}
+
+static void *rinha_tier_worker_(void *arg) {
+  (void) arg;
+
+  for (;;) {
+    pthread_mutex_lock(&tier_lock);
+
+    while (!tier_count && !tier_stop)
+      pthread_cond_wait(&tier_wake, &tier_lock);
+
+    if (tier_stop) {
+      pthread_mutex_unlock(&tier_lock);
+      return NULL;
+    }
+
+    tier_job_t job = tier_jobs[tier_head];
+    tier_head = (tier_head + 1) % RINHA_CONFIG_TIER_QUEUE_SIZE;
+    tier_count--;
+
+    pthread_mutex_unlock(&tier_lock);
+
+    rinha_tier_compile_(&job);
+  }
+}
+
+/**
+ * @brief Find the end of the `fn` values the IR builder may ask for when
+ *        compiling a closure: the closures nested in its body and, transitively,
+ *        the bodies of the stable closures it calls (inlining candidates).
+ *
+ * @param[in]     fn       The `fn` token.
+ * @param[in,out] visited  Symbols already warmed up.
+ */
+static void rinha_fn_ends_warm_(token_t *fn, bool *visited) {
+  token_t *end = rinha_token_skip_value(fn);
+
+  for (token_t *t = fn + 1; t < end; ++t) {
+    symbol_t *sym = rinha_symbol_get(t->hash);
+
+    if (t->type == TOKEN_FN) {
+      rinha_token_skip_value(t);
+    } else if (t->type == TOKEN_IDENTIFIER && sym && sym->stable &&
+        !visited[t->hash]) {
+      visited[t->hash] = true;
+      rinha_fn_ends_warm_(sym->let + 3, visited);
+    }
+  }
+}
+
+/**
+ * @brief Queue a closure for the background compiler, starting it if needed.
+ *
+ * @return `false` if the queue is full (the closure is queued again at one of
+ *         its next calls).
+ */
+static bool rinha_tier_queue_(function_t *call, rinha_engine_t tier) {
+  bool queued = false;
+
+  if (tier == RINHA_ENGINE_REGVM) {
+    bool *visited = calloc(symref + 1, sizeof(bool));
+
+    if (!visited)
+      return false;
+
+    rinha_fn_ends_warm_(call->fn, visited);
+    free(visited);
+  }
+
+  pthread_mutex_lock(&tier_lock);
+
+  if (!tier_started) {
+    tier_stop = false;
+    tier_started =
+        pthread_create(&tier_thread, NULL, rinha_tier_worker_, NULL) == 0;
+  }
+
+  if (tier_started && tier_count < RINHA_CONFIG_TIER_QUEUE_SIZE) {
+    int tail = (tier_head + tier_count++) % RINHA_CONFIG_TIER_QUEUE_SIZE;
+
+    tier_jobs[tail] = (tier_job_t) { call->fn, call->hash, tier,
+        (tier == RINHA_ENGINE_REGVM) ? NULL : rinha_vm_code(call) };
+
+    if (tier == RINHA_ENGINE_REGVM)
+      rinha_vm_pending(call->fn);
+    else
+      rinha_cc_pending(call->fn);
+
+    pthread_cond_signal(&tier_wake);
+    queued = true;
+  }
+
+  pthread_mutex_unlock(&tier_lock);
+  return queued;
+}
+
+/**
+ * @brief Stop the background compiler; queued closures are dropped.
+ */
+static void rinha_tier_stop_(void) {
+  pthread_mutex_lock(&tier_lock);
+  bool started = tier_started;
+  tier_stop = true;
+  tier_head = tier_count = 0;
+  pthread_cond_signal(&tier_wake);
+  pthread_mutex_unlock(&tier_lock);
+
+  if (started)
+    pthread_join(tier_thread, NULL);
+
+  tier_started = false;
+}
+
+#endif
+
+/**
+ * @brief Whether the code of a tier is ready for a closure. Without it, the
+ *        closure is queued for the background compiler (or compiled right
+ *        away when RINHA_CONFIG_TIER_BACKGROUND is off).
+ */
+static bool rinha_tier_ready_(function_t *call, rinha_engine_t tier) {
+#if RINHA_CONFIG_TIER_BACKGROUND == true
+  vm_code_state state = (tier == RINHA_ENGINE_REGVM)
+      ? rinha_vm_state(call->fn) : rinha_cc_state(call->fn);
+
+  if (state == VM_CODE_NONE)
+    rinha_tier_queue_(call, tier);
+  return state == VM_CODE_READY;
+#else
+  return (tier == RINHA_ENGINE_REGVM) ? rinha_vm_code(call) != NULL
+      : rinha_cc_code(call) != NULL;
+#endif
+}
+
+/**
+ * @brief Count a call and promote the closure when it gets hot: from the
+ *        token walker to the register VM, then to closure compilation.
+ *
+ * Recursive calls are counted as backedges as well: recursion is how rinha
+ * loops. Closures a tier cannot compile stay where they are.
+ *
+ * @return The tier to run the call on.
+ */
+rinha_engine_t rinha_tier_(function_t *call) {
+  call->calls++;
+
+  if (call->depth)
+    call->backedges++;
+
+  unsigned int hotness = call->calls + call->backedges;
+  rinha_engine_t tier = call->tier;
+
+  if (tier == RINHA_ENGINE_WALKER &&
+      hotness >= RINHA_CONFIG_TIER_REGVM_THRESHOLD &&
+      rinha_tier_ready_(call, RINHA_ENGINE_REGVM)) {
+    tier = RINHA_ENGINE_REGVM;
+  } else if (tier == RINHA_ENGINE_REGVM &&
+      hotness >= RINHA_CONFIG_TIER_CLOSURE_THRESHOLD &&
+      rinha_tier_ready_(call, RINHA_ENGINE_CLOSURE)) {
+    tier = RINHA_ENGINE_CLOSURE;
+  }
+
+  if (tier != call->tier) {
+    if (options.profile) {
+      fprintf(stderr, "profile: %s promoted to %s (calls: %u, backedges: %u)\n",
+          rinha_function_name_(call), rinha_engine_names_[tier], call->calls,
+          call->backedges);
+    }
+    call->tier = tier;
+  }
+
+  return tier;
+}
+
+/**
+ * @brief On-stack replacement: count a backedge of a closure looping on the
+ *        register VM (a tail call to itself, see rinha_vm_tail_calls_) and,
+ *        once it is hot enough for closure compilation, continue the running
+ *        frame on compiled code.
+ *
+ * Such a loop never returns to a call boundary where rinha_tier_ could promote
+ * it. At the top of the body the frame holds only the parameters, in the
+ * registers the compiled code expects (it is compiled from the same VM code).
+ *
+ * @param[in]  call  The closure.
+ * @param[in]  r     Its frame, with the arguments of the next iteration.
+ * @param[out] ret   The result, when the loop ran on compiled code.
+ *
+ * @return `true` if the rest of the loop ran on compiled code.
+ */
+bool rinha_tier_osr_(function_t *call, rinha_value_t *r, rinha_value_t *ret) {
+  call->backedges++;
+
+  if (call->tier == RINHA_ENGINE_REGVM &&
+      call->calls + call->backedges >= RINHA_CONFIG_TIER_CLOSURE_THRESHOLD &&
+      rinha_tier_ready_(call, RINHA_ENGINE_CLOSURE)) {
+    if (options.profile) {
+      fprintf(stderr, "profile: %s promoted to closure on stack (calls: %u, "
+          "backedges: %u)\n", rinha_function_name_(call), call->calls,
+          call->backedges);
+    }
+    call->tier = RINHA_ENGINE_CLOSURE;
+  }
+
+  if (call->tier != RINHA_ENGINE_CLOSURE)
+    return false;
+
+  rinha_cc_run(call, rinha_cc_code(call), r, ret);
+  return true;
+}
+
+/**
+ * @brief Run a call made by the register VM or compiled code on the tier of
+ *        the callee. The arguments are the first registers of its frame.
+ */
+void rinha_tier_invoke_(function_t *call, rinha_value_t *args,
+    rinha_value_t *ret, token_t *token) {
+  switch (rinha_tier_(call)) {
+    case RINHA_ENGINE_CLOSURE:
+      call->depth++;
+      rinha_cc_run(call, rinha_cc_code(call), args, ret);
+      call->depth--;
+      return;
+    case RINHA_ENGINE_REGVM:
+      call->depth++;
+      rinha_vm_run(call, rinha_vm_code(call), args, ret);
+      call->depth--;
+      return;
+    default:
+      break;
+  }
+
+  rinha_exec_call_(call, args, ret, token);
+}
+
+/**
+ * @brief Run a call made by the token walker on the tier of the callee.
+ *
+ * @return `false` if the callee is still run by the token walker.
+ */
+static bool rinha_tier_call_(function_t *call, rinha_value_t *args,
+    rinha_value_t *ret) {
+  rinha_engine_t tier = rinha_tier_(call);
+
+  if (tier == RINHA_ENGINE_WALKER)
+    return false;
+
+  call->depth++;
+
+  if (tier == RINHA_ENGINE_CLOSURE)
+    rinha_cc_call(call, args, ret);
+  else
+    rinha_vm_call(call, args, ret);
+
+  call->depth--;
+  return true;
+}
+
+/**
+ * @brief Print the calls, backedges and tier of every closure called (--profile).
+ */
+static void rinha_tier_report_(FILE *out) {
+  for (register int i = 0; i < RINHA_CONFIG_CALLS_SIZE; ++i) {
+    function_t *call = &calls[i];
+
+    if (!call->calls)
+      continue;
+
+    fprintf(out, "profile: %-20s calls: %10u  backedges: %10u  tier: %s\n",
+        rinha_function_name_(call), call->calls, call->backedges,
+        rinha_engine_names_[call->tier]);
+  }
+}
+
+/**
+ * @brief Print the optimized IR of every closure of the script (--dump-ir).
+ */
+static void rinha_dump_ir_(void) {
+  for (register int i = 0; i < rinha_tok_count; ++i) {
+    token_t *t = &tokens[i];
+
+    if (t->type != TOKEN_FN)
+      continue;
+
+    // `let name = fn ...` closures use the hash of the binding
+    int hash = (i >= 3 && tokens[i - 3].type == TOKEN_LET &&
+        tokens[i - 2].type == TOKEN_IDENTIFIER) ? tokens[i - 2].hash : t->hash;
+
+    ir_function_t *fn = rinha_ir_build(t, hash);
+
+    if (!fn)
+      continue;
+
+    rinha_ir_optimize(fn);
+    rinha_ir_dump(fn, stdout);
+
+    if (options.engine != RINHA_ENGINE_WALKER) {
+      vm_code_t *code = rinha_vm_lower(fn);
+      cc_code_t *cc = NULL;
+
+      if (code && options.engine == RINHA_ENGINE_CLOSURE)
+        cc = rinha_cc_compile(code);
+
+      if (cc)
+        rinha_cc_dump(cc, stdout);
+      else if (code)
+        rinha_vm_dump(code, stdout);
+
+      rinha_cc_free(cc);
+      rinha_vm_free(code);
+    }
+    rinha_ir_free(fn);
+  }
+}
+
+static void rinha_symbols_free_(void) {
+  symbols = NULL;
+}
+
+inline static void rinha_gc_mark_value_(rinha_value_t *value) {
+  if (value->type == STRING && !value->small)
+    rinha_gc_mark(value->string);
+  else if (value->type == TUPLE)
+    rinha_gc_mark(value->tuple);
+  else if (value->type == BIGINT)
+    rinha_gc_mark(value->bignum);
+}
+
+/**
+ * @brief The roots of a collection: literals, the walker frames, the closure
+ *        environments and memo caches, and the VM registers in use.
+ */
+static void rinha_gc_roots_(void) {
+  for (register int i = 0; tokens && i < rinha_tok_count; ++i)
+    rinha_gc_mark_value_(&tokens[i].value);
+
+  // Only the slots set by the active calls (see rinha_stack_release_)
+  for (register int i = 0; stacks && i <= rinha_sp && i < RINHA_CONFIG_STACK_SIZE; ++i) {
+    stack_t *ctx = &stacks[i];
+
+    for (register size_t w = 0; w < sizeof(ctx->used) / sizeof(ctx->used[0]); ++w) {
+      for (uint64_t bits = ctx->used[w]; bits; bits &= bits - 1)
+        rinha_gc_mark_value_(&ctx->mem[w * 64 + __builtin_ctzll(bits)].value);
+    }
+  }
+
+  for (register int i = 0; i < RINHA_CONFIG_CALLS_SIZE; ++i) {
+    function_t *call = &calls[i];
+
+    rinha_gc_mark_value_(&call->ret);
+    for (register int j = 0; j < RINHA_CONFIG_SYMBOLS_SIZE; ++j)
+      rinha_gc_mark_value_(&call->env[j]);
+
+    for (register int j = 0; call->cache_size && j < RINHA_CONFIG_CACHE_SIZE; ++j) {
+      cache_t *cache = &call->cache[j];
+
+      if (!cache->cached)
+        continue;
+      rinha_gc_mark_value_(&cache->value);
+      rinha_gc_mark_value_(&cache->input0);
+      rinha_gc_mark_value_(&cache->input1);
+      rinha_gc_mark_value_(&cache->input2);
+    }
+  }
+
+  // Arguments of a call being made are copied past the top
+  if (vm_regs) {
+    int top = vm_top + RINHA_CONFIG_FUNCTION_ARGS_SIZE;
+
+    if (top > RINHA_CONFIG_VM_REGISTERS_SIZE)
+      top = RINHA_CONFIG_VM_REGISTERS_SIZE;
+    for (register int i = 0; i < top; ++i)
+      rinha_gc_mark_value_(&vm_regs[i]);
+  }
+}
+
+static void rinha_gc_trace_(void *object, rinha_gc_kind_t kind) {
+  if (kind == RINHA_GC_BIGNUM)
+    return;
+
+  if (kind == RINHA_GC_TUPLE) {
+    rinha_gc_mark_value_(&((tuple_t *) object)->first);
+    rinha_gc_mark_value_(&((tuple_t *) object)->second);
+    return;
+  }
+
+  rinha_string_t *string = object;
+
+  if (string->left) {
+    rinha_gc_mark(string->left);
+    rinha_gc_mark(string->right);
+  }
+  if (string->flat && string->flat != string->data)
+    rinha_gc_mark(string->flat);
+}
+
+/**
+ * @brief The intern table does not keep strings alive: drop the dead ones.
+ */
+static void rinha_gc_weak_(void) {
+  char **old = interned;
+  size_t capacity = interned_capacity;
+
+  if (!old)
+    return;
+
+  interned = rinha_arena_calloc_(capacity, sizeof(char *));
+  interned_count = 0;
+
+  for (size_t i = 0; i < capacity; ++i) {
+    if (!old[i] || !rinha_gc_marked(old[i]))
+      continue;
+
+    size_t j = RINHA_STRING(old[i])->hash & (capacity - 1);
+
+    while (interned[j])
+      j = (j + 1) & (capacity - 1);
+    interned[j] = old[i];
+    ++interned_count;
+  }
+  rinha_arena_release_(old, capacity * sizeof(char *));
+}
+
+static const rinha_gc_hooks_t rinha_gc_hooks_ = {
+  rinha_gc_roots_, rinha_gc_trace_, rinha_gc_weak_
+};
+
+void rinha_clear_stack(void) {
+
+  tokens = NULL;
+  //memset(tokens, 0, sizeof(tokens));
+  memset(calls, 0, sizeof(calls));
+  memset(tmp, 0, sizeof(tmp));
+}
+
+inline static void rinha_clear_context(void) {
+  rinha_strings_free_();
+  rinha_arena_reset_();
+  stack_ctx       = NULL;
+  rinha_sp        = 0;
+  rinha_pc        = 0;
+  rinha_tok_count = 0;
+  on_tests        = false;
+  symref          = 0;
+}
+
+/**
+ * @brief Tokenize a script and run the load-time optimizer over its tokens.
+ */
+static void rinha_script_load_(char *name, char *script) {
+    strcpy(source_name, name);
+
+    char *code_ptr = source_code = script;
+
+    while (*code_ptr != '\0') {
+      rinha_tokenize_(&code_ptr, &rinha_tok_count);
+    }
+
+    tokens[rinha_tok_count++].type = TOKEN_EOF;
+
+    fn_ends = rinha_arena_calloc_(rinha_tok_count, sizeof(token_t *));
+
+#if RINHA_CONFIG_DCE_ENABLE == true
+    rinha_optimize_();
+#endif
+}
+
+/**
+ * @brief Execute a Rinha script.
+ *
+ * This function executes a Rinha script, parsing and interpreting the provided script code.
+ *
+ * @param name Script name.
+ * @param script The Rinha script code to execute.
+ * @param[out] response The result of script execution.
+ * @param test Set to true if running in test mode, false otherwise.
+ *
+ * @return `true` if the script executed successfully, `false` on failure.
+ */
+bool rinha_script_exec(char *name, char *script, rinha_value_t *response, bool test) {
+
+    stacks = calloc(RINHA_CONFIG_STACK_SIZE, sizeof(stack_t));
+
+    if (stacks == NULL) {
+      fprintf(stderr, "Memory allocation failed (Size:%d Mb)",
+      (( RINHA_CONFIG_STACK_SIZE * sizeof(stack_t) ) / 1024) / 1024 );
+       return false;
+    }
+
+    rinha_clear_context();
+    rinha_gc_start(&rinha_gc_hooks_, __builtin_frame_address(0),
+                   options.gc_threshold ? options.gc_threshold
+                   : RINHA_CONFIG_GC_THRESHOLD);
+
+    on_tests = test;
+    stack_ctx = stacks;
+
+    rinha_script_load_(name, script);
+
+#if RINHA_CONFIG_INLINE_CACHE_ENABLE == true
+    inline_caches = rinha_arena_calloc_(rinha_tok_count, sizeof(inline_cache_t *));
+#endif
+
+    if (options.engine != RINHA_ENGINE_WALKER) {
+      bool vm = rinha_vm_init(tokens, rinha_tok_count, stacks[0].mem,
+          options.engine == RINHA_ENGINE_TIERED);
+
+      if (!vm || (options.engine != RINHA_ENGINE_REGVM &&
+          !rinha_cc_init(rinha_tok_count))) {
+        fprintf(stderr, "Memory allocation failed (register VM)");
+        return false;
+      }
+    }
+
+    if (options.dump_ir) {
+      rinha_dump_ir_();
+    } else {
+      if (options.precompute)
+        rinha_precompute_load_();
+
+      // Initialize current token
+      rinha_current_token_ctx = tokens;
+      rinha_value_t ret = {0};
+
+      rinha_exec_program_(&ret);
+
+      // The response holds a pointer to flat bytes, even for a small string
+      if (ret.type == STRING) {
+        char *bytes = rinha_value_str_(&ret);
+        if (ret.small) {
+          ret.string = rinha_alloc_string_(bytes, ret.small - 1);
+          ret.small = 0;
+        }
+      }
+      *response = ret;
+    }
+
+    if (options.opt_passes)
+      rinha_ir_report(stderr);
+
+    if (options.profile)
+      rinha_tier_report_(stderr);
+
+    if (options.gc_stats)
+      rinha_gc_report(stderr);
+
+    free(stacks); stacks = NULL;
+#if RINHA_CONFIG_TIER_BACKGROUND == true
+    rinha_tier_stop_();
+#endif
+    rinha_fn_ends_free_();
+    rinha_cc_free_all();
+    rinha_vm_free_all();
+    rinha_inline_caches_free_();
+    rinha_symbols_free_();
+    rinha_precompute_free_();
+
+    return true;
+}
+
+/**
+ * @brief Compile a Rinha script into a native executable (see native.h).
+ *
+ * @param name    Script name.
+ * @param script  The Rinha script code to compile.
+ * @param exe     The interpreter, bundled with the script for the fallback.
+ * @param out     The executable to write.
+ *
+ * @return `true` if the executable was written.
+ */
+bool rinha_script_compile(char *name, char *script, const char *exe,
+                          const char *out) {
+
+    rinha_clear_context();
+    rinha_gc_start(&rinha_gc_hooks_, __builtin_frame_address(0),
+                   options.gc_threshold ? options.gc_threshold
+                   : RINHA_CONFIG_GC_THRESHOLD);
+
+    rinha_script_load_(name, script);
+
+    bool compiled = rinha_native_compile(tokens, script, exe, options.engine, out);
+
+    rinha_fn_ends_free_();
+    rinha_symbols_free_();
+
+    return compiled;
+}
@@ -15,6 +15,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 #include <string.h>
@@ -67,14 +68,15 @@ typedef enum {
 } token_type;
 
 
-typedef enum {
+typedef enum __attribute__((packed)) {
     UNDEFINED,
     STRING,
     INTEGER,
     BOOLEAN,
     FLOAT,
     FUNCTION,
-    TUPLE
+    TUPLE,
+    BIGINT
 } value_type;
 
 /**
@@ -87,39 +89,59 @@ typedef enum {
  * @var hash A hash value associated with the value.
  * @var number The numeric value if the type is value_type::NUMBER.
  * @var boolean The boolean value if the type is value_type::BOOLEAN.
- * @var string The string value if the type is value_type::STRING.
+ * @var small Length + 1 of a string held in the value itself, 0 otherwise.
+ * @var small_bytes First bytes of a small string; the rest continue in the word.
+ * @var string The string value if the type is value_type::STRING (and not small).
+ * @var tuple The elements if the type is value_type::TUPLE (see rinha_alloc_tuple_).
+ * @var bignum An integer that does not fit in `number` (see bignum.h).
  */
 #define RINHA_PRIMITIVES \
     value_type type; \
+    uint8_t small; \
+    char small_bytes[6]; \
     union { \
         RINHA_WORD number; \
         bool boolean; \
         char *string; \
         void *function; \
+        struct _tuple *tuple; \
+        struct _bignum *bignum; \
    }
 
 //char string[RINHA_CONFIG_STRING_VALUE_MAX]; \
 
-struct __primitive {
- RINHA_PRIMITIVES;
-};
+/**
+ * @brief A value: its type and one word. Integers, booleans and closures are held
+ *        in the word, short strings in the value itself; longer strings and
+ *        tuples are pointed to, so a value is 16 bytes and copying one is a
+ *        single move.
+ */
+typedef struct _value {
+    RINHA_PRIMITIVES;
+} rinha_value_t;
 
+/**
+ * @brief Strings of up to RINHA_SMALL_STRING_MAX bytes are held in the value
+ *        itself (NUL terminated, from `small_bytes` into the word) and never
+ *        allocated; longer ones are interned and pointed to. A string has only
+ *        one of the two forms, so values of different forms are never equal.
+ */
+#define RINHA_SMALL_STRING_MAX \
+    (sizeof(rinha_value_t) - offsetof(rinha_value_t, small_bytes) - 1)
 
-typedef struct _tuple {
-   struct __primitive first;
-   struct __primitive second;
-} tuple_t;
+#define RINHA_SMALL_BYTES(v) ((char *) (v) + offsetof(rinha_value_t, small_bytes))
 
 /**
- * @brief Represents a tuple containing two rinha_value_t values.
+ * @brief The elements of a tuple. Tuples are immutable: values share them by
+ *        pointer, and an element may be a tuple itself.
  *
  * @var first The first value in the tuple.
  * @var second The second value in the tuple.
  */
-typedef struct _value {
-    RINHA_PRIMITIVES;
-    tuple_t tuple;
-} rinha_value_t;
+typedef struct _tuple {
+   rinha_value_t first;
+   rinha_value_t second;
+} tuple_t;
 
 
 /**
@@ -142,6 +164,8 @@ typedef struct {
  * @var pos The position of the token in the line.
  * @var jmp_pc1 Jump target PC1 if applicable.
  * @var jmp_pc2 Jump target PC2 if applicable.
+ * @var jmp_pc3 Skip target: end of the right operand of a `&&`/`||`, end of a dead `let`
+ *              or the then-branch of an `if` whose condition was folded.
  * @var lexname The lexname (text) of the token.
  * @var value The value associated with the token if applicable.
  */
@@ -152,19 +176,89 @@ typedef struct {
     int pos;
     void *jmp_pc1;
     void *jmp_pc2;
+    void *jmp_pc3;
     char lexname[RINHA_CONFIG_STRING_VALUE_SIZE];
     rinha_value_t value;
 } token_t;
 
+/**
+ * @brief Instructions of a compiled recurrence (postfix, on an integer stack).
+ */
+typedef enum {
+    RECURRENCE_N,      /* push n */
+    RECURRENCE_CONST,  /* push arg */
+    RECURRENCE_PREV,   /* push f(n - arg) */
+    RECURRENCE_ADD,
+    RECURRENCE_SUB,
+    RECURRENCE_MUL
+} recurrence_op;
+
+typedef struct {
+    recurrence_op op;
+    RINHA_WORD arg;
+} recurrence_inst_t;
+
+/**
+ * @brief A closure `fn (n) => if (n <cmp> limit) { base } else { step }` where
+ *        step only depends on n and f(n - 1) ... f(n - order).
+ *
+ * @var cmp        TOKEN_LT, TOKEN_LTE or TOKEN_EQ.
+ * @var limit      Constant of the base case condition.
+ * @var order      Largest k in f(n - k).
+ * @var base       Code of the base case.
+ * @var step       Code of the recursive case.
+ */
+typedef struct {
+    token_type cmp;
+    RINHA_WORD limit;
+    int order;
+    int base_size;
+    int step_size;
+    recurrence_inst_t base[RINHA_CONFIG_RECURRENCE_CODE_SIZE];
+    recurrence_inst_t step[RINHA_CONFIG_RECURRENCE_CODE_SIZE];
+} recurrence_t;
+
+/**
+ * @brief Usage of a symbol (hash) gathered by the load-time optimizer.
+ *
+ * @var let   The `let` token binding the symbol, when it is bound exactly once.
+ * @var lets  Number of `let` bindings of the symbol.
+ * @var refs  Number of occurrences of the symbol other than its bindings.
+ * @var pure  The symbol is bound to a closure whose calls have no side effects.
+ * @var safe  The closure is pure, and its calls do not fail on a division (or
+ *            modulo) by zero or on first/second: unused calls may be dropped.
+ * @var closed  The closure is pure and only refers to its own parameters and
+ *              bindings, and to other closed closures.
+ * @var stable  Bound once, at the top level, to a closure; never assigned nor
+ *              used as a parameter name, so every reference is to that closure.
+ * @var recurrence  Bottom-up form of the closure, if it is a linear recurrence.
+ * @var recurrence_checked  The closure was checked for a recurrence (on its first
+ *                          call).
+ */
+typedef struct {
+    token_t *let;
+    int lets;
+    int refs;
+    bool pure;
+    bool safe;
+    bool closed;
+    bool stable;
+    recurrence_t *recurrence;
+    bool recurrence_checked;
+} symbol_t;
+
 /**
  * @brief Represents a stack of variables.
  *
  * @var mem An array of variables.
  * @var count The number of variables in the stack.
+ * @var used Bitmap of the slots of mem that were set (cleared when the call
+ *           owning the frame returns).
  */
 typedef struct _stack {
     variable_t mem[RINHA_CONFIG_SYMBOLS_SIZE];
     int count;
+    uint64_t used[(RINHA_CONFIG_SYMBOLS_SIZE + 63) / 64];
 } stack_t;
 
 /**
@@ -196,6 +290,24 @@ typedef struct {
     bool cached;
 } cache_t;
 
+/**
+ * @brief Engines running the closure bodies.
+ *
+ * @var RINHA_ENGINE_WALKER  The token walker.
+ * @var RINHA_ENGINE_REGVM   A register VM compiled from the IR; closures it does not
+ *                           support are left to the token walker.
+ * @var RINHA_ENGINE_CLOSURE The register VM code compiled into chains of specialized
+ *                           C handlers (closure compilation).
+ * @var RINHA_ENGINE_TIERED  Closures start on the token walker and are promoted to
+ *                           the register VM, then to closure compilation, when hot.
+ */
+typedef enum {
+    RINHA_ENGINE_WALKER,
+    RINHA_ENGINE_REGVM,
+    RINHA_ENGINE_CLOSURE,
+    RINHA_ENGINE_TIERED
+} rinha_engine_t;
+
 /**
  * @brief Represents a function in the Rinha programming language.
  *
@@ -205,6 +317,12 @@ typedef struct {
  * @var stack The stack associated with the function.
  * @var cache Cached values within the function.
  * @var pc Program counter associated with the function.
+ * @var fn The `fn` token of the closure.
+ * @var version Bumped each time the closure is created (see rinha_inline_cache_).
+ * @var calls Number of calls (counted by the tiered engine).
+ * @var backedges Number of recursive calls (counted by the tiered engine).
+ * @var depth Number of active calls (tiered engine).
+ * @var tier The engine running the closure.
  */
 typedef struct {
     //char name[RINHA_CONFIG_SYMBOL_NAME_SIZE];
@@ -216,12 +334,71 @@ typedef struct {
     bool cache_enabled;
     bool cache_checked;
     token_t *pc;
+    token_t *fn;
+    unsigned int version;
+    unsigned int calls;
+    unsigned int backedges;
+    int depth;
+    rinha_engine_t tier;
     int hash;
     int vars;
     stack_t *parent;
     rinha_value_t env[RINHA_CONFIG_SYMBOLS_SIZE];
 } function_t;
 
+/**
+ * @brief Get the usage of a symbol gathered by the load-time optimizer.
+ *
+ * @param hash The hash value of the symbol.
+ *
+ * @return A pointer to the symbol, or `NULL` if unknown (or the optimizer is disabled).
+ */
+symbol_t *rinha_symbol_get(int hash);
+
+/**
+ * @brief Find the end of the value (expression, closure) starting at a token.
+ *
+ * @param start The first token of the value.
+ *
+ * @return The first token after the value.
+ */
+token_t *rinha_token_skip_value(token_t *start);
+
+/**
+ * @brief Runtime options of the interpreter.
+ *
+ * @var precompute  Evaluate closed pure calls made from the top level with literal
+ *                  arguments once, keeping their results in a cache file.
+ * @var cache_path  The result cache file; when NULL the script name followed by
+ *                  RINHA_CONFIG_PRECOMPUTE_SUFFIX is used.
+ * @var dump_ir     Print the optimized IR of every closure instead of running the script.
+ * @var opt_passes  The IR passes selected with rinha_ir_select_passes; when set, the
+ *                  time spent in each pass is reported on stderr at exit.
+ * @var engine      The engine running the closure bodies.
+ * @var profile     Report the calls and tier of each closure, and the promotions of
+ *                  the tiered engine, on stderr.
+ * @var gc_threshold  Minimum bytes allocated between two collections; 0 uses
+ *                    RINHA_CONFIG_GC_THRESHOLD.
+ * @var gc_stats    Report the collections and their pauses on stderr.
+ */
+typedef struct {
+    bool precompute;
+    const char *cache_path;
+    bool dump_ir;
+    const char *opt_passes;
+    rinha_engine_t engine;
+    bool profile;
+    size_t gc_threshold;
+    bool gc_stats;
+} rinha_options_t;
+
+/**
+ * @brief Set the options used by the next calls to rinha_script_exec.
+ *
+ * @param[in] options  The options (copied).
+ */
+void rinha_set_options(const rinha_options_t *options);
+
 /**
  * @brief Advance the current token.
  *
@@ -324,8 +501,9 @@ void rinha_exec_calc_(rinha_value_t *result);
  *
  * @param[in] f The function to be executed.
  * @param[out] result The rinha_value_t structure to store the function execution result.
+ * @param[in] site The identifier token of the call, or NULL.
  */
-static void rinha_call_function_(function_t *f, rinha_value_t *result);
+static void rinha_call_function_(function_t *f, rinha_value_t *result, token_t *site);
 
 /**
  * @brief Check if a token is a valid identifier.
@@ -371,6 +549,8 @@ void rinha_print_(rinha_value_t *value, bool lf, bool debug);
 
 void rinha_print_debug_(rinha_value_t *value);
 
+void rinha_error(const token_t *token, const char *fmt, ...);
+
 void rinha_yaswoc( rinha_value_t *value );
 
 void rinha_tokenize_(char **code_ptr, int *rinha_tok_count);
@@ -378,6 +558,9 @@ void rinha_tokenize_(char **code_ptr, int *rinha_tok_count);
 bool rinha_script_exec(char *name, char *script, rinha_value_t *response,
                              bool test);
 
+bool rinha_script_compile(char *name, char *script, const char *exe,
+                          const char *out);
+
 void rinha_clear_stack(void);
 
 void rinha_var_copy(rinha_value_t *var1, rinha_value_t *var2);
@@ -385,6 +568,60 @@ void rinha_exec_assign(rinha_value_t *left);
 
 _RINHA_CALL_ rinha_value_t rinha_value_set_(rinha_value_t value);
 
+/**
+ * @brief Depth of the running calls, on every engine.
+ */
+extern int rinha_sp;
+
+function_t *rinha_function_set_(token_t *pc, int hash);
+void rinha_call_parameter_add(function_t *f, int hash);
+
+/**
+ * @brief Run a call made by compiled code on the token walker.
+ *
+ * @param[in]  args   The arguments.
+ * @param[out] ret    The result.
+ * @param[in]  token  The call, for errors.
+ */
+void rinha_exec_call_(function_t *call, rinha_value_t *args, rinha_value_t *ret,
+    token_t *token);
+
+/**
+ * @brief `print(value)` from compiled code: the results of the running calls
+ *        are no longer memoized.
+ */
+void rinha_exec_print_(rinha_value_t *value);
+
+/**
+ * @brief Run a call to a recurrence (symbol_t::recurrence) bottom-up.
+ *
+ * @return `false` if the closure is not one, or the arguments do not fit.
+ */
+bool rinha_recurrence_call_(function_t *call, rinha_value_t *args,
+    rinha_value_t *ret);
+
+/**
+ * @brief Count a call of the tiered engine and promote the closure when it
+ *        gets hot.
+ *
+ * @return The tier to run the call on.
+ */
+rinha_engine_t rinha_tier_(function_t *call);
+
+/**
+ * @brief Run a call made by compiled code on the tier of the callee. The
+ *        arguments are the first registers of its frame.
+ */
+void rinha_tier_invoke_(function_t *call, rinha_value_t *args,
+    rinha_value_t *ret, token_t *token);
+
+/**
+ * @brief On-stack replacement of a closure looping on the register VM.
+ *
+ * @return `true` if the rest of the loop ran on compiled code.
+ */
+bool rinha_tier_osr_(function_t *call, rinha_value_t *r, rinha_value_t *ret);
+
 #define BOOL_NAME(b) ((b) ? "true" : "false")
 #define RINHA_UNUSED_PARAM(x) ((void)(x))
 
@@ -0,0 +1,186 @@
+/**
+ * @file value.h
+ *
+ * @brief Rinha Language Interpreter - value operations of the engines
+ *
+ * The operations on values shared by the token walker (rinha.c), the register
+ * VM (vm.c) and the closure compiler (cc.c). The word fast paths of the
+ * operators are inlined where they are used; the rest (bignums, strings,
+ * tuples) is implemented in rinha.c.
+ */
+
+#ifndef _LA_RINHA_VALUE_H
+#define _LA_RINHA_VALUE_H
+
+#include "rinha.h"
+
+/**
+ * @brief Integers are INTEGER while they fit in the word and BIGINT otherwise
+ *        (see bignum.h); the word is the fast path of every operator.
+ */
+#define RINHA_INTEGERS(a, b) ((a)->type == INTEGER && (b)->type == INTEGER)
+#define RINHA_INTEGRAL(v) ((v)->type == INTEGER || (v)->type == BIGINT)
+
+_RINHA_CALL_ inline static rinha_value_t rinha_value_number_set_(RINHA_WORD value) {
+  rinha_value_t ret = {0};
+  ret.type = INTEGER;
+  ret.number = value;
+
+  return ret;
+}
+
+_RINHA_CALL_ inline static rinha_value_t rinha_value_bool_set_(bool value) {
+  rinha_value_t ret = {0};
+  ret.type = BOOLEAN;
+  ret.boolean = value;
+
+  return ret;
+}
+
+_RINHA_CALL_ inline static void rinha_value_caller_set_(rinha_value_t *value,
+    function_t *func) {
+  value->type = FUNCTION;
+  value->function = func;
+}
+
+/**
+ * @brief The arithmetic off the fast path: a bignum operand or a result that
+ *        left the word. Other operands keep the word semantics of the
+ *        operators (see rinha_exec_calc_ and rinha_exec_term_).
+ */
+void __attribute__((noinline)) rinha_value_bignum_(rinha_value_t *ret,
+    const rinha_value_t *left, const rinha_value_t *right, char op);
+
+/**
+ * @brief rinha_value_bignum_ with an immediate right operand.
+ */
+void __attribute__((noinline)) rinha_value_bignum_k_(rinha_value_t *ret,
+    const rinha_value_t *left, RINHA_WORD k, char op);
+
+/**
+ * @brief `l op r` in the word.
+ *
+ * @return `false` if the result leaves the word, or for a zero divisor (both
+ *         are left to rinha_value_bignum_).
+ */
+__attribute__((always_inline)) inline static bool rinha_word_arith_(
+    RINHA_WORD l, RINHA_WORD r, char op, RINHA_WORD *n) {
+  switch (op) {
+    case '+': return !__builtin_add_overflow(l, r, n);
+    case '-': return !__builtin_sub_overflow(l, r, n);
+    case '*': return !__builtin_mul_overflow(l, r, n);
+    default:
+      // Only MIN / -1 leaves the word
+      if (__builtin_expect(!r || (r == -1 && l == RINHA_WORD_MIN), 0))
+        return false;
+      *n = (op == '/') ? l / r : l % r;
+      return true;
+  }
+}
+
+/**
+ * @brief `left op right`, with `op` one of '+', '-', '*', '/' and '%': in the
+ *        word unless an operand is a bignum or the result overflows. Inlined
+ *        with a constant `op`, only its own case is left.
+ */
+__attribute__((always_inline)) inline static void rinha_value_arith_(
+    rinha_value_t *ret, const rinha_value_t *left, const rinha_value_t *right,
+    char op) {
+  RINHA_WORD n;
+
+  if (__builtin_expect(RINHA_INTEGERS(left, right) &&
+      rinha_word_arith_(left->number, right->number, op, &n), 1)) {
+    ret->type = INTEGER;
+    ret->number = n;
+    return;
+  }
+  rinha_value_bignum_(ret, left, right, op);
+}
+
+/**
+ * @brief rinha_value_arith_ with an immediate right operand, which is only made
+ *        a value off the fast path.
+ */
+__attribute__((always_inline)) inline static void rinha_value_arith_k_(
+    rinha_value_t *ret, const rinha_value_t *left, RINHA_WORD k, char op) {
+  RINHA_WORD n;
+
+  if (__builtin_expect(left->type == INTEGER &&
+      rinha_word_arith_(left->number, k, op, &n), 1)) {
+    ret->type = INTEGER;
+    ret->number = n;
+    return;
+  }
+  rinha_value_bignum_k_(ret, left, k, op);
+}
+
+/**
+ * @brief Order of two values for `<`, `<=`, `>` and `>=` off the word fast
+ *        path: integers by value, anything else by its word.
+ */
+int __attribute__((noinline)) rinha_value_order_(const rinha_value_t *left,
+    const rinha_value_t *right);
+
+/**
+ * @brief rinha_value_order_ with an immediate right operand.
+ */
+int __attribute__((noinline)) rinha_value_order_k_(const rinha_value_t *left,
+    RINHA_WORD k);
+
+#define RINHA_COMPARE(a, b, OP) (RINHA_INTEGERS(a, b) \
+    ? (a)->number OP (b)->number : rinha_value_order_(a, b) OP 0)
+
+#define RINHA_COMPARE_K(a, k, OP) (((a)->type == INTEGER) \
+    ? (a)->number OP (k) : rinha_value_order_k_(a, k) OP 0)
+
+/**
+ * @brief A new tuple of copies of `first` and `second`.
+ */
+rinha_value_t rinha_value_tuple_set_(rinha_value_t *first,
+    rinha_value_t *second);
+
+/**
+ * @brief `left + right` with a string operand, into `left`.
+ */
+void rinha_value_concat_(rinha_value_t *left, rinha_value_t *right);
+
+/**
+ * @brief String equality (both values are strings).
+ */
+bool rinha_string_eq_(rinha_value_t *left, rinha_value_t *right);
+
+/**
+ * @brief `==` and `!=` on values of the same type (or two integers).
+ */
+bool rinha_cmp_eq(rinha_value_t *left, rinha_value_t *right);
+bool rinha_cmp_neq(rinha_value_t *left, rinha_value_t *right);
+
+/**
+ * @brief Calculate a hash value for a combination of two integers.
+ *
+ * This function calculates a hash value for a combination of two integers, 'n' and 'k'.
+ * It uses a simple formula: (n * 31 + k) % RINHA_CONFIG_CACHE_SIZE to generate the hash.
+ * This particular hash function employs the multiplication by a prime number (31) to help
+ * distribute the resulting hash values more evenly.
+ *
+ * @param[in] n The first integer.
+ * @param[in] k The second integer.
+ * @return The calculated hash value, which is within the range of [0, RINHA_CONFIG_CACHE_SIZE-1].
+ */
+inline static int rinha_hash_num(int n, int k) {
+    return (n * 31 + k) % RINHA_CONFIG_CACHE_SIZE;
+}
+
+/**
+ * @brief Hash of a memo key: strings and bignums by content (ropes by node),
+ *        anything else by its word.
+ */
+unsigned int rinha_value_key_(rinha_value_t *v);
+
+/**
+ * @brief Same memo key: integers and flat strings by value, ropes by node (a
+ *        rope equal to a key by content is only a miss).
+ */
+bool rinha_value_same_key_(rinha_value_t *a, rinha_value_t *b);
+
+#endif
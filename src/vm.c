@@ -0,0 +1,899 @@
+/**
+ * @file vm.c
+ *
+ * @brief Rinha Language Interpreter - register VM (--engine=regvm)
+ *
+ * Lowering of the IR to register code, quickening and the interpreter loop.
+ * See vm.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vm.h"
+
+static const char *vm_op_names[] = {
+  "move", "loadk", "loadi", "load.free", "load.global", "add", "sub", "mul",
+  "div", "mod", "addi", "subi", "eq", "neq", "lt", "lte", "gt", "gte", "eqi",
+  "neqi", "lti", "ltei", "gti", "gtei", "bool", "tuple", "first", "second",
+  "closure", "call", "tailcall", "print", "jump", "jf", "return", "add.int", "addi.int",
+  "mul.int", "div.int", "mod.int", "concat", "eq.int", "neq.int", "eq.str",
+  "neq.str", "load.env"
+};
+
+/**
+ * @brief Marks closures the VM cannot run (left to the token walker).
+ */
+static vm_code_t vm_uncompilable;
+
+/**
+ * @brief Marks closures queued for the background compiler (not ready yet).
+ */
+static vm_code_t vm_pending;
+
+/**
+ * @brief Compiled code of each `fn` token, by token index.
+ */
+static vm_code_t **vm_codes = NULL;
+
+/**
+ * @brief Number of tokens of the script (the size of vm_codes).
+ */
+static int vm_count = 0;
+
+rinha_value_t *vm_regs = NULL;
+int vm_top = 0;
+variable_t *vm_globals = NULL;
+token_t *vm_tokens = NULL;
+bool vm_tiered = false;
+
+static void *rinha_vm_grow_(void *ptr, int count, size_t size, token_t *fn) {
+  // Arrays grow in powers of two
+  if (count & (count - 1))
+    return ptr;
+
+  ptr = realloc(ptr, (count ? count * 2 : 1) * size);
+
+  if (!ptr)
+    rinha_error(fn, "Memory allocation failed");
+
+  return ptr;
+}
+
+static int rinha_vm_emit_(vm_code_t *code, vm_op op, int a, int b, int c,
+    RINHA_WORD k, token_t *token) {
+  if (code->size >= code->capacity) {
+    code->capacity = code->capacity ? code->capacity * 2 : 64;
+    code->code = realloc(code->code, code->capacity * sizeof(vm_inst_t));
+
+    if (!code->code)
+      rinha_error(code->fn, "Memory allocation failed");
+  }
+
+  vm_inst_t *inst = &code->code[code->size];
+  inst->op = inst->generic = op;
+  inst->deopts = 0;
+  inst->a = a;
+  inst->b = b;
+  inst->c = c;
+  inst->k = k;
+  inst->token = token;
+  return code->size++;
+}
+
+void rinha_vm_free(vm_code_t *code) {
+  if (!code || code == &vm_uncompilable || code == &vm_pending)
+    return;
+
+  free(code->code);
+  free(code->types);
+  free(code->consts);
+  free(code->closures);
+  free(code->captures);
+  free(code);
+}
+
+inline static vm_op rinha_vm_binary_op_(ir_op op) {
+  switch (op) {
+    case IR_ADD: return VM_ADD;
+    case IR_SUB: return VM_SUB;
+    case IR_MUL: return VM_MUL;
+    case IR_DIV: return VM_DIV;
+    case IR_MOD: return VM_MOD;
+    case IR_EQ:  return VM_EQ;
+    case IR_NEQ: return VM_NEQ;
+    case IR_LT:  return VM_LT;
+    case IR_LTE: return VM_LTE;
+    case IR_GT:  return VM_GT;
+    default:     return VM_GTE;
+  }
+}
+
+/**
+ * @brief The immediate form of a binary operation, if any.
+ */
+inline static int rinha_vm_immediate_op_(ir_op op) {
+  switch (op) {
+    case IR_ADD: return VM_ADDI;
+    case IR_SUB: return VM_SUBI;
+    case IR_EQ:  return VM_EQI;
+    case IR_NEQ: return VM_NEQI;
+    case IR_LT:  return VM_LTI;
+    case IR_LTE: return VM_LTEI;
+    case IR_GT:  return VM_GTI;
+    case IR_GTE: return VM_GTEI;
+    default:     return -1;
+  }
+}
+
+/**
+ * @brief Copies of the phis of `target` for the edge from `block`, emitted
+ *        before the jump ending `block`.
+ */
+static bool rinha_vm_phi_moves_(vm_code_t *code, ir_function_t *ir, int *reg,
+    int block, int target) {
+  ir_block_t *b = &ir->blocks[target];
+  int pred = 0;
+
+  while (pred < b->npreds && b->preds[pred] != block)
+    pred++;
+
+  for (int i = b->first; i >= 0; i = ir->insts[i].next) {
+    ir_inst_t *phi = &ir->insts[i];
+
+    if (phi->op != IR_PHI)
+      continue;
+
+    if (pred >= phi->argc)
+      return false;
+
+    rinha_vm_emit_(code, VM_MOVE, reg[i], reg[IR_OPERAND(ir, phi, pred)], 0, 0,
+        phi->token);
+  }
+  return true;
+}
+
+inline static bool rinha_vm_has_phis_(ir_function_t *ir, int block) {
+  for (int i = ir->blocks[block].first; i >= 0; i = ir->insts[i].next) {
+    if (ir->insts[i].op == IR_PHI)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Turn the calls whose result is returned, directly or through moves and
+ *        jumps, into VM_TAIL_CALL.
+ *
+ * When a tail call reaches the running closure again with all its parameters,
+ * the arguments replace the parameters and the body starts over: recursive
+ * loops such as `loop(n - 1, acc + n)` run without nesting frames (and the
+ * result is not memoized: the frame no longer holds the arguments). Other
+ * callees are called as by VM_CALL, and the instructions that follow run as
+ * usual.
+ */
+static void rinha_vm_tail_calls_(vm_code_t *code) {
+  for (register int i = 0; i < code->size; ++i) {
+    vm_inst_t *inst = &code->code[i];
+    vm_inst_t *next = inst + 1;
+    int value = inst->a;
+
+    if (inst->op != VM_CALL)
+      continue;
+
+    for (int steps = code->size; steps > 0 && next < code->code + code->size;
+        --steps) {
+      if (next->op == VM_RETURN) {
+        if (next->b == value)
+          inst->op = inst->generic = VM_TAIL_CALL;
+        break;
+      } else if (next->op == VM_JUMP) {
+        next = &code->code[next->c];
+      } else if (next->op == VM_MOVE && next->a != value) {
+        value = (next->b == value) ? next->a : value;
+        ++next;
+      } else {
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * @brief One register per SSA value; phis become copies at the end of the
+ *        predecessors.
+ */
+vm_code_t *rinha_vm_lower(ir_function_t *ir) {
+  if (ir->error)
+    return NULL;
+
+  vm_code_t *code = calloc(1, sizeof(vm_code_t));
+  int *reg = malloc(ir->count * sizeof(int));
+  int *block_pc = malloc(ir->blocks_count * sizeof(int));
+  int *next_block = malloc(ir->blocks_count * sizeof(int));
+
+  if (!code || !reg || !block_pc || !next_block)
+    rinha_error(ir->fn, "Memory allocation failed");
+
+  bool ok = true;
+
+  code->fn = ir->fn;
+  code->params = ir->params;
+  code->nregs = ir->params;
+
+  for (register int k = 0; k < ir->blocks_count; ++k) {
+    block_pc[k] = -1;
+    for (int i = ir->blocks[k].first; i >= 0; i = ir->insts[i].next) {
+      switch (ir->insts[i].op) {
+        case IR_PARAM:
+          reg[i] = ir->insts[i].arg;
+          break;
+        case IR_NOP:
+        case IR_JUMP:
+        case IR_BRANCH:
+        case IR_RETURN:
+          reg[i] = -1;
+          break;
+        default:
+          reg[i] = code->nregs++;
+      }
+    }
+  }
+
+  code->window = code->nregs;
+  code->nregs += RINHA_CONFIG_FUNCTION_ARGS_SIZE;
+
+  code->types = calloc(code->nregs, sizeof(value_type));
+
+  if (!code->types)
+    rinha_error(ir->fn, "Memory allocation failed");
+
+  for (register int k = 0; k < ir->blocks_count; ++k) {
+    for (int i = ir->blocks[k].first; i >= 0; i = ir->insts[i].next) {
+      if (reg[i] >= code->params)
+        code->types[reg[i]] = ir->insts[i].type;
+    }
+  }
+
+  // Layout: the non-empty blocks in order
+  for (register int k = ir->blocks_count - 1, next = -1; k >= 0; --k) {
+    next_block[k] = next;
+    if (ir->blocks[k].first >= 0)
+      next = k;
+  }
+
+  for (register int k = 0; k < ir->blocks_count && ok; ++k) {
+    if (ir->blocks[k].first < 0)
+      continue;
+
+    block_pc[k] = code->size;
+
+    for (int i = ir->blocks[k].first; i >= 0 && ok; i = ir->insts[i].next) {
+      ir_inst_t *inst = &ir->insts[i];
+      int a = reg[i];
+      int b = (inst->argc > 0) ? reg[IR_OPERAND(ir, inst, 0)] : 0;
+      int c = (inst->argc > 1) ? reg[IR_OPERAND(ir, inst, 1)] : 0;
+
+      switch (inst->op) {
+        case IR_NOP:
+        case IR_PARAM:
+        case IR_PHI:
+          break;
+        case IR_CONST:
+          if (inst->value.type == INTEGER) {
+            rinha_vm_emit_(code, VM_LOADI, a, 0, 0, inst->value.number,
+                inst->token);
+          } else {
+            code->consts = rinha_vm_grow_(code->consts, code->nconsts,
+                sizeof(rinha_value_t), ir->fn);
+            code->consts[code->nconsts] = inst->value;
+            rinha_vm_emit_(code, VM_LOADK, a, code->nconsts++, 0, 0,
+                inst->token);
+          }
+          break;
+        case IR_LOAD_FREE:
+        case IR_LOAD_GLOBAL:
+          rinha_vm_emit_(code, inst->op == IR_LOAD_FREE ? VM_LOAD_FREE
+              : VM_LOAD_GLOBAL, a, inst->hash, 0, 0, inst->token);
+          break;
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_DIV:
+        case IR_MOD:
+        case IR_EQ:
+        case IR_NEQ:
+        case IR_LT:
+        case IR_LTE:
+        case IR_GT:
+        case IR_GTE: {
+          ir_inst_t *right = &ir->insts[IR_OPERAND(ir, inst, 1)];
+          int immediate = rinha_vm_immediate_op_(inst->op);
+
+          if (immediate >= 0 && right->op == IR_CONST &&
+              right->value.type == INTEGER) {
+            rinha_vm_emit_(code, immediate, a, b, 0, right->value.number,
+                inst->token);
+          } else {
+            rinha_vm_emit_(code, rinha_vm_binary_op_(inst->op), a, b, c, 0,
+                inst->token);
+          }
+        } break;
+        case IR_BOOL:
+          rinha_vm_emit_(code, VM_BOOL, a, b, 0, 0, inst->token);
+          break;
+        case IR_TUPLE:
+          rinha_vm_emit_(code, VM_TUPLE, a, b, c, 0, inst->token);
+          break;
+        case IR_FIRST:
+        case IR_SECOND:
+          rinha_vm_emit_(code, inst->op == IR_FIRST ? VM_FIRST : VM_SECOND,
+              a, b, 0, 0, inst->token);
+          break;
+        case IR_PRINT:
+          rinha_vm_emit_(code, VM_PRINT, a, b, 0, 0, inst->token);
+          break;
+        case IR_CLOSURE: {
+          code->closures = rinha_vm_grow_(code->closures, code->nclosures,
+              sizeof(vm_closure_t), ir->fn);
+          vm_closure_t *closure = &code->closures[code->nclosures];
+          closure->fn = inst->token;
+          closure->hash = inst->hash;
+          closure->first = code->ncaptures;
+          closure->count = inst->argc;
+
+          for (register int j = 0; j < inst->argc; ++j) {
+            code->captures = rinha_vm_grow_(code->captures, code->ncaptures,
+                sizeof(vm_capture_t), ir->fn);
+            code->captures[code->ncaptures].reg = reg[IR_OPERAND(ir, inst, j)];
+            code->captures[code->ncaptures++].hash =
+                IR_CAPTURE_HASH(ir, inst, j);
+          }
+          rinha_vm_emit_(code, VM_CLOSURE, a, code->nclosures++, 0, 0,
+              inst->token);
+        } break;
+        case IR_CALL:
+          for (register int j = 1; j < inst->argc; ++j) {
+            rinha_vm_emit_(code, VM_MOVE, code->window + j - 1,
+                reg[IR_OPERAND(ir, inst, j)], 0, 0, inst->token);
+          }
+          rinha_vm_emit_(code, VM_CALL, a, b, code->window, inst->argc - 1,
+              inst->token);
+          break;
+        case IR_JUMP:
+          ok = rinha_vm_phi_moves_(code, ir, reg, k, inst->target[0]);
+          if (inst->target[0] != next_block[k])
+            rinha_vm_emit_(code, VM_JUMP, 0, 0, inst->target[0], 0, inst->token);
+          break;
+        case IR_BRANCH:
+          ok = !rinha_vm_has_phis_(ir, inst->target[0]) &&
+              !rinha_vm_has_phis_(ir, inst->target[1]);
+          rinha_vm_emit_(code, VM_JUMP_IF_FALSE, 0, b, inst->target[1], 0,
+              inst->token);
+          if (inst->target[0] != next_block[k])
+            rinha_vm_emit_(code, VM_JUMP, 0, 0, inst->target[0], 0, inst->token);
+          break;
+        case IR_RETURN:
+          rinha_vm_emit_(code, VM_RETURN, 0, b, 0, 0, inst->token);
+          break;
+      }
+    }
+  }
+
+  // Jump targets were block numbers
+  for (register int i = 0; i < code->size && ok; ++i) {
+    vm_inst_t *inst = &code->code[i];
+    if (inst->op == VM_JUMP || inst->op == VM_JUMP_IF_FALSE) {
+      inst->c = block_pc[inst->c];
+      ok = inst->c >= 0;
+    }
+  }
+
+  free(reg);
+  free(block_pc);
+  free(next_block);
+
+  if (!ok) {
+    rinha_vm_free(code);
+    return NULL;
+  }
+
+  symbol_t *sym = rinha_symbol_get(ir->hash);
+
+  code->memo = RINHA_CONFIG_CACHE_ENABLE && sym && sym->stable && sym->closed &&
+      code->params > 0 && code->params <= 3;
+
+  rinha_vm_tail_calls_(code);
+
+  return code;
+}
+
+void rinha_vm_dump(vm_code_t *code, FILE *out) {
+  fprintf(out, "regvm: %d registers (arguments from r%d)%s\n", code->nregs,
+      code->window, code->memo ? ", memoized" : "");
+
+  for (register int i = 0; i < code->size; ++i) {
+    vm_inst_t *inst = &code->code[i];
+
+    fprintf(out, "  %4d  %-12s", i, vm_op_names[inst->op]);
+
+    switch (inst->op) {
+      case VM_MOVE:
+      case VM_BOOL:
+      case VM_FIRST:
+      case VM_SECOND:
+      case VM_PRINT:
+        fprintf(out, "r%d, r%d\n", inst->a, inst->b);
+        break;
+      case VM_LOADI:
+        fprintf(out, "r%d, #%ld\n", inst->a, (long) inst->k);
+        break;
+      case VM_LOADK:
+        fprintf(out, "r%d, k%d\n", inst->a, inst->b);
+        break;
+      case VM_LOAD_FREE:
+      case VM_LOAD_GLOBAL:
+      case VM_LOAD_ENV:
+        fprintf(out, "r%d, %s\n", inst->a, inst->token->lexname);
+        break;
+      case VM_ADDI:
+      case VM_ADDI_INT:
+      case VM_SUBI:
+      case VM_EQI:
+      case VM_NEQI:
+      case VM_LTI:
+      case VM_LTEI:
+      case VM_GTI:
+      case VM_GTEI:
+        fprintf(out, "r%d, r%d, #%ld\n", inst->a, inst->b, (long) inst->k);
+        break;
+      case VM_CLOSURE:
+        fprintf(out, "r%d, line %d\n", inst->a, inst->token->line);
+        break;
+      case VM_CALL:
+      case VM_TAIL_CALL:
+        if (inst->k)
+          fprintf(out, "r%d, r%d, r%d..r%d\n", inst->a, inst->b, inst->c,
+              inst->c + (int) inst->k - 1);
+        else
+          fprintf(out, "r%d, r%d\n", inst->a, inst->b);
+        break;
+      case VM_JUMP:
+        fprintf(out, "%d\n", inst->c);
+        break;
+      case VM_JUMP_IF_FALSE:
+        fprintf(out, "r%d, %d\n", inst->b, inst->c);
+        break;
+      case VM_RETURN:
+        fprintf(out, "r%d\n", inst->b);
+        break;
+      default:
+        fprintf(out, "r%d, r%d, r%d\n", inst->a, inst->b, inst->c);
+    }
+  }
+  fprintf(out, "\n");
+}
+
+vm_code_t *rinha_vm_compile(token_t *fn, int hash) {
+  ir_function_t *ir = rinha_ir_build(fn, hash);
+  vm_code_t *code = NULL;
+
+  if (ir) {
+    rinha_ir_optimize(ir);
+    code = rinha_vm_lower(ir);
+    rinha_ir_free(ir);
+  }
+  return code;
+}
+
+vm_code_t *rinha_vm_code(function_t *call) {
+  int index = call->fn - vm_tokens;
+  vm_code_t *code = __atomic_load_n(&vm_codes[index], __ATOMIC_ACQUIRE);
+
+  if (code)
+    return (code == &vm_uncompilable || code == &vm_pending) ? NULL : code;
+
+  code = rinha_vm_compile(call->fn, call->hash);
+
+  vm_codes[index] = code ? code : &vm_uncompilable;
+  return code;
+}
+
+vm_code_state rinha_vm_state(token_t *fn) {
+  vm_code_t *code = __atomic_load_n(&vm_codes[fn - vm_tokens], __ATOMIC_ACQUIRE);
+
+  if (!code)
+    return VM_CODE_NONE;
+  if (code == &vm_pending)
+    return VM_CODE_PENDING;
+  return (code == &vm_uncompilable) ? VM_CODE_FAILED : VM_CODE_READY;
+}
+
+void rinha_vm_pending(token_t *fn) {
+  vm_codes[fn - vm_tokens] = &vm_pending;
+}
+
+void rinha_vm_publish(token_t *fn, vm_code_t *code) {
+  __atomic_store_n(&vm_codes[fn - vm_tokens], code ? code : &vm_uncompilable,
+      __ATOMIC_RELEASE);
+}
+
+function_t *rinha_vm_closure(function_t *definer, vm_code_t *code,
+    vm_closure_t *closure, rinha_value_t *r) {
+  rinha_value_t env[RINHA_CONFIG_SYMBOLS_SIZE];
+
+  memcpy(env, definer->env, sizeof(env));
+
+  for (register int i = 0; i < closure->count; ++i) {
+    vm_capture_t *capture = &code->captures[closure->first + i];
+    env[capture->hash] = r[capture->reg];
+  }
+
+  function_t *call = rinha_function_set_(closure->fn, closure->hash);
+  token_t *t = closure->fn + 2;
+
+  for (; t->type != TOKEN_RPAREN; ++t) {
+    if (t->type == TOKEN_IDENTIFIER)
+      rinha_call_parameter_add(call, t->hash);
+  }
+
+  // Not scanned by rinha_block_jump_: never memoized by the token walker
+  call->cache_enabled = false;
+  call->cache_checked = true;
+  call->pc = t + 2;
+  call->parent = NULL;
+
+  memcpy(call->env, env, sizeof(env));
+  rinha_value_caller_set_(&call->env[closure->hash], call);
+
+  return call;
+}
+
+/**
+ * @brief Rewrite the current instruction into a specialized form and run it
+ *        again, unless it was deoptimized too often.
+ */
+#define VM_QUICKEN(form) \
+  if (pc->deopts < RINHA_CONFIG_VM_DEOPT_LIMIT) { \
+    pc->op = (form); \
+    --pc; \
+    break; \
+  }
+
+/**
+ * @brief Back to the generic form: the operands do not have the expected types.
+ */
+#define VM_DEOPT() { \
+    pc->op = pc->generic; \
+    pc->deopts++; \
+    --pc; \
+    break; \
+  }
+
+static void rinha_vm_invoke_(function_t *call, rinha_value_t *args, int argc,
+    rinha_value_t *ret, token_t *token);
+
+void rinha_vm_run(function_t *call, vm_code_t *code, rinha_value_t *r,
+    rinha_value_t *ret) {
+  int top = vm_top;
+  unsigned int hash = RINHA_CONFIG_CACHE_SIZE;
+
+  if (r + code->nregs > vm_regs + RINHA_CONFIG_VM_REGISTERS_SIZE)
+    rinha_error(code->fn, "Stack overflow!");
+
+  vm_top = (r - vm_regs) + code->nregs;
+  ++rinha_sp;
+
+  if (code->memo && rinha_vm_memo_get_(call, code, r, ret, &hash))
+    goto done;
+
+  for (vm_inst_t *pc = code->code; ; ++pc) {
+    switch (pc->op) {
+      case VM_MOVE:
+        r[pc->a] = r[pc->b];
+        break;
+      case VM_LOADK:
+        r[pc->a] = code->consts[pc->b];
+        break;
+      case VM_LOADI:
+        r[pc->a].type = INTEGER;
+        r[pc->a].number = pc->k;
+        break;
+      case VM_LOAD_FREE:
+        if (call->env[pc->b].type != UNDEFINED)
+          VM_QUICKEN(VM_LOAD_ENV);
+        // fallthrough
+      case VM_LOAD_GLOBAL: {
+        rinha_value_t *v = &call->env[pc->b];
+
+        if (pc->op == VM_LOAD_GLOBAL || v->type == UNDEFINED)
+          v = &vm_globals[pc->b].value;
+
+        if (v->type == UNDEFINED)
+          rinha_error(pc->token, "Undefined symbol (Hash: %d) ", pc->b);
+
+        r[pc->a] = *v;
+      } break;
+      case VM_LOAD_ENV:
+        if (call->env[pc->b].type == UNDEFINED)
+          VM_DEOPT();
+        r[pc->a] = call->env[pc->b];
+        break;
+      // Integer results that leave the word become bignums in place; the
+      // quickened forms only deopt on other types
+      case VM_ADD:
+        if (RINHA_INTEGRAL(&r[pc->b]) && RINHA_INTEGRAL(&r[pc->c])) {
+          if (RINHA_INTEGERS(&r[pc->b], &r[pc->c]))
+            VM_QUICKEN(VM_ADD_INT);
+          rinha_value_arith_(&r[pc->a], &r[pc->b], &r[pc->c], '+');
+        } else {
+          VM_QUICKEN(VM_CONCAT);
+          rinha_vm_concat_(&r[pc->a], &r[pc->b], &r[pc->c]);
+        }
+        break;
+      case VM_ADD_INT:
+        if (r[pc->b].type != INTEGER || r[pc->c].type != INTEGER)
+          VM_DEOPT();
+        rinha_value_arith_(&r[pc->a], &r[pc->b], &r[pc->c], '+');
+        break;
+      case VM_CONCAT:
+        if (RINHA_INTEGRAL(&r[pc->b]) && RINHA_INTEGRAL(&r[pc->c]))
+          VM_DEOPT();
+        rinha_vm_concat_(&r[pc->a], &r[pc->b], &r[pc->c]);
+        break;
+      case VM_ADDI:
+        if (r[pc->b].type == INTEGER)
+          VM_QUICKEN(VM_ADDI_INT);
+        if (RINHA_INTEGRAL(&r[pc->b])) {
+          rinha_value_arith_k_(&r[pc->a], &r[pc->b], pc->k, '+');
+        } else {
+          rinha_value_t right = rinha_value_number_set_(pc->k);
+          rinha_vm_concat_(&r[pc->a], &r[pc->b], &right);
+        }
+        break;
+      case VM_ADDI_INT:
+        if (r[pc->b].type != INTEGER)
+          VM_DEOPT();
+        rinha_value_arith_k_(&r[pc->a], &r[pc->b], pc->k, '+');
+        break;
+      // The result of `-` is an integer whatever the operands
+      case VM_SUB:
+        rinha_value_arith_(&r[pc->a], &r[pc->b], &r[pc->c], '-');
+        break;
+      case VM_SUBI:
+        rinha_value_arith_k_(&r[pc->a], &r[pc->b], pc->k, '-');
+        break;
+      // `*`, `/` and `%` keep the type of the left operand
+      case VM_MUL:
+        if (r[pc->b].type == INTEGER)
+          VM_QUICKEN(VM_MUL_INT);
+        rinha_value_arith_(&r[pc->a], &r[pc->b], &r[pc->c], '*');
+        break;
+      case VM_DIV:
+        if (r[pc->b].type == INTEGER)
+          VM_QUICKEN(VM_DIV_INT);
+        rinha_value_arith_(&r[pc->a], &r[pc->b], &r[pc->c], '/');
+        break;
+      case VM_MOD:
+        if (r[pc->b].type == INTEGER)
+          VM_QUICKEN(VM_MOD_INT);
+        rinha_value_arith_(&r[pc->a], &r[pc->b], &r[pc->c], '%');
+        break;
+      case VM_MUL_INT:
+        if (r[pc->b].type != INTEGER)
+          VM_DEOPT();
+        rinha_value_arith_(&r[pc->a], &r[pc->b], &r[pc->c], '*');
+        break;
+      case VM_DIV_INT:
+        if (r[pc->b].type != INTEGER)
+          VM_DEOPT();
+        rinha_value_arith_(&r[pc->a], &r[pc->b], &r[pc->c], '/');
+        break;
+      case VM_MOD_INT:
+        if (r[pc->b].type != INTEGER)
+          VM_DEOPT();
+        rinha_value_arith_(&r[pc->a], &r[pc->b], &r[pc->c], '%');
+        break;
+      case VM_EQ_INT:
+      case VM_NEQ_INT:
+        if (r[pc->b].type != INTEGER || r[pc->c].type != INTEGER)
+          VM_DEOPT();
+        r[pc->a] = rinha_value_bool_set_((r[pc->b].number == r[pc->c].number)
+            == (pc->op == VM_EQ_INT));
+        break;
+      case VM_EQ_STR:
+      case VM_NEQ_STR:
+        if (r[pc->b].type != STRING || r[pc->c].type != STRING)
+          VM_DEOPT();
+        r[pc->a] = rinha_value_bool_set_(
+            rinha_string_eq_(&r[pc->b], &r[pc->c]) == (pc->op == VM_EQ_STR));
+        break;
+      case VM_EQ:
+      case VM_NEQ: {
+        if (r[pc->b].type == r[pc->c].type) {
+          if (r[pc->b].type == INTEGER)
+            VM_QUICKEN(pc->op == VM_EQ ? VM_EQ_INT : VM_NEQ_INT);
+          if (r[pc->b].type == STRING)
+            VM_QUICKEN(pc->op == VM_EQ ? VM_EQ_STR : VM_NEQ_STR);
+        }
+        rinha_vm_cmp_types_(&r[pc->b], &r[pc->c], pc->token);
+        bool eq = (pc->op == VM_EQ) ? rinha_cmp_eq(&r[pc->b], &r[pc->c])
+            : rinha_cmp_neq(&r[pc->b], &r[pc->c]);
+        r[pc->a] = rinha_value_bool_set_(eq);
+      } break;
+      // A bignum is never equal to an immediate (a word)
+      case VM_EQI:
+      case VM_NEQI:
+        if (!RINHA_INTEGRAL(&r[pc->b]))
+          rinha_error(pc->token, "Comparison of different types");
+        r[pc->a] = rinha_value_bool_set_((r[pc->b].type == INTEGER &&
+            r[pc->b].number == pc->k) == (pc->op == VM_EQI));
+        break;
+      case VM_LT:
+        r[pc->a] = rinha_value_bool_set_(RINHA_COMPARE(&r[pc->b], &r[pc->c], <));
+        break;
+      case VM_LTE:
+        r[pc->a] = rinha_value_bool_set_(RINHA_COMPARE(&r[pc->b], &r[pc->c], <=));
+        break;
+      case VM_GT:
+        r[pc->a] = rinha_value_bool_set_(RINHA_COMPARE(&r[pc->b], &r[pc->c], >));
+        break;
+      case VM_GTE:
+        r[pc->a] = rinha_value_bool_set_(RINHA_COMPARE(&r[pc->b], &r[pc->c], >=));
+        break;
+      case VM_LTI:
+        r[pc->a] = rinha_value_bool_set_(RINHA_COMPARE_K(&r[pc->b], pc->k, <));
+        break;
+      case VM_LTEI:
+        r[pc->a] = rinha_value_bool_set_(RINHA_COMPARE_K(&r[pc->b], pc->k, <=));
+        break;
+      case VM_GTI:
+        r[pc->a] = rinha_value_bool_set_(RINHA_COMPARE_K(&r[pc->b], pc->k, >));
+        break;
+      case VM_GTEI:
+        r[pc->a] = rinha_value_bool_set_(RINHA_COMPARE_K(&r[pc->b], pc->k, >=));
+        break;
+      case VM_BOOL:
+        r[pc->a] = rinha_value_bool_set_(r[pc->b].boolean);
+        break;
+      case VM_TUPLE:
+        r[pc->a] = rinha_value_tuple_set_(&r[pc->b], &r[pc->c]);
+        break;
+      case VM_FIRST:
+      case VM_SECOND: {
+        if (r[pc->b].type != TUPLE) {
+          rinha_error(pc->token, (pc->op == VM_FIRST)
+              ? "first: Invalid argument, expected a tuple "
+              : "second: Invalid argument, expected a tuple ");
+        }
+        r[pc->a] = (pc->op == VM_FIRST) ? r[pc->b].tuple->first
+            : r[pc->b].tuple->second;
+      } break;
+      case VM_CLOSURE:
+        rinha_value_caller_set_(&r[pc->a], rinha_vm_closure(call, code,
+            &code->closures[pc->b], r));
+        break;
+      case VM_TAIL_CALL:
+        if (r[pc->b].type == FUNCTION && pc->k == code->params &&
+            (function_t *) r[pc->b].function == call) {
+          memcpy(r, &r[pc->c], code->params * sizeof(rinha_value_t));
+          hash = RINHA_CONFIG_CACHE_SIZE;
+          pc = code->code - 1;
+
+          if (vm_tiered && rinha_tier_osr_(call, r, ret))
+            goto done;
+          break;
+        }
+        // fallthrough
+      case VM_CALL:
+        if (r[pc->b].type != FUNCTION)
+          rinha_error(pc->token, "Not a function");
+        rinha_vm_invoke_((function_t *) r[pc->b].function, &r[pc->c], pc->k,
+            &r[pc->a], pc->token);
+        break;
+      case VM_PRINT:
+        rinha_exec_print_(&r[pc->b]);
+        r[pc->a] = r[pc->b];
+        break;
+      case VM_JUMP:
+        pc = &code->code[pc->c] - 1;
+        break;
+      case VM_JUMP_IF_FALSE:
+        if (!r[pc->b].boolean)
+          pc = &code->code[pc->c] - 1;
+        break;
+      case VM_RETURN:
+        *ret = r[pc->b];
+        if (hash < RINHA_CONFIG_CACHE_SIZE)
+          rinha_vm_memo_set_(call, code, r, ret, hash);
+        goto done;
+    }
+  }
+
+done:
+  --rinha_sp;
+  vm_top = top;
+}
+
+/**
+ * @brief Call a closure from the VM: bottom-up recurrence, VM code or the token
+ *        walker.
+ *
+ * @param[in]  args   The arguments (RINHA_CONFIG_FUNCTION_ARGS_SIZE values).
+ * @param[in]  argc   Number of arguments passed.
+ * @param[in]  token  The call, for errors.
+ */
+static void rinha_vm_invoke_(function_t *call, rinha_value_t *args, int argc,
+    rinha_value_t *ret, token_t *token) {
+  int params = call->args.count < RINHA_CONFIG_FUNCTION_ARGS_SIZE
+      ? call->args.count : RINHA_CONFIG_FUNCTION_ARGS_SIZE;
+
+  for (register int i = argc; i < params; ++i)
+    args[i].type = UNDEFINED;
+
+  if (rinha_sp + 1 >= RINHA_CONFIG_STACK_SIZE)
+    rinha_error(token, "Stack overflow!");
+
+#if RINHA_CONFIG_RECURRENCE_ENABLE == true
+  if (rinha_recurrence_call_(call, args, ret))
+    return;
+#endif
+
+  if (vm_tiered) {
+    rinha_tier_invoke_(call, args, ret, token);
+    return;
+  }
+
+  vm_code_t *code = rinha_vm_code(call);
+
+  if (code) {
+    rinha_vm_run(call, code, args, ret);
+    return;
+  }
+
+  rinha_exec_call_(call, args, ret, token);
+}
+
+bool rinha_vm_call(function_t *call, rinha_value_t *args, rinha_value_t *ret) {
+  vm_code_t *code = rinha_vm_code(call);
+
+  if (!code)
+    return false;
+
+  rinha_value_t *frame = &vm_regs[vm_top];
+
+  if (vm_top + code->nregs > RINHA_CONFIG_VM_REGISTERS_SIZE)
+    rinha_error(call->fn, "Stack overflow!");
+
+  memcpy(frame, args, code->params * sizeof(rinha_value_t));
+  rinha_vm_run(call, code, frame, ret);
+  return true;
+}
+
+bool rinha_vm_init(token_t *tokens, int count, variable_t *globals,
+    bool tiered) {
+  vm_codes = calloc(count, sizeof(vm_code_t *));
+  vm_regs = calloc(RINHA_CONFIG_VM_REGISTERS_SIZE, sizeof(rinha_value_t));
+  vm_count = count;
+  vm_tokens = tokens;
+  vm_globals = globals;
+  vm_tiered = tiered;
+
+  return vm_codes && vm_regs;
+}
+
+void rinha_vm_free_all(void) {
+  if (vm_codes) {
+    for (register int i = 0; i < vm_count; ++i)
+      rinha_vm_free(vm_codes[i]);
+    free(vm_codes);
+    vm_codes = NULL;
+  }
+
+  free(vm_regs);
+  vm_regs = NULL;
+  vm_top = 0;
+  vm_count = 0;
+}
+
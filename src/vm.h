@@ -0,0 +1,333 @@
+/**
+ * @file vm.h
+ *
+ * @brief Rinha Language Interpreter - register VM (--engine=regvm)
+ *
+ * Closure bodies are lowered from their optimized IR (see ir.h) into
+ * three-address code over a frame of registers, one per SSA value. The
+ * generic instructions quicken into type-specialized forms as they run, and
+ * go back to the generic form when the operands change type.
+ *
+ * Frames live in a stack of registers shared with the closure compiler (see
+ * cc.h), which runs the same frames; the arguments of a call are the first
+ * registers of the frame of the callee. Calls to closures the VM cannot run go
+ * back to the token walker.
+ */
+
+#ifndef _LA_RINHA_VM_H
+#define _LA_RINHA_VM_H
+
+#include <stdio.h>
+
+#include "rinha.h"
+#include "ir.h"
+#include "value.h"
+
+/**
+ * @brief Register VM opcodes: `a` is the destination register, `b` and `c` the
+ *        source registers, `k` an immediate.
+ */
+typedef enum {
+  VM_MOVE,          /* ra = rb */
+  VM_LOADK,         /* ra = consts[b] */
+  VM_LOADI,         /* ra = #k */
+  VM_LOAD_FREE,     /* ra = closure environment or global b (hash) */
+  VM_LOAD_GLOBAL,   /* ra = global b (hash) */
+  VM_ADD,           /* ra = rb + rc */
+  VM_SUB,
+  VM_MUL,
+  VM_DIV,
+  VM_MOD,
+  VM_ADDI,          /* ra = rb + #k */
+  VM_SUBI,
+  VM_EQ,            /* ra = rb == rc */
+  VM_NEQ,
+  VM_LT,
+  VM_LTE,
+  VM_GT,
+  VM_GTE,
+  VM_EQI,           /* ra = rb == #k */
+  VM_NEQI,
+  VM_LTI,
+  VM_LTEI,
+  VM_GTI,
+  VM_GTEI,
+  VM_BOOL,          /* ra = rb as a boolean */
+  VM_TUPLE,         /* ra = (rb, rc) */
+  VM_FIRST,
+  VM_SECOND,
+  VM_CLOSURE,       /* ra = closures[b] */
+  VM_CALL,          /* ra = rb(rc .. rc + k - 1) */
+  VM_TAIL_CALL,     /* VM_CALL whose result is returned, see rinha_vm_tail_calls_ */
+  VM_PRINT,         /* print(rb), ra = rb */
+  VM_JUMP,          /* pc = c */
+  VM_JUMP_IF_FALSE, /* if !rb: pc = c */
+  VM_RETURN,        /* return rb */
+
+  // Quickened forms, see rinha_vm_run_
+  VM_ADD_INT,
+  VM_ADDI_INT,
+  VM_MUL_INT,
+  VM_DIV_INT,
+  VM_MOD_INT,
+  VM_CONCAT,
+  VM_EQ_INT,
+  VM_NEQ_INT,
+  VM_EQ_STR,
+  VM_NEQ_STR,
+  VM_LOAD_ENV
+} vm_op;
+
+
+/**
+ * @brief A VM instruction.
+ *
+ * @var op       The operation, possibly quickened.
+ * @var generic  The operation as emitted.
+ * @var deopts   Times the quickened form saw other operand types.
+ */
+typedef struct {
+  vm_op op;
+  vm_op generic;
+  int deopts;
+  int a;
+  int b;
+  int c;
+  RINHA_WORD k;
+  token_t *token;
+} vm_inst_t;
+
+/**
+ * @brief A closure created by VM_CLOSURE.
+ *
+ * @var fn     The `fn` token.
+ * @var hash   The closure hash.
+ * @var first  First entry in vm_code_t::captures.
+ * @var count  Number of captured registers.
+ */
+typedef struct {
+  token_t *fn;
+  int hash;
+  int first;
+  int count;
+} vm_closure_t;
+
+typedef struct {
+  int reg;
+  int hash;
+} vm_capture_t;
+
+/**
+ * @brief A closure body compiled for the register VM.
+ *
+ * Parameters are in the first registers of the frame; the last
+ * RINHA_CONFIG_FUNCTION_ARGS_SIZE registers (from `window`) hold the arguments of
+ * the calls, and are the first registers of the frame of a called closure.
+ *
+ * @var nregs  Size of the frame.
+ * @var memo   Results are memoized (closed closures of integer arguments).
+ * @var types  Type of each register found by the typespec pass (UNDEFINED:
+ *             unknown).
+ */
+typedef struct {
+  token_t *fn;
+  int params;
+  int nregs;
+  value_type *types;
+  int window;
+  bool memo;
+  vm_inst_t *code;
+  int size;
+  int capacity;
+  rinha_value_t *consts;
+  int nconsts;
+  vm_closure_t *closures;
+  int nclosures;
+  vm_capture_t *captures;
+  int ncaptures;
+} vm_code_t;
+
+
+/**
+ * @brief Where the code of a closure stands for a tier (see rinha_vm_state).
+ */
+typedef enum {
+  VM_CODE_NONE,     /* not compiled, nor queued */
+  VM_CODE_PENDING,  /* queued for the background compiler */
+  VM_CODE_FAILED,   /* cannot be compiled: left to the token walker */
+  VM_CODE_READY
+} vm_code_state;
+
+/**
+ * @brief State of the VM shared with the closure compiler.
+ *
+ * @var vm_regs     The register stack: the running frames are below vm_top.
+ * @var vm_top      First free register.
+ * @var vm_globals  The global scope, for the loads of globals.
+ * @var vm_tokens   The tokens of the script; code is kept by `fn` token index.
+ * @var vm_tiered   Calls go through the tier manager (--engine=tiered).
+ */
+extern rinha_value_t *vm_regs;
+extern int vm_top;
+extern variable_t *vm_globals;
+extern token_t *vm_tokens;
+extern bool vm_tiered;
+
+inline static void rinha_vm_cmp_types_(rinha_value_t *left, rinha_value_t *right,
+    token_t *token) {
+  if (left->type != right->type &&
+      (!RINHA_INTEGRAL(left) || !RINHA_INTEGRAL(right)))
+    rinha_error(token, "Comparison of different types");
+}
+
+inline static void rinha_vm_concat_(rinha_value_t *dst, rinha_value_t *left,
+    rinha_value_t *right) {
+  rinha_value_t value = *left;
+
+  rinha_value_concat_(&value, right);
+  *dst = value;
+}
+
+inline static unsigned int rinha_vm_memo_hash_(rinha_value_t *args, int count) {
+  unsigned int hash = 0;
+
+  for (register int i = 0; i < count; i++) {
+    hash ^= rinha_value_key_(&args[i]);
+    hash = rinha_hash_num(hash, i);
+  }
+  return hash % RINHA_CONFIG_CACHE_SIZE;
+}
+
+/**
+ * @brief The memoized result of a call to code with `memo` set.
+ *
+ * @param[out] hash  The memo entry of the arguments, for rinha_vm_memo_set_
+ *                   (left alone when they cannot be a key).
+ */
+inline static bool rinha_vm_memo_get_(function_t *call, vm_code_t *code,
+    rinha_value_t *args, rinha_value_t *ret, unsigned int *hash) {
+  for (register int i = 0; i < code->params; ++i) {
+    if (args[i].type != STRING && !RINHA_INTEGRAL(&args[i]))
+      return false;
+  }
+
+  *hash = rinha_vm_memo_hash_(args, code->params);
+
+  cache_t *cache = &call->cache[*hash];
+
+  if (!cache->cached || !rinha_value_same_key_(&cache->input0, &args[0]) ||
+      (code->params > 1 && !rinha_value_same_key_(&cache->input1, &args[1])) ||
+      (code->params > 2 && !rinha_value_same_key_(&cache->input2, &args[2]))) {
+    return false;
+  }
+
+  *ret = cache->value;
+  return true;
+}
+
+inline static void rinha_vm_memo_set_(function_t *call, vm_code_t *code,
+    rinha_value_t *args, rinha_value_t *value, unsigned int hash) {
+  cache_t *cache = &call->cache[hash];
+
+  if (cache->cached || (!RINHA_INTEGRAL(value) && value->type != BOOLEAN) ||
+      ++call->cache_size >= RINHA_CONFIG_CACHE_SIZE) {
+    return;
+  }
+
+  cache->input0 = args[0];
+  cache->input1 = (code->params > 1) ? args[1] : (rinha_value_t) {0};
+  cache->input2 = (code->params > 2) ? args[2] : (rinha_value_t) {0};
+  cache->value = *value;
+  cache->cached = true;
+}
+
+/**
+ * @brief Set up the VM for a script.
+ *
+ * @param tokens   The tokens of the script.
+ * @param count    Number of tokens.
+ * @param globals  The global scope.
+ * @param tiered   Calls go through the tier manager.
+ *
+ * @return `false` when out of memory.
+ */
+bool rinha_vm_init(token_t *tokens, int count, variable_t *globals,
+    bool tiered);
+
+/**
+ * @brief Free the code of the script and the registers.
+ */
+void rinha_vm_free_all(void);
+
+/**
+ * @brief Translate the IR of a closure body into register VM code.
+ *
+ * @return The code, or NULL if the IR has constructs the VM does not support.
+ */
+vm_code_t *rinha_vm_lower(ir_function_t *ir);
+
+/**
+ * @brief Build, optimize and lower the IR of a closure body.
+ *
+ * Only reads the tokens and the symbols: it also runs on the background
+ * compiler thread.
+ */
+vm_code_t *rinha_vm_compile(token_t *fn, int hash);
+
+/**
+ * @brief The VM code of a closure, compiled on its first call.
+ *
+ * @return The code, or NULL if the closure is left to the token walker (or
+ *         still being compiled in the background).
+ */
+vm_code_t *rinha_vm_code(function_t *call);
+
+/**
+ * @brief Where the code of the closure of `fn` stands, without compiling it.
+ */
+vm_code_state rinha_vm_state(token_t *fn);
+
+/**
+ * @brief Mark the closure of `fn` as queued for the background compiler.
+ */
+void rinha_vm_pending(token_t *fn);
+
+/**
+ * @brief Publish the code compiled in the background for the closure of `fn`
+ *        (NULL: it cannot be compiled); it is picked up at its next call.
+ */
+void rinha_vm_publish(token_t *fn, vm_code_t *code);
+
+/**
+ * @brief Run VM code.
+ *
+ * @param[in]  call  The closure.
+ * @param[in]  code  Its code.
+ * @param[in]  r     The frame, with the arguments in the first registers.
+ * @param[out] ret   The result.
+ */
+void rinha_vm_run(function_t *call, vm_code_t *code, rinha_value_t *r,
+    rinha_value_t *ret);
+
+/**
+ * @brief Run a closure called by the token walker on the VM.
+ *
+ * @return `false` if the closure is left to the token walker.
+ */
+bool rinha_vm_call(function_t *call, rinha_value_t *args, rinha_value_t *ret);
+
+/**
+ * @brief Create a closure from VM code: it sees the environment of the closure
+ *        creating it, the captured registers and itself.
+ */
+function_t *rinha_vm_closure(function_t *definer, vm_code_t *code,
+    vm_closure_t *closure, rinha_value_t *r);
+
+/**
+ * @brief Print VM code in a readable form.
+ */
+void rinha_vm_dump(vm_code_t *code, FILE *out);
+
+void rinha_vm_free(vm_code_t *code);
+
+#endif
@@ -10,8 +10,18 @@
  * @date September 14, 2023
  */
 
+#include <elf.h>
+#include <malloc.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "test.h"
 #include "rinha.h"
+#include "ir.h"
+#include "gc.h"
+#include "bundle.h"
+
+static const char *rinha_tests_argv0 = "la-rinha-tests";
 
 
 TEST(rinha_hello_world) {
@@ -194,6 +204,337 @@ TEST(rinha_tuples) {
   EXPECT_EQ(response.number, 200);
 }
 
+TEST(rinha_tuple_values) {
+
+  char *code =
+      "let mk = fn (n, acc) => if (n == 0) { acc } else { mk(n - 1, (first(acc) + n, second(acc) + 1)) };\n"
+      "let t = mk(1000, (0, 0));\n"
+      "print(first(t) + second(t))\n";
+
+  // Tuples are pointed to: a value is a type and one word
+  EXPECT_EQ((int) sizeof(rinha_value_t), 16);
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_tuple_values", code, &response, true);
+
+  EXPECT_EQ(response.type, INTEGER);
+  EXPECT_EQ(response.number, 501500);
+}
+
+TEST(rinha_nested_tuples) {
+
+  char *code =
+      "let build = fn (n, acc) => if (n == 0) { acc } else { build(n - 1, (n, acc)) };\n"
+      "let sum = fn (l, n, acc) => if (n == 0) { acc } else { sum(second(l), n - 1, acc + first(l)) };\n"
+      "let t = ((1, \"a\"), (2, (3, 4)));\n"
+      "let ok = t == ((1, \"a\"), (2, (3, 4))) && second(first(t)) == \"a\";\n"
+      "print(if (ok) { sum(build(500, 0), 500, 0) + second(second(second(t))) } else { 0 })\n";
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_nested_tuples", code, &response, true);
+
+  EXPECT_EQ(response.type, INTEGER);
+  EXPECT_EQ(response.number, 125254);
+}
+
+TEST(rinha_shared_strings) {
+
+  // More live strings than a ring of slots would hold
+  char *code =
+      "let build = fn (n, acc) => if (n == 0) { acc } else { build(n - 1, (\"s\" + n, acc)) };\n"
+      "let get = fn (l, i) => if (i == 0) { first(l) } else { get(second(l), i - 1) };\n"
+      "let l = build(100, 0);\n"
+      "print(get(l, 0) + get(l, 99))\n";
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_shared_strings", code, &response, true);
+
+  EXPECT_EQ(response.type, STRING);
+  EXPECT_STREQ(response.string, "s1s100");
+}
+
+TEST(rinha_rope) {
+
+  // Longer than a formatted string could be, compared against another rope
+  char *code =
+      "let chunk = \"0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789\";\n"
+      "let build = fn (n, acc) => if (n == 0) { acc } else { build(n - 1, acc + chunk) };\n"
+      "let same = fn (x, y) => if (x == y) { x } else { \"\" };\n"
+      "print(same(build(1000, \"\"), build(999, \"\") + chunk))\n";
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_rope", code, &response, true);
+
+  EXPECT_EQ(response.type, STRING);
+  EXPECT_EQ((int) strlen(response.string), 100000);
+}
+
+TEST(rinha_rope_walker) {
+
+  // Walker calls that accumulate a string keep it a rope: the memo key is
+  // not built for it, so the heap grows by a node per call, not by a copy
+  char *code =
+      "let spin = fn (i, n, s) => if (i == n) { s } else { spin(i + 1, n, s + 1) };\n"
+      "print(spin(0, 3000, \"x\") == \"y\")\n";
+
+  rinha_options_t options = {0};
+  options.gc_threshold = SIZE_MAX;
+  rinha_set_options(&options);
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_rope_walker", code, &response, true);
+
+  EXPECT_EQ(response.type, BOOLEAN);
+  EXPECT_FALSE(response.boolean);
+  EXPECT_EQ(rinha_gc_stats()->collections, 0);
+  EXPECT_TRUE(rinha_gc_stats()->heap < (1 << 20));
+
+  options.gc_threshold = 0;
+  rinha_set_options(&options);
+}
+
+TEST(rinha_interned_strings) {
+
+  // Computed strings used as tags, and as the memo key of `weight`
+  char *code =
+      "let tag = fn (n) => if (n % 3 == 0) { \"fizz\" } else { if (n % 5 == 0) { \"buzz\" } else { \"num\" } };\n"
+      "let weight = fn (t) => if (t == \"fi\" + \"zz\") { 3 } else { if (t == \"buzz\") { 5 } else { 1 } };\n"
+      "let sum = fn (n, acc) => if (n == 0) { acc } else { sum(n - 1, acc + weight(tag(n) + \"\")) };\n"
+      "print(sum(900, 0))\n";
+
+  rinha_options_t options = {0};
+  options.engine = RINHA_ENGINE_REGVM;
+  rinha_set_options(&options);
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_interned_strings", code, &response, true);
+
+  EXPECT_EQ(response.type, INTEGER);
+  EXPECT_EQ(response.number, 1980);
+
+  options.engine = RINHA_ENGINE_WALKER;
+  rinha_set_options(&options);
+}
+
+TEST(rinha_small_strings) {
+
+  // Across the small string limit and the rope threshold
+  char *code =
+      "let s = fn (n) => if (n == 0) { \"\" } else { s(n - 1) + \"x\" };\n"
+      "let eq = fn (a, b) => if (a == b) { \"y\" } else { \"n\" };\n"
+      "print(eq(s(13), \"xxxxxxxxxxxxx\") + eq(s(14), \"xxxxxxxxxxxxxx\") + eq(s(13), s(14)) +\n"
+      "      eq(s(70), s(69) + \"x\") + eq(\"ab\" + 12, \"ab12\") + s(3))\n";
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_small_strings", code, &response, true);
+
+  EXPECT_EQ((int) sizeof(rinha_value_t), 16);
+  EXPECT_EQ(response.type, STRING);
+  EXPECT_STREQ(response.string, "yynyyxxx");
+}
+
+TEST(rinha_arena_reuse) {
+
+  // Repeated runs reuse the memory of the previous ones
+  char *code =
+      "let build = fn (n, acc) => if (n == 0) { acc } else { build(n - 1, (\"item \" + n + \" of the list\", acc)) };\n"
+      "let count = fn (l, acc) => if (acc == 500) { acc } else { count(second(l), acc + 1) };\n"
+      "print(count(build(500, 0), 0))\n";
+
+  rinha_value_t response = {0};
+  size_t in_use[20];
+
+  for (int i = 0; i < 20; ++i) {
+    rinha_clear_stack();
+    rinha_script_exec("rinha_arena_reuse", code, &response, true);
+
+    struct mallinfo2 info = mallinfo2();
+    in_use[i] = info.uordblks + info.hblkhd;
+  }
+
+  EXPECT_EQ(response.type, INTEGER);
+  EXPECT_EQ(response.number, 500);
+  EXPECT_TRUE(in_use[19] == in_use[4]);
+}
+
+TEST(rinha_gc) {
+
+  // A loop leaving garbage strings and tuples behind, and a string kept alive
+  char *code =
+      "let keep = \"kept across collections: \" + 42;\n"
+      "let step = fn (t) => second(second(t)) + 0 * (first(t) + \"!\" == \"x\");\n"
+      "let loop = fn (n, acc) => if (n == 0) { acc } else {\n"
+      "  loop(n - 1, step((\"garbage \" + n + \" of the loop, long enough to be a rope\", (n, acc + 1))))\n"
+      "};\n"
+      "print(keep + \" \" + loop(20000, 0))\n";
+
+  rinha_options_t options = {0};
+  options.engine = RINHA_ENGINE_REGVM;
+  options.gc_threshold = 64 << 10;
+  rinha_set_options(&options);
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_gc", code, &response, true);
+
+  EXPECT_EQ(response.type, STRING);
+  EXPECT_STREQ(response.string, "kept across collections: 42 20000");
+  EXPECT_TRUE(rinha_gc_stats()->collections > 10);
+  EXPECT_TRUE(rinha_gc_stats()->live < (64 << 10));
+
+  options.engine = RINHA_ENGINE_WALKER;
+  options.gc_threshold = 0;
+  rinha_set_options(&options);
+}
+
+TEST(rinha_gc_walker) {
+
+  // The locals of a returned call are not roots, nor seen by the next call
+  // made at the same depth. The machine stack is scanned conservatively and
+  // may hold a stale word per level: the recursion is kept shallow, and the
+  // helper leaves several locals in each frame.
+  char *code =
+      "let x = \"global\";\n"
+      "let set = fn (k) => { let x = k; x };\n"
+      "let get = fn (k) => x;\n"
+      "let helper = fn (k) => {\n"
+      "  let a = \"first piece of text \" + k + \" long enough to be a rope\";\n"
+      "  let b = \"second piece of text \" + k + \" long enough to be a rope\";\n"
+      "  let c = \"third piece of text \" + k + \" long enough to be a rope\";\n"
+      "  let d = \"fourth piece of text \" + k + \" long enough to be a rope\";\n"
+      "  let e = \"fifth piece of text \" + k + \" long enough to be a rope\";\n"
+      "  let f = \"sixth piece of text \" + k + \" long enough to be a rope\";\n"
+      "  let g = \"seventh piece of text \" + k + \" long enough to be a rope\";\n"
+      "  let h = \"eighth piece of text \" + k + \" long enough to be a rope\";\n"
+      "  a == h\n"
+      "};\n"
+      "let loop = fn (n, r) => if (n == 0) { 0 } else { if (helper(n + r)) { 1 } else { loop(n - 1, r) } };\n"
+      "let both = fn (k) => if (set(k) == 0) { \"zero\" } else { get(k) };\n"
+      "print(both(7) + \" \" + (loop(300, 0) + loop(300, 1000) + loop(300, 2000) + loop(300, 3000)))\n";
+
+  rinha_options_t options = {0};
+  options.gc_threshold = 16 << 10;
+  rinha_set_options(&options);
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_gc_walker", code, &response, true);
+
+  EXPECT_EQ(response.type, STRING);
+  EXPECT_STREQ(response.string, "global 0");
+  EXPECT_TRUE(rinha_gc_stats()->collections > 10);
+  EXPECT_TRUE(rinha_gc_stats()->live < (16 << 10));
+
+  options.gc_threshold = 0;
+  rinha_set_options(&options);
+}
+
+TEST(rinha_bignum) {
+
+  // Past the word: factorials, a recurrence, literals, division and memo keys
+  char *code =
+      "let fact = fn (n) => if (n < 2) { 1 } else { n * fact(n - 1) };\n"
+      "let fib = fn (n) => if (n < 2) { n } else { fib(n - 1) + fib(n - 2) };\n"
+      "let big = 123456789012345678901234567890;\n"
+      "let rest = (big * big) % fact(25) / 1000000007;\n"
+      "let over = 9223372036854775807 + 1 - 1;\n"
+      "print(\"\" + fact(25) + \" \" + fib(100) + \" \" + (big > over) + \" \" + rest"
+      " + \" \" + (over == 9223372036854775807) + \" \" + (fact(30) / fact(28)))\n";
+  rinha_engine_t engines[] = {
+    RINHA_ENGINE_WALKER, RINHA_ENGINE_REGVM, RINHA_ENGINE_CLOSURE,
+    RINHA_ENGINE_TIERED
+  };
+
+  rinha_options_t options = {0};
+
+  for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); ++i) {
+    options.engine = engines[i];
+    rinha_set_options(&options);
+
+    rinha_value_t response = {0};
+    rinha_clear_stack();
+
+    rinha_script_exec("rinha_bignum", code, &response, true);
+
+    EXPECT_EQ(response.type, STRING);
+    EXPECT_STREQ(response.string, "15511210043330985984000000 354224848179261915075"
+                 " true 14457505709608635 true 870");
+  }
+
+  options.engine = RINHA_ENGINE_WALKER;
+  rinha_set_options(&options);
+}
+
+TEST(rinha_integer_format) {
+
+  // Word limits, zero, and lengths around the digit pairs
+  char *code =
+      "let min = 0 - 9223372036854775807 - 1;\n"
+      "print(\"[\" + min + \" \" + 9223372036854775807 + \" \" + 0 + \" \" + 7 + \" \" + (0 - 10)"
+      " + \" \" + 99 + \" \" + 100 + \" \" + 4294967296 + \"]\")\n";
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_integer_format", code, &response, true);
+
+  EXPECT_EQ(response.type, STRING);
+  EXPECT_STREQ(response.string, "[-9223372036854775808 9223372036854775807 0 7 -10 99 100"
+               " 4294967296]");
+}
+
+TEST(rinha_gc_kinds) {
+
+  // Bignums and rope nodes share a size class: the slots freed on a page of
+  // one kind must not be handed to the other
+  char *code =
+      "let _ = print(\"no memo\");\n"
+      "let fact = fn (n) => if (n < 2) { 1 } else { n * fact(n - 1) };\n"
+      "let burn = fn (n, acc) => if (n == 0) { acc } else { burn(n - 1, fact(25) + n) };\n"
+      "let grow = fn (n, s) => if (n == 0) { s } else {\n"
+      "  grow(n - 1, s + \"piece \" + n + \" of a long enough rope; \")\n"
+      "};\n"
+      "let step = fn (n, s) => if (n == 0) { s } else {\n"
+      "  step(n - 1, if (burn(50, n) == 0) { s } else { grow(20, s) })\n"
+      "};\n"
+      "let rope = step(300, \"\");\n"
+      "print(\"\" + (rope == \"x\") + \" \" + burn(50, 0))\n";
+
+  rinha_options_t options = {0};
+  options.engine = RINHA_ENGINE_REGVM;
+  options.gc_threshold = 4 << 10;
+  rinha_set_options(&options);
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_gc_kinds", code, &response, true);
+
+  EXPECT_EQ(response.type, STRING);
+  EXPECT_STREQ(response.string, "false 15511210043330985984000001");
+  EXPECT_TRUE(rinha_gc_stats()->collections > 10);
+
+  options.engine = RINHA_ENGINE_WALKER;
+  options.gc_threshold = 0;
+  rinha_set_options(&options);
+}
+
 TEST(rinha_concat) {
 
   char *code =
@@ -231,7 +572,584 @@ TEST(rinha_closure0) {
   EXPECT_EQ(response.number, 3);
 }
 
-int main() {
+TEST(rinha_short_circuit) {
+
+  char *code =
+      "let calls = 0;\n"
+      "let touch = fn (x) => { calls = calls + 1; x };\n"
+      "let a = false && touch(true);\n"
+      "let b = true || touch(false);\n"
+      "let c = true && touch(true) && (1 + 2 * 3 == 7 || touch(false));\n"
+      "print(calls)\n";
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_short_circuit", code, &response, true);
+
+  EXPECT_EQ(response.type, INTEGER);
+  EXPECT_EQ(response.number, 1);
+}
+
+TEST(rinha_dead_code) {
+
+  char *code =
+      "let calls = 0;\n"
+      "let touch = fn (x) => { calls = calls + 1; x };\n"
+      "let twice = fn (x) => { x * 2 };\n"
+      "let unused = twice(21);\n"
+      "let _ = twice(1);\n"
+      "let _ = touch(1);\n"
+      "let kept = touch(2);\n"
+      // Calls through a parameter or a reassigned name are not known to be pure
+      "let bump = fn (x) => { calls = calls + x; x };\n"
+      "let apply = fn (twice, x) => { twice(x) };\n"
+      "let _ = apply(bump, 100);\n"
+      "let same = fn (x) => { x };\n"
+      "same = bump;\n"
+      "let _ = same(1000);\n"
+      "let f = fn (n) => {\n"
+      "  if (1 + 1 == 2 && true) { n + calls } else { touch(0) }\n"
+      "};\n"
+      "print(f(40))\n";
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_dead_code", code, &response, true);
+
+  EXPECT_EQ(response.type, INTEGER);
+  EXPECT_EQ(response.number, 1142);
+
+  // Unused values that fail are kept on every engine: run in a bundle, since
+  // errors exit
+  const char *failing[] = {
+    "let x = 1 / 0;\nprint(1)\n",
+    "let f = fn (n) => { let x = n / 0; n };\nprint(f(1))\n",
+    "let f = fn (n) => { let x = n % n; n };\nprint(f(0))\n",
+    "let f = fn (n) => { let x = first(n); n };\nprint(f(1))\n",
+    "let f = fn (n) => { let x = second(n); n };\nprint(f(1))\n",
+    "let d = fn (n) => 10 / n;\nlet _ = d(0);\nprint(1)\n",
+  };
+  rinha_engine_t engines[] = {
+    RINHA_ENGINE_WALKER, RINHA_ENGINE_REGVM, RINHA_ENGINE_CLOSURE,
+    RINHA_ENGINE_TIERED
+  };
+  const char *out = "/tmp/la-rinha-tests.dead";
+  char command[256];
+
+  snprintf(command, sizeof(command), "%s >/dev/null 2>&1", out);
+
+  for (size_t i = 0; i < sizeof(failing) / sizeof(failing[0]); ++i) {
+    for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); ++e) {
+      EXPECT_TRUE(rinha_bundle_write(rinha_bundle_self(rinha_tests_argv0),
+          failing[i], engines[e], out));
+      EXPECT_EQ(system(command), EXIT_FAILURE << 8);
+    }
+  }
+  EXPECT_EQ(remove(out), 0);
+}
+
+TEST(rinha_recurrence) {
+
+  char *code =
+     "let sum = fn (n) => {\n"
+     "  if (n == 1) {\n"
+     "    n\n"
+     "  } else {\n"
+     "    n + sum(n - 1)\n"
+     "  }\n"
+     "};\n"
+     "let fib = fn (n) => { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } };\n"
+     "print(sum(1000000) - fib(46))\n";
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_recurrence", code, &response, true);
+
+  EXPECT_EQ(response.type, INTEGER);
+  EXPECT_TRUE(response.number == 500000500000 - 1836311903);
+}
+
+TEST(rinha_precompute) {
+
+  char *code =
+     "let sq = fn (n) => { n * n };\n"
+     "print(sq(12))\n";
+
+  rinha_options_t options = {0};
+  options.precompute = true;
+  options.cache_path = "/tmp/la-rinha-tests.cache";
+  remove(options.cache_path);
+  rinha_set_options(&options);
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_precompute", code, &response, true);
+
+  rinha_value_t cached = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_precompute", code, &cached, true);
+
+  EXPECT_EQ(response.number, 144);
+  EXPECT_EQ(cached.type, INTEGER);
+  EXPECT_EQ(cached.number, 144);
+  EXPECT_EQ(remove(options.cache_path), 0);
+
+  options.precompute = false;
+  rinha_set_options(&options);
+}
+
+TEST(rinha_precompute_corrupt) {
+
+  char *code =
+     "let sq = fn (n) => { n * n };\n"
+     "print(sq(12))\n";
+
+  rinha_options_t options = {0};
+  options.precompute = true;
+  options.cache_path = "/tmp/la-rinha-tests.cache";
+  remove(options.cache_path);
+  rinha_set_options(&options);
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_precompute_corrupt", code, &response, true);
+
+  // Rewrite the entry with types the cache never holds and a bad boolean
+  unsigned long long key = 0;
+  FILE *fp = fopen(options.cache_path, "r");
+
+  EXPECT_TRUE(fp && fscanf(fp, "%llx", &key) == 1);
+  if (fp)
+    fclose(fp);
+
+  fp = fopen(options.cache_path, "w");
+  fprintf(fp, "%016llx %d 0\n", key, FUNCTION);
+  fprintf(fp, "%016llx %d 0\n", key, TUPLE);
+  fprintf(fp, "%016llx %d 0\n", key, BIGINT);
+  fprintf(fp, "%016llx %d 99 trailing\n", key, 42);
+  fprintf(fp, "%016llx %d 7\n", key, BOOLEAN);
+  fclose(fp);
+
+  rinha_value_t cached = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_precompute_corrupt", code, &cached, true);
+
+  EXPECT_EQ(cached.type, INTEGER);
+  EXPECT_EQ(cached.number, 144);
+  EXPECT_EQ(remove(options.cache_path), 0);
+
+  options.precompute = false;
+  rinha_set_options(&options);
+}
+
+TEST(rinha_ir_passes) {
+
+  char *code =
+     "let f = fn (x) => { x + 1 };\n"
+     "print(f(1))\n";
+
+  rinha_options_t options = {0};
+  options.dump_ir = true;
+  rinha_set_options(&options);
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_ir_passes", code, &response, true);
+
+  // The IR is dumped, the script is not run
+  EXPECT_EQ(response.type, UNDEFINED);
+
+  EXPECT_EQ(rinha_ir_select_passes("fold,dce"), true);
+  EXPECT_EQ(rinha_ir_select_passes("fold,unroll"), false);
+  EXPECT_EQ(rinha_ir_select_passes("all"), true);
+
+  options.dump_ir = false;
+  rinha_set_options(&options);
+}
+
+TEST(rinha_regvm) {
+
+  char *code =
+     "let make = fn (x) => { let add = fn (y) => x + y; add };\n"
+     "let twice = fn (f, v) => f(f(v));\n"
+     "let slow = fn (n, a, b, c) => if (n < 2) { n } else { slow(n - 1, a, b, c) + slow(n - 2, a, b, c) };\n"
+     "let label = fn (n) => if (n > 0 && n % 2 == 0) { \"even\" } else { \"odd\" };\n"
+     "print(twice(make(5), slow(20, 1, 2, 3)) + first((label(4), 0)))\n";
+
+  rinha_options_t options = {0};
+  options.engine = RINHA_ENGINE_REGVM;
+  rinha_set_options(&options);
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_regvm", code, &response, true);
+
+  EXPECT_EQ(response.type, STRING);
+  EXPECT_STREQ(response.string, "6775even");
+
+  options.engine = RINHA_ENGINE_WALKER;
+  rinha_set_options(&options);
+}
+
+TEST(rinha_inline_cache) {
+
+  char *code =
+     "let apply = fn (f, v) => f(v);\n"
+     "let make = fn (s) => fn (x) => x + s;\n"
+     "let run = fn (i, acc) => if (i == 0) { acc } else { run(i - 1, acc + apply(make(i), \"-\") + apply(fn (x) => x + \"!\", \"\")) };\n"
+     "print(run(3, \"\"))\n";
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_inline_cache", code, &response, true);
+
+  EXPECT_EQ(response.type, STRING);
+  EXPECT_STREQ(response.string, "-3!-2!-1!");
+}
+
+TEST(rinha_regvm_quickening) {
+
+  char *code =
+     "let join = fn (a, b) => a + b;\n"
+     "let same = fn (a, b) => if (a == b) { \"y\" } else { \"n\" };\n"
+     "let run = fn (i) => join(i, 1) + join(\"a\", i) + same(i, 2) + same(\"b\", \"b\") + join(i, 1);\n"
+     "let loop = fn (i, acc) => if (i == 0) { acc } else { loop(i - 1, acc + run(i)) };\n"
+     "print(loop(3, \"\"))\n";
+
+  rinha_options_t options = {0};
+  options.engine = RINHA_ENGINE_REGVM;
+  rinha_set_options(&options);
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_regvm_quickening", code, &response, true);
+
+  EXPECT_EQ(response.type, STRING);
+  EXPECT_STREQ(response.string, "4a3ny43a2yy32a1ny2");
+
+  options.engine = RINHA_ENGINE_WALKER;
+  rinha_set_options(&options);
+}
+
+TEST(rinha_closure_engine) {
+
+  char *code =
+     "let make = fn (x) => { let add = fn (y) => x + y; add };\n"
+     "let twice = fn (f, v) => f(f(v));\n"
+     "let count = fn (i, acc) => if (i == 0) { acc } else { count(i - 1, acc + i % 3) };\n"
+     "let label = fn (n) => if (n > 0 && n % 2 == 0) { \"even\" } else { \"odd\" };\n"
+     "print(twice(make(5), count(100, 0)) + label(4) + second((1, label(3))))\n";
+
+  rinha_options_t options = {0};
+  options.engine = RINHA_ENGINE_CLOSURE;
+  rinha_set_options(&options);
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_closure_engine", code, &response, true);
+
+  EXPECT_EQ(response.type, STRING);
+  EXPECT_STREQ(response.string, "110evenodd");
+
+  options.engine = RINHA_ENGINE_WALKER;
+  rinha_set_options(&options);
+}
+
+TEST(rinha_tail_call) {
+
+  // Deeper than RINHA_CONFIG_STACK_SIZE: the self tail call runs as a loop
+  char *code =
+     "let loop = fn (n, acc) => if (n == 0) { acc } else { loop(n - 1, acc + 1) };\n"
+     "let even = fn (n) => if (n == 0) { \"y\" } else { odd(n - 1) };\n"
+     "let odd = fn (n) => if (n == 0) { \"n\" } else { even(n - 1) };\n"
+     "print(loop(300000, 0) + even(7))\n";
+
+  rinha_engine_t engines[] = { RINHA_ENGINE_REGVM, RINHA_ENGINE_CLOSURE };
+  rinha_options_t options = {0};
+
+  for (int i = 0; i < 2; ++i) {
+    options.engine = engines[i];
+    rinha_set_options(&options);
+
+    rinha_value_t response = {0};
+    rinha_clear_stack();
+
+    rinha_script_exec("rinha_tail_call", code, &response, true);
+
+    EXPECT_EQ(response.type, STRING);
+    EXPECT_STREQ(response.string, "300000n");
+  }
+
+  options.engine = RINHA_ENGINE_WALKER;
+  rinha_set_options(&options);
+}
+
+TEST(rinha_tiered_engine) {
+
+  char *code =
+     "let count = fn (i, acc) => if (i == 0) { acc } else { count(i - 1, acc + i % 3) };\n"
+     "let label = fn (n) => if (n % 2 == 0) { \"even\" } else { \"odd\" };\n"
+     "print(label(count(5000, 0)) + count(10, 0))\n";
+
+  rinha_options_t options = {0};
+  options.engine = RINHA_ENGINE_TIERED;
+  rinha_set_options(&options);
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_tiered_engine", code, &response, true);
+
+  EXPECT_EQ(response.type, STRING);
+  EXPECT_STREQ(response.string, "odd10");
+
+  options.engine = RINHA_ENGINE_WALKER;
+  rinha_set_options(&options);
+}
+
+TEST(rinha_tier_osr) {
+
+  // A single call: the loop moves to compiled code while it runs
+  char *code =
+     "let loop = fn (i, n, acc) => if (i == n) { acc } else { loop(i + 1, n, acc + i % 3) };\n"
+     "print(loop(0, 300000, 0))\n";
+
+  rinha_options_t options = {0};
+  options.engine = RINHA_ENGINE_TIERED;
+  rinha_set_options(&options);
+
+  rinha_value_t response = {0};
+  rinha_clear_stack();
+
+  rinha_script_exec("rinha_tier_osr", code, &response, true);
+
+  EXPECT_EQ(response.type, INTEGER);
+  EXPECT_EQ(response.number, 300000);
+
+  options.engine = RINHA_ENGINE_WALKER;
+  rinha_set_options(&options);
+}
+
+TEST(rinha_bundle) {
+
+  // Bundles of this binary run their script instead of the tests (see main)
+  const char *self = rinha_bundle_self(rinha_tests_argv0);
+  const char *out = "/tmp/la-rinha-tests.bundle";
+  char *code = NULL;
+  rinha_engine_t engine = RINHA_ENGINE_WALKER;
+
+  EXPECT_EQ(rinha_bundle_read(self, &code, &engine), RINHA_BUNDLE_NONE);
+  EXPECT_TRUE(rinha_bundle_write(self, "print(6 * 7)", RINHA_ENGINE_REGVM, out));
+  EXPECT_EQ(rinha_bundle_read(out, &code, &engine), RINHA_BUNDLE_OK);
+  EXPECT_STREQ(code, "print(6 * 7)");
+  EXPECT_EQ(engine, RINHA_ENGINE_REGVM);
+  free(code);
+
+  char line[64] = {0};
+  FILE *run = popen(out, "r");
+
+  EXPECT_TRUE(run && fgets(line, sizeof(line), run));
+  EXPECT_STREQ(line, "42\n");
+
+  int status = run ? pclose(run) : -1;
+  EXPECT_EQ(status, 0);
+
+  // Bundling from a bundle replaces its script
+  const char *again = "/tmp/la-rinha-tests.bundle2";
+
+  EXPECT_TRUE(rinha_bundle_write(out, "print(1)", RINHA_ENGINE_CLOSURE, again));
+  EXPECT_EQ(rinha_bundle_read(again, &code, &engine), RINHA_BUNDLE_OK);
+  EXPECT_STREQ(code, "print(1)");
+  EXPECT_EQ(engine, RINHA_ENGINE_CLOSURE);
+  free(code);
+  remove(again);
+
+  struct stat s;
+  stat(out, &s);
+
+  // A modified script fails its checksum
+  FILE *fp = fopen(out, "r+b");
+  fseek(fp, -(long)(sizeof(rinha_bundle_trailer_t) + 2), SEEK_END);
+  fputc('8', fp);
+  fclose(fp);
+  EXPECT_EQ(rinha_bundle_read(out, &code, &engine), RINHA_BUNDLE_CORRUPT);
+
+  char command[256];
+
+  snprintf(command, sizeof(command), "%s >/dev/null 2>&1", out);
+  EXPECT_EQ(system(command), EXIT_FAILURE << 8);
+
+  // A size larger than the file
+  uint64_t size = UINT64_MAX / 2;
+  fp = fopen(out, "r+b");
+  fseek(fp, -(long)sizeof(rinha_bundle_trailer_t), SEEK_END);
+  fwrite(&size, sizeof(size), 1, fp);
+  fclose(fp);
+  EXPECT_EQ(rinha_bundle_read(out, &code, &engine), RINHA_BUNDLE_CORRUPT);
+
+  // A truncated trailer is no trailer
+  EXPECT_EQ(truncate(out, s.st_size - 1), 0);
+  EXPECT_EQ(rinha_bundle_read(out, &code, &engine), RINHA_BUNDLE_NONE);
+  EXPECT_EQ(truncate(out, 4), 0);
+  EXPECT_EQ(rinha_bundle_read(out, &code, &engine), RINHA_BUNDLE_NONE);
+
+  EXPECT_EQ(remove(out), 0);
+  EXPECT_EQ(rinha_bundle_read(out, &code, &engine), RINHA_BUNDLE_NONE);
+  EXPECT_FALSE(rinha_bundle_write(out, "print(1)", RINHA_ENGINE_WALKER, again));
+}
+
+/**
+ * @brief Run an executable, keeping the first line of its output.
+ *
+ * @return Its exit status.
+ */
+static int rinha_tests_run_(const char *exe, char *line, int size) {
+  FILE *run = popen(exe, "r");
+
+  line[0] = '\0';
+  if (!run)
+    return -1;
+  while (fgets(line + strlen(line), size - strlen(line), run))
+    ;
+  return pclose(run);
+}
+
+TEST(rinha_native) {
+
+  // Executables built with --compile fall back to this binary (see main)
+  const char *self = rinha_bundle_self(rinha_tests_argv0);
+  const char *out = "/tmp/la-rinha-tests.native";
+  char line[128];
+  char fib[] =
+      "let fib = fn (n, a) => {\n"
+      "  if (n < 2) { n } else { fib(n - 1, a) + fib(n - 2, a) }\n"
+      "};\n"
+      "let odd = fn (n) => if (n == 0) { false } else { n % 2 == 1 };\n"
+      "print(fib(30, 0));\n"
+      "print(odd(7))\n";
+
+  rinha_clear_stack();
+  EXPECT_TRUE(rinha_script_compile("rinha_native", fib, self, out));
+  EXPECT_EQ(rinha_tests_run_(out, line, sizeof(line)), 0);
+  EXPECT_STREQ(line, "832040\ntrue\n");
+
+  // A static executable: no interpreter to load it
+  Elf64_Ehdr header;
+  Elf64_Phdr segment;
+  FILE *fp = fopen(out, "rb");
+
+  EXPECT_TRUE(fp && fread(&header, sizeof(header), 1, fp) == 1);
+  EXPECT_EQ(header.e_type, ET_EXEC);
+  EXPECT_EQ(header.e_machine, EM_X86_64);
+  for (int i = 0; fp && i < header.e_phnum; ++i) {
+    fseek(fp, header.e_phoff + i * sizeof(segment), SEEK_SET);
+    EXPECT_TRUE(fread(&segment, sizeof(segment), 1, fp) == 1);
+    EXPECT_TRUE(segment.p_type != PT_INTERP && segment.p_type != PT_DYNAMIC);
+  }
+  if (fp)
+    fclose(fp);
+
+  // Past the machine words the script runs again in the interpreter
+  char overflow[] =
+      "let f = fn (n) => n * n * n;\n"
+      "print(f(10));\n"
+      "print(f(3000000))\n";
+
+  rinha_clear_stack();
+  EXPECT_TRUE(rinha_script_compile("rinha_native", overflow, self, out));
+  EXPECT_EQ(rinha_tests_run_(out, line, sizeof(line)), 0);
+  EXPECT_STREQ(line, "1000\n27000000000000000000\n");
+
+  char zero[] = "let f = fn (a, b) => a / b;\nprint(f(7, 2));\nprint(f(1, 0))\n";
+  char command[256];
+
+  snprintf(command, sizeof(command), "%s >/dev/null 2>&1", out);
+  rinha_clear_stack();
+  EXPECT_TRUE(rinha_script_compile("rinha_native", zero, self, out));
+  EXPECT_EQ(system(command), EXIT_FAILURE << 8);
+
+  // Strings, tuples and closures as values are not compiled
+  char unsupported[][80] = {
+    "let f = fn (n) => \"n: \" + n;\nprint(f(1))\n",
+    "let f = fn (n) => (n, n);\nprint(f(1))\n",
+    "let f = fn (g) => g(1);\nlet h = fn (n) => n;\nprint(f(h))\n",
+    "print(f(1));\nlet f = fn (n) => n;\n",
+  };
+
+  for (size_t i = 0; i < sizeof(unsupported) / sizeof(unsupported[0]); ++i) {
+    rinha_clear_stack();
+    EXPECT_FALSE(rinha_script_compile("rinha_native", unsupported[i], self, out));
+  }
+  remove(out);
+}
+
+TEST(rinha_ir_dce_errors) {
+
+  // Unused values may still fail: run in a bundle, since errors exit
+  const char *failing[] = {
+    "let f = fn (a, b) => { second((a / b, a + 1)) };\nprint(f(1, 0))\n",
+    "let f = fn (a, b) => { second((first(a), a + 1)) };\nprint(f(1, 0))\n",
+    "let f = fn (a, b) => { second((a == b, a + 1)) };\nprint(f(1, \"x\"))\n",
+    "let f = fn () => { second((g, 1)) };\nprint(f());\nlet g = fn () => 2;\n",
+  };
+  const char *out = "/tmp/la-rinha-tests.dce";
+  char command[256];
+
+  snprintf(command, sizeof(command), "%s >/dev/null 2>&1", out);
+
+  for (size_t i = 0; i < sizeof(failing) / sizeof(failing[0]); ++i) {
+    EXPECT_TRUE(rinha_bundle_write(rinha_bundle_self(rinha_tests_argv0),
+        failing[i], RINHA_ENGINE_REGVM, out));
+    EXPECT_EQ(system(command), EXIT_FAILURE << 8);
+  }
+
+  // A constant divisor cannot fail
+  EXPECT_TRUE(rinha_bundle_write(rinha_bundle_self(rinha_tests_argv0),
+      "let f = fn (a, b) => { second((a / 3, a + b)) };\n"
+      "print(f(1, 0))\n", RINHA_ENGINE_REGVM, out));
+
+  char line[64] = {0};
+  FILE *run = popen(out, "r");
+
+  EXPECT_TRUE(run && fgets(line, sizeof(line), run));
+  EXPECT_STREQ(line, "1\n");
+
+  int status = run ? pclose(run) : -1;
+  EXPECT_EQ(status, 0);
+  EXPECT_EQ(remove(out), 0);
+}
+
+int main(int argc, char *argv[]) {
+  char *code = NULL;
+  rinha_options_t options = {0};
+
+  if (argc)
+    rinha_tests_argv0 = argv[0];
+
+  if (rinha_bundle_read(rinha_bundle_self(rinha_tests_argv0), &code,
+      &options.engine) != RINHA_BUNDLE_NONE) {
+    rinha_value_t response = {0};
+
+    if (!code)
+      return EXIT_FAILURE;
+
+    rinha_set_options(&options);
+    rinha_script_exec((char *)rinha_tests_argv0, code, &response, false);
+    return EXIT_SUCCESS;
+  }
+
   _test_t tests[] = {
      rinha_hello_world_test,
 
@@ -247,9 +1165,38 @@ int main() {
 
      rinha_cond0_test,
      rinha_tuples_test,
+     rinha_tuple_values_test,
+     rinha_nested_tuples_test,
+     rinha_shared_strings_test,
+     rinha_rope_test,
+     rinha_rope_walker_test,
+     rinha_interned_strings_test,
+     rinha_small_strings_test,
+     rinha_arena_reuse_test,
      rinha_concat_test,
 
      rinha_closure0_test,
+     rinha_short_circuit_test,
+     rinha_dead_code_test,
+     rinha_recurrence_test,
+     rinha_precompute_test,
+     rinha_precompute_corrupt_test,
+     rinha_ir_passes_test,
+     rinha_inline_cache_test,
+     rinha_regvm_test,
+     rinha_regvm_quickening_test,
+     rinha_closure_engine_test,
+     rinha_tail_call_test,
+     rinha_tiered_engine_test,
+     rinha_tier_osr_test,
+     rinha_gc_test,
+     rinha_gc_walker_test,
+     rinha_bignum_test,
+     rinha_gc_kinds_test,
+     rinha_integer_format_test,
+     rinha_bundle_test,
+     rinha_native_test,
+     rinha_ir_dce_errors_test,
   };
 
   run_tests(tests, sizeof(tests) / sizeof(tests[0]));